@@ -1,18 +1,252 @@
 #include "jaroViewer/rendering/shaderManager.hpp"
 #include <jaroViewer/core/engine.hpp>
+#include <jaroViewer/core/mpscQueue.hpp>
 #include <jaroViewer/geometry/basicShapes.hpp>
 #include <jaroViewer/graphics/materialManager.hpp>
+#include <jaroViewer/lighting/lightmapBaker.hpp>
 #include <jaroViewer/modifiers/wavingModifier.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <random>
+#include <string>
 #include <sys/types.h>
+#include <thread>
+#include <vector>
 
 using namespace JaroViewer;
 
+/**
+ * Prints the frame rate and the average time of the frame phases every two seconds.
+ * The refit, cull and pack times are cpu time summed over the worker threads, so
+ * running with --threads 1, 4 and 16 shows how they spread over the cores
+ * @param label Names the benchmark in the output
+ */
+void addFrameReport(Engine& engine, const std::string& label) {
+	std::shared_ptr<int> frames     = std::make_shared<int>(0);
+	std::shared_ptr<float> elapsed  = std::make_shared<float>(0.0f);
+	std::shared_ptr<FrameStats> sum = std::make_shared<FrameStats>();
+	engine.setUpdateFunc([&engine, label, frames, elapsed, sum](float delta) {
+		FrameStats stats = engine.getFrameStats();
+		sum->prepareTime += stats.prepareTime;
+		sum->renderTime  += stats.renderTime;
+		sum->refitTime   += stats.refitTime;
+		sum->cullTime    += stats.cullTime;
+		sum->packTime    += stats.packTime;
+		(*frames)++;
+		*elapsed += delta;
+		if (*elapsed < 2.0f) return;
+
+		float ms = 1000.0f / *frames;
+		std::cout << "[Benchmark] " << label << ": " << *frames / *elapsed << " fps, prepare "
+		          << sum->prepareTime * ms << " ms, render " << sum->renderTime * ms
+		          << " ms, cpu refit " << sum->refitTime * ms << " ms, cull " << sum->cullTime * ms
+		          << " ms, pack " << sum->packTime * ms << " ms" << std::endl;
+		*frames  = 0;
+		*elapsed = 0.0f;
+		*sum     = FrameStats{};
+	});
+}
+
+/**
+ * Fills a floor of cubes with small colored point lights, run with --lights <count>.
+ * Force llvmpipe with LIBGL_ALWAYS_SOFTWARE=1 to compare the clustered lighting on the cpu
+ */
+void addBenchmark(Engine& engine, ModelHandle cube, ModelHandle light, int count) {
+	EngineState* state = engine.getState();
+	ObjectManager& om  = state->objectManager;
+
+	for (int x = -15; x < 15; x++) {
+		for (int z = -25; z < 5; z++) {
+			Object tile = om.createObject(cube);
+			tile->setTranslation(glm::vec3(x, -3.0f, z));
+		}
+	}
+
+	std::mt19937 random{1234};
+	std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+	Tools::AttenuationParams attenParams{1.0f, 0.7f, 1.8f};
+	for (int i = 0; i < count; i++) {
+		glm::vec3 color = glm::vec3(unit(random), unit(random), unit(random)) * 0.6f + 0.1f;
+		Tools::LightColor lightColor{glm::vec3(0.0f), color, color * 0.5f};
+		Object obj = om.createObject(light);
+		obj->setTranslation(
+		  glm::vec3(unit(random) * 30.0f - 15.0f, unit(random) * 1.5f - 2.3f, unit(random) * 30.0f - 25.0f)
+		);
+		obj->setScale(0.05f);
+		state->lights.addPointLight(std::make_shared<PointLight>(obj, lightColor, attenParams));
+	}
+}
+
+/**
+ * Adds a static floor with pillars and bakes its light, run with --bake. Prints the
+ * progress and the time the bake took
+ */
+void addBakedScene(Engine& engine, LightmapBaker& baker, uint material) {
+	EngineState* state = engine.getState();
+	ObjectManager& om  = state->objectManager;
+	ModelHandle block  = om.registerModel("static", cubeVertices, PredefinedShader::BASIC, material).value();
+	om.setStatic(block, true);
+
+	Object floor = om.createObject(block);
+	floor->setTranslation(glm::vec3(0.0f, -3.5f, -5.0f));
+	floor->setScale(glm::vec3(20.0f, 0.5f, 20.0f));
+	for (int i = 0; i < 4; i++) {
+		Object pillar = om.createObject(block);
+		pillar->setTranslation(glm::vec3(-6.0f + i * 4.0f, -1.75f, -8.0f));
+		pillar->setScale(glm::vec3(1.0f, 3.0f, 1.0f));
+	}
+
+	LightmapBaker::Stats stats = baker.bake(om, state->lights, [](float progress) {
+		std::cout << "\r[Bake] " << (int)(progress * 100.0f) << "%" << std::flush;
+	});
+	std::cout << std::endl
+	          << "[Bake] " << stats.instances << " instances, " << stats.texels << " texels in "
+	          << stats.seconds << " s" << std::endl;
+}
+
+// A thread that only changes the scene through the command queue
+struct StressProducer {
+	std::thread thread;
+	// Filled on the scene thread, the producer takes the objects out
+	MpscQueue<Object> created;
+	std::vector<Object> owned;
+	size_t commands  = 0;
+	size_t destroyed = 0;
+	size_t dropped   = 0;
+};
+
+/**
+ * Keeps up to 64 objects alive and moves them every millisecond, some of them are
+ * destroyed and others are only dropped, which releases them on this thread
+ */
+void runStressProducer(
+  SceneCommandQueue* commands,
+  ModelHandle model,
+  StressProducer* producer,
+  const std::atomic<bool>& stop,
+  int seed
+) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+	while (!stop) {
+		Object obj;
+		while (producer->created.pop(&obj)) producer->owned.push_back(obj);
+		if (producer->owned.size() < 64) {
+			commands->createObject(model, [producer](Object created) { producer->created.push(created); });
+			producer->commands++;
+		}
+
+		for (Object& owned : producer->owned) {
+			commands->setTranslation(
+			  owned, glm::vec3(unit(random) * 20.0f - 10.0f, unit(random) * 4.0f, unit(random) * -20.0f)
+			);
+			commands->setScale(owned, glm::vec3(0.1f));
+		}
+		producer->commands += producer->owned.size() * 2;
+
+		if (!producer->owned.empty() && unit(random) < 0.2f) {
+			size_t index = random() % producer->owned.size();
+			if (unit(random) < 0.5f) {
+				commands->destroyObject(producer->owned[index]);
+				producer->commands++;
+				producer->destroyed++;
+			} else {
+				producer->dropped++;
+			}
+			producer->owned.erase(producer->owned.begin() + index);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/**
+ * Starts producer threads that only change the scene through the command queue while
+ * the scene is drawn, run with --stress <producers>
+ */
+void startStressTest(
+  Engine& engine,
+  ModelHandle model,
+  int count,
+  std::vector<std::unique_ptr<StressProducer>>& producers,
+  const std::atomic<bool>& stop
+) {
+	SceneCommandQueue* commands = engine.getState()->commands.get();
+	for (int i = 0; i < count; i++) {
+		producers.push_back(std::make_unique<StressProducer>());
+		StressProducer* producer = producers.back().get();
+		producer->thread         = std::thread(runStressProducer, commands, model, producer, std::cref(stop), i);
+	}
+}
+
+/**
+ * Stops the producers, applies what they left in the queue and checks that the scene holds
+ * exactly the objects the producers still own
+ * @return If the counts match
+ */
+bool finishStressTest(
+  Engine& engine,
+  ModelHandle model,
+  std::vector<std::unique_ptr<StressProducer>>& producers,
+  std::atomic<bool>& stop
+) {
+	stop = true;
+	for (auto& producer : producers) producer->thread.join();
+
+	EngineState* state = engine.getState();
+	state->commands->apply(state->objectManager, state->lights);
+	size_t owned = 0, commands = 0, destroyed = 0, dropped = 0;
+	for (auto& producer : producers) {
+		Object obj;
+		while (producer->created.pop(&obj)) producer->owned.push_back(obj);
+		owned     += producer->owned.size();
+		commands  += producer->commands;
+		destroyed += producer->destroyed;
+		dropped   += producer->dropped;
+	}
+
+	std::vector<ModelSnapshot> models;
+	state->objectManager.captureSnapshot(&models);
+	size_t instances = models.at(model).instances.size();
+	std::cout << "[Stress] " << producers.size() << " producers queued " << commands << " commands, "
+	          << destroyed << " objects destroyed and " << dropped << " dropped" << std::endl;
+	std::cout << "[Stress] " << instances << " instances in the scene, " << owned
+	          << " objects owned by the producers" << std::endl;
+	return instances == owned;
+}
+
+void printTextureStats(const MaterialManager& materials) {
+	size_t bytes = 0, uncompressed = 0;
+	for (const TextureStats& stats : materials.getTextureStats()) {
+		std::cout << "[Textures] " << stats.path << " " << stats.width << "x" << stats.height << ": "
+		          << stats.bytes / 1024 << " KiB" << (stats.compressed ? " compressed, " : ", ")
+		          << stats.uncompressedBytes / 1024 << " KiB uncompressed" << std::endl;
+		bytes        += stats.bytes;
+		uncompressed += stats.uncompressedBytes;
+	}
+	std::cout << "[Textures] " << bytes / 1024 << " KiB in total, " << uncompressed / 1024
+	          << " KiB without the cache" << std::endl;
+}
+
 int main(int argc, char* argv[]) {
+	// Every --option takes one value, except the flags --bake and --threaded
+	std::map<std::string, std::string> options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bake" || arg == "--threaded") options[arg] = "";
+		else if (arg.starts_with("--") && i + 1 < argc) options[arg] = argv[++i];
+	}
+
 	EngineArgs args{};
-	args.windowSamples = 16;
-	args.cubemapParams = "./apps/test/cubemap";
+	if (options.contains("--threads")) args.workerThreads = std::stoi(options["--threads"]);
+	args.simulationThread = options.contains("--threaded");
+	args.windowSamples         = 16;
+	args.cubemapParams         = "./apps/test/cubemap";
+	args.shaderCacheDirectory  = "./shaderCache";
+	args.textureCacheDirectory = "./textureCache";
 	// args.postProcessShader = "./apps/test/fragment/postprocessing.fs";
 	Engine engine{args};
 	EngineState* state = engine.getState();
@@ -22,9 +256,13 @@ int main(int argc, char* argv[]) {
 	MaterialManager* mm = om.getMaterialManager();
 	uint mat            = mm->createNew();
 	mm->addMaterial(mat, {"./apps/test/textures/crate.jpg", "./apps/test/textures/crate_specular.jpg", 32.0f});
-	om.registerModel("cube", cubeVertices, PredefinedShader::BASIC, mat);
-	om.registerModel("backpack", "./apps/test/models/backpack/backpack.obj", PredefinedShader::BASIC);
-	om.registerModel("light", cubeVertices, PredefinedShader::WHITE, 0);
+	ModelHandle cube =
+	  om.registerModel("cube", cubeVertices, PredefinedShader::BASIC, mat).value();
+	ModelHandle backpack =
+	  om.registerModel("backpack", "./apps/test/models/backpack/backpack.obj", PredefinedShader::BASIC)
+	    .value();
+	ModelHandle light =
+	  om.registerModel("light", cubeVertices, PredefinedShader::WHITE, 0).value();
 
 	// Add the lights
 	Tools::LightColor lightColor{glm::vec3(0.05f), glm::vec3(0.55f), glm::vec3(1.00f)};
@@ -32,12 +270,14 @@ int main(int argc, char* argv[]) {
 	std::shared_ptr<DirectionalLight> dir{
 	  new DirectionalLight{glm::vec3(-0.2f, -1.0f, -0.3f), lightColor}
 	};
+	dir->setCastShadows(true);
 	std::shared_ptr<PointLight> pointLight =
-	  std::make_shared<PointLight>(om.createObject("light"), lightColor, attenParams);
+	  std::make_shared<PointLight>(om.createObject(light), lightColor, attenParams);
 	pointLight->getObject()->setTranslation(glm::vec3(-2.0f, 0.3f, 1.0f));
 	pointLight->getObject()->setScale(0.2f);
+	pointLight->setCastShadows(true);
 	std::shared_ptr<PointLight> pointLight2 =
-	  std::make_shared<PointLight>(om.createObject("light"), lightColor, attenParams);
+	  std::make_shared<PointLight>(om.createObject(light), lightColor, attenParams);
 	pointLight2->getObject()->setTranslation(glm::vec3(0.5f, 1.2f, -9.0f));
 	pointLight2->getObject()->setScale(0.2f);
 
@@ -57,16 +297,42 @@ int main(int argc, char* argv[]) {
 
 	std::vector<Object> objs;
 	for (int i = 0; i < 2 && i < cubePositions.size(); i++) {
-		objs.push_back(om.createObject("cube"));
+		objs.push_back(om.createObject(cube));
 		objs.back()->addModifier(mod);
 		objs.back()->setTranslation(cubePositions.at(i));
 		objs.back()->setRotation(3.65f * i, 23.78f * i, 43.12f * i);
 	}
+	// A tinted copy of the crate, still drawn with the other cubes
+	objs.back()->setMaterial(mm->createVariant(mat, glm::vec4(1.0f, 0.6f, 0.6f, 1.0f)));
 
-	Object obj = om.createObject("backpack");
+	Object obj = om.createObject(backpack);
 	obj->setScale(0.1f);
 	obj->setTranslation(glm::vec3(0.0f, 0.0f, 2.0f));
 
+	// Run with --threads 1, 4 and 16 to compare the frame preparation on that many cores
+	std::string label;
+	if (options.contains("--lights")) {
+		addBenchmark(engine, cube, light, std::stoi(options["--lights"]));
+		label = options["--lights"] + " point lights";
+	}
+	if (options.contains("--threads"))
+		label += (label.empty() ? "" : ", ") + options["--threads"] + " threads";
+	if (!label.empty()) addFrameReport(engine, label);
+
+	LightmapBaker baker{state->jobs.get()};
+	if (options.contains("--bake")) addBakedScene(engine, baker, mat);
+
+	// A model of its own, so its instances are exactly the objects of the producers
+	std::optional<ModelHandle> stressModel;
+	std::vector<std::unique_ptr<StressProducer>> producers;
+	std::atomic<bool> stopProducers = false;
+	if (options.contains("--stress")) {
+		stressModel = om.registerModel("stress", cubeVertices, PredefinedShader::BASIC, mat).value();
+		startStressTest(engine, *stressModel, std::stoi(options["--stress"]), producers, stopProducers);
+	}
+
 	engine.start();
+	printTextureStats(*mm);
+	if (stressModel && !finishStressTest(engine, *stressModel, producers, stopProducers)) return 1;
 	return 0;
 }
@@ -1,17 +1,29 @@
 #pragma once
 
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/core/snapshotBuffer.hpp"
 #include "jaroViewer/core/window.hpp"
 #include "jaroViewer/graphics/cubemap.hpp"
 #include "jaroViewer/input/inputHandler.hpp"
+#include "jaroViewer/lighting/lightClusters.hpp"
 #include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/lighting/shadowMaps.hpp"
+#include "jaroViewer/rendering/deferredRenderer.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
 #include "jaroViewer/rendering/postProcessor.hpp"
-#include "jaroViewer/rendering/uniformBuffer.hpp"
 #include "jaroViewer/scene/camera.hpp"
 #include "jaroViewer/scene/objectManager.hpp"
+#include "jaroViewer/scene/sceneCommandQueue.hpp"
+#include "jaroViewer/scene/sceneSnapshot.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 
 namespace JaroViewer {
 	struct EngineArgs {
@@ -24,24 +36,106 @@ namespace JaroViewer {
 		uint windowSamples            = 1;
 		std::string postProcessShader = "";
 		std::variant<std::string, std::vector<std::string>> cubemapParams = "";
+
+		// Threads used for frame preparation, 0 uses all hardware threads
+		uint workerThreads = 0;
+
+		// Runs the updates and inputs on their own thread at a fixed rate,
+		// the renderer interpolates between the two newest updates. The update function
+		// may then change objects and lights, create or destroy objects and create material
+		// variants. Models and materials with textures create gl objects, so they are
+		// registered before the engine starts
+		bool simulationThread = false;
+		float simulationRate  = 60.0f;
+
+		// Frames the cpu can prepare while the gpu still reads an earlier one
+		uint framesInFlight = 3;
+
+		// Clusters of the clustered lighting on the x and y axis of the screen and in depth
+		glm::uvec3 clusterGrid   = glm::uvec3(16, 9, 24);
+		uint maxLightsPerCluster = 255;
+
+		// Point lights and spotlights in view that are culled each frame, the most relevant ones
+		// are kept. 0 keeps every light whose range reaches the view frustum
+		uint maxActiveLights = 0;
+
+		// Shades the basic shader models once per pixel from a G-buffer, the window
+		// samples do not apply to them
+		bool deferredShading = false;
+
+		// Draws the depth of the basic shader models first, so the lighting only runs
+		// for visible fragments. Models can override it in the object manager
+		bool depthPrePass = false;
+
+		// Shadow maps of the lights that cast shadows share one atlas of this width and height,
+		// the cascades of the directional lights end at the shadow distance
+		uint shadowAtlasSize = 4096;
+		float shadowDistance = 40.0f;
+
+		// Material textures are decoded on the worker threads and uploaded in pieces of at
+		// most this many bytes per frame, they show a placeholder until they are complete
+		size_t textureUploadBudget = 8 << 20;
+
+		// Linked shader programs are stored in this directory and loaded on the next start,
+		// empty compiles every shader
+		std::string shaderCacheDirectory = "";
+
+		// Material textures are block compressed with all their mip levels once and stored in
+		// this directory, empty uploads every image uncompressed
+		std::string textureCacheDirectory = "";
+	};
+
+	struct FrameStats {
+		float updateTime;
+		float prepareTime;
+		float renderTime;
+
+		// Cpu time of the instance refits of the update, and of the culling and packing of the
+		// frame, summed over the worker threads
+		float refitTime;
+		float cullTime;
+		float packTime;
+
+		// Fragment shader invocations the depth pre-pass saved, 0 without pipeline statistics
+		uint64_t savedFragmentInvocations;
+
+		// Point lights and spotlights that reached the light culling this frame
+		uint activeLights;
+
+		// Shadow tiles and cubes rendered and reused this frame, and the memory of the shadow
+		// atlas and the point light cubes
+		uint shadowTilesRendered;
+		uint shadowTilesCached;
+		size_t shadowAtlasBytes;
+		size_t shadowAtlasUsedBytes;
+
+		// Seconds from the start of the engine to the end of the first frame, and the shader
+		// programs loaded from the cache and compiled until then
+		float timeToFirstFrame;
+		uint programsLoaded;
+		uint programsCompiled;
 	};
 
 	struct EngineState {
 		Window window;
 		Camera camera;
 		InputHandler input;
+		std::unique_ptr<JobSystem> jobs;
 		ObjectManager objectManager;
 		LightSet lights;
+		std::unique_ptr<SceneCommandQueue> commands;
 		std::optional<Cubemap> cubemap;
 		std::optional<PostProcessor> postProcessor;
 
-		EngineState(Window&& w, Camera c, std::optional<Cubemap> cm, std::optional<PostProcessor> pp)
+		EngineState(Window&& w, Camera c, std::optional<PostProcessor> pp, uint workerThreads)
 		  : window(std::move(w)),
 		    camera(std::move(c)),
 		    input(&this->window),
-		    objectManager(),
+		    jobs(std::make_unique<JobSystem>(workerThreads)),
+		    objectManager(jobs.get()),
 		    lights(),
-		    cubemap(std::move(cm)),
+		    commands(std::make_unique<SceneCommandQueue>()),
+		    cubemap(),
 		    postProcessor(std::move(pp)) {}
 	};
 
@@ -53,6 +147,7 @@ namespace JaroViewer {
 
 		void start();
 		EngineState* getState();
+		FrameStats getFrameStats() const;
 		void triggerClick(InputHandler::KeyAction action, InputParams params);
 
 		void setUpdateFunc(std::function<void(float delta)> func);
@@ -63,13 +158,61 @@ namespace JaroViewer {
 		struct Tranformation {
 			glm::mat4 projection;
 			glm::mat4 view;
+			glm::vec3 viewPos;
+			float pad;
+		};
+
+		struct PickRequest {
+			InputHandler::KeyAction action;
+			int x, y;
+		};
+
+		struct PickResult {
+			InputHandler::KeyAction action;
+			InstanceKey instance;
+		};
+
+		// Terminates glfw when it is destroyed, declared before the state so every gl object is gone by then
+		struct GlfwLibrary {
+			~GlfwLibrary();
 		};
 
 		void render();
+		void simulate(float delta);
+		void simulationLoop();
+		void captureSnapshot(float updateTime);
+		void processPicks();
+		void renderDeferred(const glm::mat4& viewProjection);
 
+		GlfwLibrary mGlfw;
 		EngineState mState;
-		std::shared_ptr<UniformBuffer> mTransformUBO;
-		std::shared_ptr<UniformBuffer> mLightsUBO;
+		// Written by the render loop, a copy is published at the end of every frame
+		FrameStats mFrameStats;
+		mutable std::mutex mStatsMutex;
+		FrameStats mPublishedStats;
+
+		// Simulation
+		bool mThreaded;
+		float mSimulationRate;
+		std::thread mSimulation;
+		std::atomic<bool> mStopSimulation;
+		SnapshotBuffer<SceneSnapshot> mSnapshots;
+
+		// Clicks are rendered on the render thread and handled on the simulation thread
+		std::mutex mPickMutex;
+		std::vector<PickRequest> mPickRequests;
+		std::vector<PickResult> mPickResults;
+		uint mFramesInFlight;
+		std::unique_ptr<FrameRingBuffer> mFrameRing;
+		glm::uvec3 mClusterGrid;
+		uint mMaxLightsPerCluster;
+		uint mMaxActiveLights;
+		std::unique_ptr<LightClusters> mLightClusters;
+		bool mDeferredShading;
+		std::unique_ptr<DeferredRenderer> mDeferred;
+		uint mShadowAtlasSize;
+		float mShadowDistance;
+		std::unique_ptr<ShadowMaps> mShadowMaps;
 
 		std::function<void(float delta)> mUpdateFunc;
 	};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace JaroViewer {
+	using Job = std::function<void()>;
+
+	class JobSystem {
+	public:
+		JobSystem(uint numThreads = 0);
+		JobSystem(const JobSystem&)            = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		uint getNumThreads() const;
+
+		void submit(Job job);
+		void submitBackground(Job job);
+		void waitFor(const std::atomic<size_t>& remaining);
+		void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& func);
+
+	private:
+		struct Worker {
+			std::deque<Job> jobs;
+			std::mutex mutex;
+		};
+
+		void workerLoop(int index);
+		bool runOne(int ownIndex);
+		bool runBackground();
+		bool hasWork(int index) const;
+		bool popJob(uint index, Job* out);
+		bool stealJob(int thief, Job* out);
+
+		std::vector<std::unique_ptr<Worker>> mWorkers;
+		std::vector<std::thread> mThreads;
+		std::atomic<size_t> mPending;
+		std::atomic<uint> mNextWorker;
+		std::atomic<bool> mStopping;
+
+		// Long jobs like image decodes, only the pool takes them when it is idle and a waiting
+		// thread never does. At most mMaxBackground of them run at once
+		std::deque<Job> mBackground;
+		std::mutex mBackgroundMutex;
+		std::atomic<size_t> mPendingBackground;
+		std::atomic<uint> mRunningBackground;
+		uint mMaxBackground;
+
+		std::mutex mSleepMutex;
+		std::condition_variable mWakeUp;
+	};
+
+	class TaskGraph {
+	public:
+		using TaskHandle = size_t;
+
+		TaskHandle addTask(Job func);
+		TaskHandle addContinuation(TaskHandle task, Job func);
+		void addDependency(TaskHandle before, TaskHandle after);
+
+		void run(JobSystem& jobs);
+
+	private:
+		struct Task {
+			Job func;
+			std::vector<TaskHandle> successors;
+			uint numDependencies;
+			std::atomic<uint> pending;
+		};
+
+		void schedule(JobSystem& jobs, TaskHandle task, std::atomic<size_t>& remaining);
+
+		std::vector<std::unique_ptr<Task>> mTasks;
+	};
+} // namespace JaroViewer
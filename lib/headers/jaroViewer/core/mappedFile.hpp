@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace JaroViewer {
+	/**
+	 * Read only mapping of a whole file, an empty file has no mapping
+	 */
+	class MappedFile {
+	public:
+		MappedFile(const std::string& path);
+		MappedFile(const MappedFile&)            = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool isOpen() const;
+		std::string_view getView() const;
+
+	private:
+		const char* mData;
+		size_t mSize;
+		bool mOpen;
+	};
+} // namespace JaroViewer
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+namespace JaroViewer {
+	/**
+	 * Lock free queue that any amount of threads can push into and one thread pops from.
+	 * Producers only swap the head, the consumer owns the tail
+	 */
+	template<typename T>
+	class MpscQueue {
+	public:
+		MpscQueue();
+		MpscQueue(const MpscQueue&)            = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+		~MpscQueue();
+
+		void push(T value);
+		bool pop(T* out);
+
+	private:
+		struct Node {
+			std::atomic<Node*> next{nullptr};
+			std::optional<T> value{};
+		};
+
+		std::atomic<Node*> mHead;
+		Node* mTail;
+	};
+
+	template<typename T>
+	MpscQueue<T>::MpscQueue() {
+		Node* stub = new Node();
+		mHead.store(stub, std::memory_order_relaxed);
+		mTail = stub;
+	}
+
+	template<typename T>
+	MpscQueue<T>::~MpscQueue() {
+		T value;
+		while (pop(&value));
+		delete mTail;
+	}
+
+	/**
+	 * Adds a value to the queue, can be called from any thread
+	 */
+	template<typename T>
+	void MpscQueue<T>::push(T value) {
+		Node* node = new Node();
+		node->value.emplace(std::move(value));
+		Node* prev = mHead.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/**
+	 * Takes the oldest value of the queue, may only be called from the consuming thread
+	 * @param out The value that was taken
+	 * @return If there was a value, a push that is still in progress counts as empty
+	 */
+	template<typename T>
+	bool MpscQueue<T>::pop(T* out) {
+		Node* tail = mTail;
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr) return false;
+
+		// The next node becomes the new stub
+		*out = std::move(*next->value);
+		next->value.reset();
+		mTail = next;
+		delete tail;
+		return true;
+	}
+} // namespace JaroViewer
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <sys/types.h>
+
+namespace JaroViewer {
+	/**
+	 * Lock free buffer between one writer and one reader. The writer fills its own slot
+	 * and publishes it, the reader keeps the two newest published slots so it can
+	 * interpolate between them. Slots are reused, so their allocations survive
+	 */
+	template<typename T>
+	class SnapshotBuffer {
+	public:
+		SnapshotBuffer();
+		SnapshotBuffer(const SnapshotBuffer&)            = delete;
+		SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+		// Writer side
+		T& getWriteSlot();
+		void publish();
+
+		// Reader side
+		bool acquire();
+		const T& getPrevious() const;
+		const T& getCurrent() const;
+
+	private:
+		static constexpr uint cFRESH = 4;
+		static constexpr uint cINDEX = 3;
+
+		std::array<T, 4> mSlots;
+		uint mWriteIndex;
+		uint mPreviousIndex;
+		uint mCurrentIndex;
+
+		// Index of the slot in between, with the fresh bit set when it was not read yet
+		std::atomic<uint> mMiddle;
+	};
+
+	template<typename T>
+	SnapshotBuffer<T>::SnapshotBuffer()
+	  : mSlots(), mWriteIndex(0), mPreviousIndex(1), mCurrentIndex(2), mMiddle(3) {}
+
+	template<typename T>
+	T& SnapshotBuffer<T>::getWriteSlot() {
+		return mSlots[mWriteIndex];
+	}
+
+	/**
+	 * Hands the write slot to the reader, the writer continues with an unused slot
+	 */
+	template<typename T>
+	void SnapshotBuffer<T>::publish() {
+		mWriteIndex = mMiddle.exchange(mWriteIndex | cFRESH, std::memory_order_acq_rel) & cINDEX;
+	}
+
+	/**
+	 * Takes the newest published slot, the oldest slot of the reader goes back to the writer
+	 * @return If a new slot was published since the last call
+	 */
+	template<typename T>
+	bool SnapshotBuffer<T>::acquire() {
+		if ((mMiddle.load(std::memory_order_relaxed) & cFRESH) == 0) return false;
+		uint newest    = mMiddle.exchange(mPreviousIndex, std::memory_order_acq_rel) & cINDEX;
+		mPreviousIndex = mCurrentIndex;
+		mCurrentIndex  = newest;
+		return true;
+	}
+
+	template<typename T>
+	const T& SnapshotBuffer<T>::getPrevious() const {
+		return mSlots[mPreviousIndex];
+	}
+
+	template<typename T>
+	const T& SnapshotBuffer<T>::getCurrent() const {
+		return mSlots[mCurrentIndex];
+	}
+} // namespace JaroViewer
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <glm/glm.hpp>
 #include <string>
 #include <sys/types.h>
@@ -39,13 +40,22 @@ namespace JaroViewer {
 		Size getSize() const;
 		GLFWwindow* cPtr() const;
 		glm::mat4 getProjection() const;
+		float getNearPlane() const;
+		float getFarPlane() const;
 
 	private:
+		static constexpr float cNEARPLANE = 0.1f;
+		static constexpr float cFARPLANE  = 100.0f;
+
 		GLFWwindow* mWindow;
 		int mWidth, mHeight;
 		int mWindowedWidth, mWindowedHeight;
 		int mPosX, mPosY;
 		uint mSamples = 1;
 		bool mIsFullscreen;
+
+		// Requested from any thread, applied on the main thread
+		std::atomic<int> mMouseMode;
+		int mAppliedMouseMode;
 	};
 } // namespace JaroViewer
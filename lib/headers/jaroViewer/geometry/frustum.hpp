@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+namespace JaroViewer {
+	class Frustum {
+	public:
+		Frustum();
+		Frustum(const glm::mat4& viewProjection);
+
+		bool intersects(const glm::vec3& minPoint, const glm::vec3& maxPoint) const;
+		bool intersects(const glm::vec3& center, float radius) const;
+
+		static void transformBounds(
+		  const glm::mat4& model,
+		  const glm::vec3& minPoint,
+		  const glm::vec3& maxPoint,
+		  glm::vec3* outMin,
+		  glm::vec3* outMax
+		);
+
+	private:
+		// Planes as (normal, distance), a point is inside when dot(normal, p) + distance >= 0
+		std::array<glm::vec4, 6> mPlanes;
+	};
+} // namespace JaroViewer
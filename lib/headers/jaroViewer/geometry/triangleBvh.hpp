@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Bounding volume hierarchy over world space triangles for ray casts on the cpu,
+	 * built with binned surface area heuristic splits
+	 */
+	class TriangleBvh {
+	public:
+		struct Hit {
+			float distance;
+			uint triangle;
+		};
+
+		TriangleBvh(std::vector<glm::vec3> corners);
+
+		std::optional<Hit> intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+		bool occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+		glm::vec3 getNormal(uint triangle) const;
+		size_t getNumTriangles() const;
+
+	private:
+		// An inner node has no triangles, its children are at first and first + 1
+		struct Node {
+			glm::vec3 boundsMin;
+			uint first;
+			glm::vec3 boundsMax;
+			uint count;
+		};
+
+		void build(uint node, uint depth);
+		float intersectTriangle(uint triangle, const glm::vec3& origin, const glm::vec3& direction) const;
+		template <bool AnyHit>
+		std::optional<Hit> traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+		// Three corners per triangle, in the order of mTriangles after the build
+		std::vector<glm::vec3> mCorners;
+		std::vector<uint> mTriangles;
+		std::vector<glm::vec3> mCentroids;
+		std::vector<Node> mNodes;
+	};
+} // namespace JaroViewer
@@ -1,15 +1,26 @@
 #pragma once
 
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/graphics/textureLoader.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
 #include "jaroViewer/rendering/shader.hpp"
 
+#include <memory>
 #include <string>
+#include <sys/types.h>
 #include <vector>
 
 namespace JaroViewer {
+	/**
+	 * Skybox of six images, the faces are read in background jobs and streamed in through
+	 * the texture loader. Nothing is drawn until all faces arrived
+	 */
 	class Cubemap {
 	public:
-		Cubemap(const std::vector<std::string>& paths);
-		Cubemap(const std::string& dir);
+		Cubemap(const std::vector<std::string>& paths, JobSystem* jobs);
+		Cubemap(const std::string& dir, JobSystem* jobs);
+		void update(FrameRingBuffer& ring);
+		void setUploadBudget(size_t bytes);
 		void render() const;
 
 		void bind() const;
@@ -19,12 +30,14 @@ namespace JaroViewer {
 		void loadVao();
 		std::vector<std::string> getPaths(const std::string dir) const;
 		void loadMap(const std::vector<std::string>& paths);
-		void genBuffer();
-		void bindTextures(const std::vector<std::string>& paths);
+		void genBuffer(uint texture);
+		void copyFace(uint face, uint texture);
 		void setupParams() const;
 
 		unsigned int mCubemap;
 		unsigned int mVaoBuffer;
 		Shader mShader;
+		std::unique_ptr<TextureLoader> mLoader;
+		uint mFacesLoaded;
 	};
 } // namespace JaroViewer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sys/types.h>
+#include <vector>
 
 namespace JaroViewer {
 	struct FrameBufferArgs {
@@ -9,6 +10,9 @@ namespace JaroViewer {
 		bool readableColor;
 		bool readableDepthStencil;
 		uint formatType;
+
+		// Formats of extra readable color attachments, drawn to as render targets 1 and up
+		std::vector<uint> extraColorFormats = {};
 	};
 
 	class FrameBuffer {
@@ -23,7 +27,9 @@ namespace JaroViewer {
 		void clear(float r, float g, float b, float a) const;
 
 		uint getColor() const;
+		uint getColor(uint index) const;
 		uint getDepthStencil() const;
+		void blitDepthStencil(const FrameBuffer& target) const;
 
 	private:
 		void genBuffer();
@@ -32,6 +38,7 @@ namespace JaroViewer {
 		uint bindTexture(uint usage, uint formatType);
 		uint bindRenderBuffer(uint usage);
 		void createStorage(bool readable, uint* textureStorage, uint* renderStorage, uint usage, uint formatType);
+		void createExtraColors();
 
 		uint mID;
 		uint mColorTexture;
@@ -44,5 +51,7 @@ namespace JaroViewer {
 		bool mReadableColor;
 		bool mReadableDepthStencil;
 		uint mFormatType;
+		std::vector<uint> mExtraColorFormats;
+		std::vector<uint> mExtraColorTextures;
 	};
 } // namespace JaroViewer
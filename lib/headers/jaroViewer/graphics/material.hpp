@@ -1,9 +1,11 @@
 #pragma once
 
-#include "jaroViewer/graphics/texture2D.hpp"
-#include "jaroViewer/rendering/shader.hpp"
+#include "jaroViewer/graphics/textureArrays.hpp"
 
+#include <glm/glm.hpp>
 #include <string>
+#include <sys/types.h>
+#include <vector>
 
 namespace JaroViewer {
 	struct MaterialArgs {
@@ -17,21 +19,36 @@ namespace JaroViewer {
 		float shininess;
 	};
 
+	// Element of the material storage block, std430. The colors multiply the textures, a
+	// material without textures only has its colors
+	struct MaterialData {
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+		uint diffuse;
+		uint specular;
+		float shininess;
+		uint pad = 0;
+	};
+
+	// The textures are indices into the textures of the material manager, a texture that is
+	// still loading points to a placeholder there. A flat color is no texture at all
 	class Material {
 	public:
-		Material(const Texture2D& diffuse, const Texture2D& specular, float shininess);
-		Material(const MaterialArgs& args);
-		Material(const ColorMaterialArgs& args);
+		// Stored in place of a texture, the shaders use the color without sampling
+		static const uint cNOTEXTURE = 0xFFFFFFFF;
 
-		void load(const Shader* shader, uint offset = 0) const;
-		void loadIntoArray(const Shader* shader, int arrayIndex, uint offset = 0) const;
+		Material(uint diffuse, uint specular, float shininess);
+		Material(const glm::vec4& diffuse, const glm::vec4& specular, float shininess);
 
-	private:
-		std::string mVariableName;
-		std::string mArrayName;
+		Material withTint(const glm::vec4& tint) const;
+		MaterialData getData(const std::vector<TextureLayer>& textures) const;
 
-		Texture2D mDiffuse;
-		Texture2D mSpecular;
+	private:
+		uint mDiffuse;
+		uint mSpecular;
+		glm::vec4 mDiffuseColor;
+		glm::vec4 mSpecularColor;
 		float mShininess;
+		glm::vec4 mTint;
 	};
 } // namespace JaroViewer
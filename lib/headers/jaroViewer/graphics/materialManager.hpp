@@ -1,28 +1,69 @@
 #pragma once
 
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
+#include "jaroViewer/rendering/storageBuffer.hpp"
 #include "material.hpp"
-#include "texture2D.hpp"
+#include "textureArrays.hpp"
+#include "textureLoader.hpp"
 
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace JaroViewer {
+	/**
+	 * Owns the materials and their textures. The textures live in texture arrays and the
+	 * materials in one storage buffer, so a draw selects its material by index without
+	 * binding anything. Image files are loaded in the background, their materials show a
+	 * placeholder until the texture arrived
+	 */
 	class MaterialManager {
 	public:
-		MaterialManager();
+		MaterialManager(JobSystem* jobs);
 
 		uint createNew();
 		void addMaterial(uint ident, const MaterialArgs& args);
 		void addMaterial(uint ident, const ColorMaterialArgs& args);
-		void resetLastShader() { mLastShader = nullptr; }
+		uint createVariant(uint ident, const glm::vec4& tint);
 
-		void loadMaterial(Shader* shader, uint ident, uint offset = 0);
+		void upload(FrameRingBuffer& ring);
+		void bindTextures() const;
+		uint getIndex(uint ident) const;
+		uint getNumTextures(uint ident) const;
+		void setUploadBudget(size_t bytes);
+		uint getNumLoading() const;
+		const std::vector<TextureStats>& getTextureStats() const;
 
 	private:
+		uint loadTexture(const std::string& path);
+		TextureLayer getPlaceholder();
+
 		std::vector<std::vector<Material>> mMaterials;
-		std::map<std::string, std::shared_ptr<Texture2D>> mTextures;
-		uint mLastMaterial;
-		Shader* mLastShader; // Only used to compare in loading, not for use
+		std::map<std::string, uint> mTextures;
+		std::unique_ptr<TextureArrays> mTextureArrays;
+		std::unique_ptr<TextureLoader> mLoader;
+
+		// The layer of every texture, the materials refer to an index in it
+		std::vector<TextureLayer> mTextureLayers;
+		std::optional<TextureLayer> mPlaceholder;
+
+		// The buffer starts with an empty material for the draws without one
+		std::unique_ptr<StorageBuffer> mBuffer;
+		std::vector<uint> mFirstMaterial;
+		bool mDirty;
+
+		// Copied from the materials on upload, the draws only read these
+		std::vector<uint> mNumTextures;
+
+		// Guards the materials and the dirty flag, variants may be created on the simulation thread
+		std::unique_ptr<std::mutex> mMutex;
+
+		// The thread with the gl context, the only one that may load textures
+		std::thread::id mGlThread;
 	};
 } // namespace JaroViewer
@@ -11,13 +11,13 @@ namespace JaroViewer {
 		Texture2D(const glm::vec4 color);
 
 		void bind(unsigned int position) const;
+		void destroy();
 		unsigned int getID() const;
 
 	private:
 		void genTexture();
 		void setupParameters();
 		void loadImageToTexture(const char* filepath, bool flip);
-		uint getFileFormat(int numChannels) const;
 
 		unsigned int mTextureID;
 	};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	// A layer of one of the texture arrays, the shaders get it packed in one uint
+	struct TextureLayer {
+		uint array;
+		uint layer;
+
+		uint pack() const { return array << 16 | layer; }
+	};
+
+	/**
+	 * Textures of the same size and format share one GL_TEXTURE_2D_ARRAY, so every
+	 * material texture is bound with a single call per pass. An array doubles when it is
+	 * full, a texture of a new size that finds all units taken is scaled into the array
+	 * of the closest size
+	 */
+	class TextureArrays {
+	public:
+		// sampleMaterial of the material shaders has a case for every array
+		static const uint cMAXARRAYS = 12;
+
+		TextureArrays(uint firstUnit);
+		TextureArrays(const TextureArrays&)            = delete;
+		TextureArrays& operator=(const TextureArrays&) = delete;
+		~TextureArrays();
+
+		TextureLayer add(uint texture);
+		void bind() const;
+
+	private:
+		struct Array {
+			uint texture;
+			uint format;
+			int width;
+			int height;
+			int levels;
+			uint layers;
+			uint capacity;
+		};
+
+		uint findArray(uint format, int width, int height, bool* exact);
+		void grow(Array& array);
+		void copyLevels(uint texture, const Array& array, uint layer);
+		void copyScaled(uint texture, int width, int height, const Array& array, uint layer);
+
+		std::vector<Array> mArrays;
+		uint mFirstUnit;
+		uint mReadFramebuffer;
+		uint mDrawFramebuffer;
+	};
+} // namespace JaroViewer
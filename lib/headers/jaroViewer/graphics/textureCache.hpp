@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	// One level of a texture, the pixels are rows of texels or rows of 4x4 blocks
+	struct TextureLevel {
+		int width;
+		int height;
+		const unsigned char* pixels;
+		size_t size;
+	};
+
+	/**
+	 * The pixels of a texture ready for upload. Only level 0 is given when the mipmaps
+	 * are generated on the gpu
+	 */
+	struct TextureData {
+		uint internalFormat;
+		// The format of the uploaded pixels, 0 for a block compressed format
+		uint pixelFormat;
+		int channels;
+		int levels;
+		std::vector<TextureLevel> data;
+		// Owns the pixels, the mapping of a cache file or a decoded image
+		std::shared_ptr<const void> storage;
+
+		bool isCompressed() const;
+		int getRowCount(int level) const;
+		size_t getRowSize(int level) const;
+		void uploadRows(uint texture, int level, int row, int rows, const void* pixels) const;
+
+		size_t getMemory() const;
+		size_t getUncompressedMemory() const;
+	};
+
+	/**
+	 * On-disk cache of block compressed textures with all their mip levels. The levels
+	 * are built on the cpu the first time an image is read, one channel images become BC4,
+	 * two channel images BC5 and all others BC7. A cache file is stored under a hash of
+	 * the path, the modification time and the size of the image and is memory mapped when
+	 * it is read. Disabled until a directory is set, images are uploaded uncompressed then
+	 */
+	class TextureCache {
+	public:
+		struct Stats {
+			uint loaded;
+			uint built;
+		};
+
+		static void setDirectory(const std::string& directory);
+		static bool isEnabled();
+
+		static std::optional<TextureData> read(const std::string& path, bool flip, std::string* error);
+		static uint createTexture(const TextureData& data);
+		static uint getPixelFormat(int channels);
+		static Stats getStats();
+
+	private:
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint32_t internalFormat;
+			uint32_t channels;
+			uint32_t width;
+			uint32_t height;
+			uint32_t levels;
+			uint32_t pad;
+		};
+
+		struct State {
+			std::string directory;
+			std::atomic<uint> loaded;
+			std::atomic<uint> built;
+		};
+
+		static std::optional<TextureData> load(const std::string& path, uint64_t key);
+		static std::optional<TextureData> build(const std::string& path, uint64_t key, bool flip, std::string* error);
+		static std::optional<TextureData> decode(const std::string& path, bool flip, std::string* error);
+		static std::optional<uint64_t> getKey(const std::string& path, bool flip);
+		static std::string getPath(uint64_t key);
+		static State& getState();
+	};
+} // namespace JaroViewer
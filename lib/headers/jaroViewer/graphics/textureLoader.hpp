@@ -0,0 +1,82 @@
+#pragma once
+
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/core/mpscQueue.hpp"
+#include "jaroViewer/graphics/textureCache.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	// The memory of a loaded texture on the gpu, and the memory it takes uncompressed
+	struct TextureStats {
+		std::string path;
+		int width;
+		int height;
+		bool compressed;
+		size_t bytes;
+		size_t uncompressedBytes;
+	};
+
+	/**
+	 * Reads image files in background jobs, from the texture cache when it is enabled, and
+	 * uploads them on the gl thread. The pixels are staged in the frame ring and copied into
+	 * the texture a few rows at a time, at most the budget is uploaded per frame so a large
+	 * image is spread over several frames. A texture is allocated immutably once its size is
+	 * known and handed over when all its levels are complete
+	 */
+	class TextureLoader {
+	public:
+		// Called on the gl thread, the texture is owned by the caller and 0 when the image could not be read
+		using Callback = std::function<void(uint request, uint texture)>;
+
+		TextureLoader(JobSystem* jobs, size_t budget);
+		TextureLoader(const TextureLoader&)            = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+		~TextureLoader();
+
+		void load(const std::string& path, bool flip, uint request);
+		void update(FrameRingBuffer& ring, const Callback& callback);
+		void setBudget(size_t bytes);
+		uint getNumPending() const;
+		const std::vector<TextureStats>& getStats() const;
+
+		static uint createPlaceholder(const glm::vec4& color);
+
+	private:
+		struct Image {
+			std::string path;
+			bool flip;
+			uint request;
+			std::optional<TextureData> data;
+			std::string error;
+		};
+		struct Upload {
+			std::unique_ptr<Image> image;
+			uint texture;
+			int level;
+			int row;
+		};
+
+		void startUpload(std::unique_ptr<Image> image, const Callback& callback);
+
+		JobSystem* mJobs;
+		size_t mBudget;
+		uint mPending;
+
+		// Images that are queued or being decoded, the destructor waits on them
+		std::atomic<size_t> mDecoding;
+		MpscQueue<std::unique_ptr<Image>> mDecoded;
+		std::deque<Upload> mUploads;
+		std::vector<TextureStats> mStats;
+	};
+} // namespace JaroViewer
@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <map>
+#include <mutex>
 #include <vector>
 
 namespace JaroViewer {
@@ -18,10 +19,17 @@ namespace JaroViewer {
 		enum class KeyAction { DOWN, UP, PRESS, RELEASE };
 
 		InputHandler(Window* window);
+		InputHandler(InputHandler&& other) noexcept;
+		InputHandler(const InputHandler&)            = delete;
+		InputHandler& operator=(const InputHandler&) = delete;
+
 		Window* getWindow() const;
 		void addKey(int key, KeyAction action, std::function<void(InputParams)> func);
 		void addMouseKey(int key, KeyAction action, std::function<void(InputParams)> func);
 		void addMouseMoveEvent(std::function<void(GLFWwindow*, double, double)> func);
+
+		// Polling has to happen on the main thread, processing can happen on any thread
+		void pollInputs();
 		void processInputs(float deltaTime);
 
 	private:
@@ -32,10 +40,25 @@ namespace JaroViewer {
 			bool isPressed;
 			KeyAction action;
 			bool isKey;
+
+			// Edges seen by the polls since the last time the inputs were processed
+			bool wasPressed;
+			bool wasReleased;
+		};
+
+		struct CursorMove {
+			double x, y;
 		};
 
 		Window* mWindow;
 		std::map<int, KeyState> mKeys;
 		std::vector<std::function<void(GLFWwindow*, double, double)>> mMouseMoveEvents;
+
+		// Polled state, guarded by the mutex
+		std::mutex mPollMutex;
+		std::vector<CursorMove> mCursorMoves;
+		std::vector<CursorMove> mProcessedMoves;
+		int mCursorX, mCursorY;
+		bool mCursorInScreen;
 	};
 } // namespace JaroViewer
@@ -11,7 +11,7 @@ namespace JaroViewer {
 			glm::vec3 direction;
 			int enable;
 			glm::vec3 ambient;
-			float pad1;
+			int castShadows;
 			glm::vec3 diffuse;
 			float pad2;
 			glm::vec3 specular;
@@ -21,11 +21,17 @@ namespace JaroViewer {
 		DirectionalLight(glm::vec3 direction, Tools::LightColor lightColor);
 
 		void enable(bool enable);
+		void setCastShadows(bool castShadows);
 		DirectionalLightStruct getStruct() const;
 
+		bool isDirty() const;
+		void setClean();
+
 	private:
 		glm::vec3 mDirection;
 		Tools::LightColor mLightColor;
 		bool mEnable;
+		bool mCastShadows;
+		bool mDirty;
 	};
 } // namespace JaroViewer
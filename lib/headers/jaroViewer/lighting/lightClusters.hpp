@@ -0,0 +1,76 @@
+#pragma once
+
+#include "jaroViewer/core/window.hpp"
+#include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
+#include "jaroViewer/rendering/shader.hpp"
+#include "jaroViewer/rendering/storageBuffer.hpp"
+#include "jaroViewer/rendering/uniformBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Clustered forward lighting, the view frustum is split into a grid of clusters and
+	 * a compute pass lists the point lights and spotlights that reach every cluster.
+	 * Fragments only shade the lights of their own cluster. Every frame the lights that
+	 * reach the view frustum are ranked on relevance, so a full cluster drops the least
+	 * relevant lights and lights out of view never reach the culling pass
+	 */
+	class LightClusters {
+	public:
+		LightClusters(const glm::uvec3& grid, uint maxLightsPerCluster, uint maxActiveLights = 0);
+
+		void upload(const LightSet::Image& image, FrameRingBuffer& ring);
+		void build(
+		  const LightSet::Image& image,
+		  const glm::mat4& view,
+		  const glm::mat4& projection,
+		  Size size,
+		  float nearPlane,
+		  float farPlane,
+		  FrameRingBuffer& ring
+		);
+		uint getNumActiveLights() const;
+
+	private:
+		struct ClusterStruct {
+			glm::mat4 inverseProjection;
+			glm::mat4 view;
+			glm::uvec4 grid;
+			glm::vec4 screen;
+		};
+
+		void selectLights(
+		  const LightSet::Image& image,
+		  const glm::mat4& view,
+		  const glm::mat4& projection,
+		  FrameRingBuffer& ring
+		);
+		void uploadArray(
+		  StorageBuffer& buffer,
+		  const void* data,
+		  const std::vector<uint>& versions,
+		  size_t stride,
+		  FrameRingBuffer& ring
+		);
+
+		glm::uvec3 mGrid;
+		uint mMaxLights;
+		uint mMaxActiveLights;
+		Shader mCulling;
+
+		UniformBuffer mHeader;
+		StorageBuffer mPointLights;
+		StorageBuffer mSpotlights;
+		StorageBuffer mClusterLights;
+		uint mUploadedVersion;
+
+		// The relevance and index of the lights in view, the indices are uploaded after the count
+		std::vector<std::pair<float, uint>> mScores;
+		std::vector<uint> mActiveLights;
+	};
+} // namespace JaroViewer
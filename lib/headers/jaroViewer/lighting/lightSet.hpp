@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <glm/glm.hpp>
+#include <limits>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "directionalLight.hpp"
 #include "pointLight.hpp"
@@ -11,33 +16,91 @@
 namespace JaroViewer {
 	class LightSet {
 	public:
-		static const unsigned int mMAXNUMDIRLIGHTS   = 2;
-		static const unsigned int mMAXNUMPOINTLIGHTS = 20;
-		static const unsigned int mMAXNUMSPOTLIGHTS  = 10;
+		static const unsigned int mMAXNUMDIRLIGHTS = 2;
 
+		// A light is cut off where it adds less than this fraction of its color
+		static constexpr float mLIGHTCUTOFF = 5.0f / 256.0f;
+
+		// Uniform block with the directional lights and the light counts, std140
 		struct LightSetStruct {
 			DirectionalLight::DirectionalLightStruct directionalLights[mMAXNUMDIRLIGHTS];
-			PointLight::PointLightStruct pointLights[mMAXNUMPOINTLIGHTS];
-			Spotlight::SpotlightStruct spotlights[mMAXNUMSPOTLIGHTS];
 			int numDirLights;
 			int numPointLights;
 			int numSpotlights;
 		};
 
+		/**
+		 * Everything the gpu needs of the lights, the point lights and spotlights are
+		 * uploaded to storage buffers and have no limit. The arrays are shared with the
+		 * previous image until their lights change
+		 */
+		struct Image {
+			unsigned int version;
+			unsigned int headerVersion;
+			LightSetStruct header;
+
+			// If any light casts shadows
+			bool castShadows;
+			std::shared_ptr<const std::vector<PointLight::PointLightStruct>> pointLights;
+			std::shared_ptr<const std::vector<Spotlight::SpotlightStruct>> spotlights;
+
+			// The version in which every light last changed
+			std::shared_ptr<const std::vector<unsigned int>> pointLightVersions;
+			std::shared_ptr<const std::vector<unsigned int>> spotlightVersions;
+		};
+
 		LightSet();
 		void addDirLight(std::shared_ptr<DirectionalLight> dirLight);
 		void addPointLight(std::shared_ptr<PointLight> pointLight);
 		void addSpotlight(std::shared_ptr<Spotlight> spotlight);
 
-		LightSetStruct getStruct() const;
+		void update();
+		std::shared_ptr<const Image> getImage() const;
+
+		/**
+		 * The distance at which a point light or spotlight adds less than the cut off,
+		 * the same range the light culling uses
+		 * @return The range, 0 if the light never reaches the cut off
+		 */
+		template <typename Light>
+		static float getLightRange(const Light& light) {
+			glm::vec3 color = light.ambient + light.diffuse + light.specular;
+			float peak      = std::max(std::max(color.x, color.y), color.z);
+			float c         = light.constant - peak / mLIGHTCUTOFF;
+			if (c >= 0.0f) return 0.0f;
+			if (light.quadratic <= 0.0f)
+				return (light.linear > 0.0f) ? -c / light.linear : std::numeric_limits<float>::max();
+			return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) /
+			       (2.0f * light.quadratic);
+		}
+
+		static void getChangedRanges(
+		  const std::vector<unsigned int>& versions,
+		  size_t stride,
+		  unsigned int since,
+		  std::vector<std::pair<size_t, size_t>>* ranges
+		);
 
 	private:
+		// The indices of the lights that changed since the last update, filled by the lights
+		struct ChangedLights {
+			std::vector<size_t> pointLights;
+			std::vector<size_t> spotlights;
+		};
+
 		std::array<std::shared_ptr<DirectionalLight>, mMAXNUMDIRLIGHTS> mDirectionalLights;
-		std::array<std::shared_ptr<PointLight>, mMAXNUMPOINTLIGHTS> mPointLights;
-		std::array<std::shared_ptr<Spotlight>, mMAXNUMSPOTLIGHTS> mSpotlights;
+		std::vector<std::shared_ptr<PointLight>> mPointLights;
+		std::vector<std::shared_ptr<Spotlight>> mSpotlights;
 
 		int mNumDirLights;
-		int mNumPointLights;
-		int mNumSpotlights;
+
+		// Shared with the lights, so it stays valid when the set is moved
+		std::shared_ptr<ChangedLights> mChanged;
+		unsigned int mPointShadowCasters;
+		unsigned int mSpotShadowCasters;
+
+		// Shared with the snapshots, every update makes a new image
+		std::shared_ptr<const Image> mImage;
+		bool mCountsChanged;
 	};
 } // namespace JaroViewer
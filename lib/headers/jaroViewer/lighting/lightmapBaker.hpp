@@ -0,0 +1,108 @@
+#pragma once
+
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/geometry/triangleBvh.hpp"
+#include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/scene/objectManager.hpp"
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <random>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	struct LightmapSettings {
+		// Width and height of the lightmap in texels
+		uint atlasSize = 1024;
+
+		// Texels per world unit, lowered when the static instances do not fit the lightmap
+		float texelsPerUnit = 16.0f;
+
+		// Paths traced per texel for the indirect light and the bounces of every path
+		uint indirectSamples = 64;
+		uint bounces         = 1;
+
+		// Fraction of the light the surfaces reflect, the textures are not read while baking
+		float bounceAlbedo = 0.5f;
+	};
+
+	/**
+	 * Bakes the diffuse light of the static models into a lightmap on the cpu. Every static
+	 * model gets a second uv set of flat charts, every instance a square of the lightmap,
+	 * and every texel traces its direct light, shadows and bounced light on all threads.
+	 * Bake on the render thread before the engine starts, the lights are baked as they are
+	 */
+	class LightmapBaker {
+	public:
+		struct Stats {
+			uint instances;
+			size_t texels;
+			float seconds;
+		};
+
+		LightmapBaker(JobSystem* jobs, const LightmapSettings& settings = {});
+		LightmapBaker(const LightmapBaker&)            = delete;
+		LightmapBaker& operator=(const LightmapBaker&) = delete;
+
+		Stats bake(
+		  ObjectManager& objects,
+		  LightSet& lights,
+		  const std::function<void(float progress)>& progress = {}
+		);
+		uint getTexture() const;
+
+	private:
+		// The charts of a model packed into the unit square, extent is its size in model units
+		struct Unwrap {
+			float extent;
+			std::vector<MeshGeometry> geometry;
+			std::vector<std::vector<glm::vec2>> uvs;
+		};
+
+		struct Placement {
+			uint x;
+			uint y;
+			uint size;
+		};
+
+		struct Texel {
+			glm::vec3 position;
+			glm::vec3 normal;
+			size_t index;
+		};
+
+		Unwrap unwrap(const std::vector<std::shared_ptr<const MeshGeometry>>& meshes) const;
+		std::vector<Placement>
+		  placeInstances(const std::vector<StaticInstance>& instances, const std::vector<Unwrap>& unwraps) const;
+		void rasterize(
+		  const StaticInstance& instance,
+		  const Unwrap& unwrap,
+		  const Placement& placement,
+		  std::vector<char>* covered,
+		  std::vector<Texel>* texels
+		) const;
+
+		glm::vec3 getDirectLight(
+		  const TriangleBvh& bvh,
+		  const LightSet::Image& lights,
+		  const glm::vec3& position,
+		  const glm::vec3& normal,
+		  bool ambient
+		) const;
+		glm::vec3 getIndirectLight(
+		  const TriangleBvh& bvh,
+		  const LightSet::Image& lights,
+		  const glm::vec3& position,
+		  const glm::vec3& normal,
+		  std::minstd_rand& random
+		) const;
+		void dilate(std::vector<glm::vec3>* light, std::vector<char>* covered) const;
+		void upload(const std::vector<glm::vec3>& light);
+
+		JobSystem* mJobs;
+		LightmapSettings mSettings;
+		uint mTexture;
+	};
+} // namespace JaroViewer
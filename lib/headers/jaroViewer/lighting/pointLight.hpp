@@ -3,6 +3,7 @@
 #include "jaroViewer/core/tools.hpp"
 #include "jaroViewer/scene/object.hpp"
 
+#include <functional>
 #include <glm/glm.hpp>
 
 namespace JaroViewer {
@@ -17,18 +18,36 @@ namespace JaroViewer {
 			float linear;
 			glm::vec3 specular;
 			float quadratic;
+			int castShadows;
+			float pad0;
+			float pad1;
+			float pad2;
 		};
 
 		PointLight(Object obj, Tools::LightColor lightColor, Tools::AttenuationParams params);
+		PointLight(const PointLight&)            = delete;
+		PointLight& operator=(const PointLight&) = delete;
+		~PointLight();
 
 		void enable(bool enable);
+		void setCastShadows(bool castShadows);
 		PointLightStruct getStruct() const;
 		Object getObject();
 
+		bool isDirty() const;
+		void setClean();
+		void setChangeListener(std::function<void()> listener);
+
 	private:
+		void markDirty();
+
 		Object mObject;
+		size_t mListener;
+		bool mDirty;
+		std::function<void()> mChangeListener;
 		Tools::LightColor mLightColor;
 		bool mEnable;
+		bool mCastShadows;
 
 		float mConstant;
 		float mLinear;
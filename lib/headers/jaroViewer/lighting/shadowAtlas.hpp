@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Hands out square power of two tiles of one large depth texture. Tiles are split
+	 * from larger ones and merged again when all four parts are free
+	 */
+	class ShadowAtlas {
+	public:
+		struct Tile {
+			uint x;
+			uint y;
+			uint size;
+		};
+
+		ShadowAtlas(uint size, uint minTileSize);
+		ShadowAtlas(const ShadowAtlas&)            = delete;
+		ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+		~ShadowAtlas();
+
+		std::optional<Tile> allocate(uint size);
+		void free(const Tile& tile);
+
+		glm::vec4 getRect(const Tile& tile) const;
+		uint getTexture() const;
+		uint getSize() const;
+		size_t getMemory() const;
+		size_t getUsedMemory() const;
+
+	private:
+		uint getLevel(uint size) const;
+		std::optional<glm::uvec2> allocateLevel(uint level);
+		void freeLevel(glm::uvec2 position, uint level);
+
+		uint mSize;
+		uint mLevels;
+		uint mTexture;
+		size_t mUsed;
+
+		// Free tile positions per level, level 0 is the whole atlas
+		std::vector<std::vector<glm::uvec2>> mFree;
+	};
+} // namespace JaroViewer
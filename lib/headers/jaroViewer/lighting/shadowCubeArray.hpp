@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Cube map array of depth cubes for the point light shadows. The array doubles when
+	 * it is full, which loses the depth of all cubes
+	 */
+	class ShadowCubeArray {
+	public:
+		ShadowCubeArray(uint size, uint capacity);
+		ShadowCubeArray(const ShadowCubeArray&)            = delete;
+		ShadowCubeArray& operator=(const ShadowCubeArray&) = delete;
+		~ShadowCubeArray();
+
+		std::optional<uint> allocate();
+		void free(uint cube);
+
+		uint getTexture() const;
+		uint getSize() const;
+		uint getVersion() const;
+		size_t getMemory() const;
+		size_t getUsedMemory() const;
+
+	private:
+		void createTexture(uint capacity);
+
+		uint mSize;
+		uint mCapacity;
+		uint mTexture;
+		uint mVersion;
+		std::vector<uint> mFree;
+	};
+} // namespace JaroViewer
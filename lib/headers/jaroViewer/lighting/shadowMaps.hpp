@@ -0,0 +1,137 @@
+#pragma once
+
+#include "jaroViewer/core/window.hpp"
+#include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/lighting/shadowAtlas.hpp"
+#include "jaroViewer/lighting/shadowCubeArray.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
+#include "jaroViewer/scene/objectManager.hpp"
+#include "jaroViewer/scene/sceneSnapshot.hpp"
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Shadow maps of the directional lights and spotlights, all rendered into tiles of one
+	 * atlas. Directional lights get cascades fit to the camera frustum, point lights get a
+	 * cube of a cube map array. A tile or cube keeps its depth until the light moves or a
+	 * caster inside its volume changes
+	 */
+	class ShadowMaps {
+	public:
+		static const uint cNUMCASCADES = 4;
+
+		struct Stats {
+			uint tilesRendered;
+			uint tilesCached;
+			size_t atlasBytes;
+			size_t atlasUsedBytes;
+		};
+
+		ShadowMaps(uint atlasSize, float shadowDistance);
+		ShadowMaps(const ShadowMaps&)            = delete;
+		ShadowMaps& operator=(const ShadowMaps&) = delete;
+		~ShadowMaps();
+
+		void update(
+		  const SceneSnapshot& previous,
+		  const SceneSnapshot& current,
+		  float alpha,
+		  const glm::mat4& view,
+		  const glm::mat4& projection,
+		  float nearPlane,
+		  float farPlane,
+		  Size viewport,
+		  ObjectManager& objects,
+		  FrameRingBuffer& ring
+		);
+		Stats getStats() const;
+
+	private:
+		struct Tile {
+			std::optional<ShadowAtlas::Tile> tile;
+			glm::mat4 viewProjection;
+			uint64_t casterHash;
+			bool valid;
+		};
+
+		struct Cube {
+			std::optional<uint> cube;
+			glm::vec4 light;
+			uint64_t casterHash;
+			bool valid;
+		};
+
+		// Uniform block of one point light pass, std140
+		struct PointPassStruct {
+			glm::mat4 faceMatrices[6];
+			glm::vec4 light;
+			int layer;
+			int pad0;
+			int pad1;
+			int pad2;
+		};
+
+		// Uniform block of the directional shadows, std140
+		struct ShadowStruct {
+			glm::mat4 dirMatrices[LightSet::mMAXNUMDIRLIGHTS * cNUMCASCADES];
+			glm::vec4 dirRects[LightSet::mMAXNUMDIRLIGHTS * cNUMCASCADES];
+			glm::vec4 cascadeSplits;
+		};
+
+		// Element of the spotlight shadow storage block, std430
+		struct SpotShadowStruct {
+			glm::mat4 matrix;
+			glm::vec4 rect;
+		};
+
+		bool prepareTile(Tile& tile, uint size, bool enabled);
+		void updatePointShadows(
+		  const SceneSnapshot& previous,
+		  const SceneSnapshot& current,
+		  float alpha,
+		  float farPlane,
+		  ObjectManager& objects,
+		  FrameRingBuffer& ring
+		);
+		void renderTile(
+		  Tile& tile,
+		  const glm::mat4& projection,
+		  const glm::mat4& view,
+		  const SceneSnapshot& previous,
+		  const SceneSnapshot& current,
+		  float alpha,
+		  ObjectManager& objects,
+		  FrameRingBuffer& ring
+		);
+		void fitCascade(
+		  const glm::vec3& direction,
+		  const std::array<glm::vec3, 8>& corners,
+		  float nearPlane,
+		  float farPlane,
+		  float begin,
+		  float end,
+		  glm::mat4* projection,
+		  glm::mat4* view
+		) const;
+
+		ShadowAtlas mAtlas;
+		uint mFrameBuffer;
+		float mDistance;
+
+		std::array<Tile, LightSet::mMAXNUMDIRLIGHTS * cNUMCASCADES> mCascades;
+		std::vector<Tile> mSpotTiles;
+
+		ShadowCubeArray mCubes;
+		uint mCubeFrameBuffer;
+		uint mCubeVersion;
+		std::vector<Cube> mPointCubes;
+		bool mWarnedFull;
+		Stats mStats;
+	};
+} // namespace JaroViewer
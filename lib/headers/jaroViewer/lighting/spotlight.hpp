@@ -3,6 +3,8 @@
 #include "jaroViewer/core/tools.hpp"
 #include "jaroViewer/scene/object.hpp"
 
+#include <functional>
+
 namespace JaroViewer {
 	class Spotlight {
 	public:
@@ -18,7 +20,7 @@ namespace JaroViewer {
 			glm::vec3 specular;
 			float quadratic;
 			int enable;
-			float pad0;
+			int castShadows;
 			float pad1;
 			float pad2;
 		};
@@ -31,19 +33,33 @@ namespace JaroViewer {
 		  float innerAngle,
 		  float outerAngle
 		);
+		Spotlight(const Spotlight&)            = delete;
+		Spotlight& operator=(const Spotlight&) = delete;
+		~Spotlight();
 
 		void enable(bool enable);
 		bool getState() const;
+		void setCastShadows(bool castShadows);
 		SpotlightStruct getStruct() const;
 		Object getObject();
 
 		void setDirection(const glm::vec3& direction);
 		glm::vec3 getDirection() const;
 
+		bool isDirty() const;
+		void setClean();
+		void setChangeListener(std::function<void()> listener);
+
 	private:
+		void markDirty();
+
 		Object mObject;
+		size_t mListener;
+		bool mDirty;
+		std::function<void()> mChangeListener;
 		Tools::LightColor mLightColor;
 		bool mEnable;
+		bool mCastShadows;
 
 		glm::vec3 mDirection;
 		float mCutOff;
@@ -2,6 +2,7 @@
 
 #include "jaroViewer/core/eventSender.hpp"
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <map>
 #include <optional>
@@ -20,7 +21,8 @@ namespace JaroViewer {
 
 	class Modifier : public EventSender<Modifier, ModifierEvent> {
 	public:
-		static std::string getVertexLibrary();
+		static std::string getVertexLibrary(uint64_t modifiers = ~0ull);
+		static std::string getModifierLibrary(uint64_t modifiers = ~0ull);
 		static std::optional<uint> registerModifier(const std::string& name, const std::string& funcCode);
 
 		virtual ModifierParams getParams() const = 0;
@@ -5,19 +5,109 @@
 namespace JaroViewer {
 	const std::string shaderVersion = "#version 460 core\n";
 
-	const std::string vertexInputs =
+	// Camera of the frame, the shadow passes bind the matrices of their light instead
+	const std::string frameBlock =
 	  "layout(std140, binding = 0) uniform Transformation {\n"
 	  "mat4 projection;\n"
 	  "mat4 view;\n"
+	  "vec3 viewPos;\n"
+	  "};\n";
+
+	// One entry per draw of a pass, the draw passes its index as base instance
+	const std::string drawLibrary =
+	  "struct DrawParams {\n"
+	  "uint firstInstance;\n"
+	  "uint material;\n"
+	  "uint numTextures;\n"
+	  "uint pad;\n"
+	  "};\n"
+	  "layout(std430, binding = 9) readonly buffer DrawParamsBuffer {\n"
+	  "DrawParams drawParams[];\n"
+	  "};\n";
+
+	// A material is an index into the material buffer, its textures are layers of the
+	// texture arrays of their size, so a draw binds nothing per material. The vertex
+	// shader picks the material of the instance or else the one of the draw. Flat colors
+	// have no texture and are not sampled
+	const std::string materialLibrary =
+	  "struct Material {\n"
+	  "vec4 diffuseColor;\n"
+	  "vec4 specularColor;\n"
+	  "uint diffuse;\n"   // Texture array in the high 16 bits, the layer in the low bits
+	  "uint specular;\n"
+	  "float shininess;\n"
+	  "uint pad;\n"
+	  "};\n"
+	  "layout(std430, binding = 11) readonly buffer Materials {\n"
+	  "Material materials[];\n"
+	  "};\n"
+	  "layout(binding = 1) uniform sampler2DArray materialTextures[12];\n"
+	  // Instances of one draw can override the material, so the array is not dynamically
+	  // uniform and may not index the samplers. Every array is a constant case instead, the
+	  // gradients are taken before the branch
+	  "vec4 sampleMaterial(uint layer, vec2 uv) {\n"
+	  "vec3 coords = vec3(uv, float(layer & 0xFFFFu));\n"
+	  "vec2 dx     = dFdx(uv);\n"
+	  "vec2 dy     = dFdy(uv);\n"
+	  "switch (layer >> 16u) {\n"
+	  "case 0u: return textureGrad(materialTextures[0], coords, dx, dy);\n"
+	  "case 1u: return textureGrad(materialTextures[1], coords, dx, dy);\n"
+	  "case 2u: return textureGrad(materialTextures[2], coords, dx, dy);\n"
+	  "case 3u: return textureGrad(materialTextures[3], coords, dx, dy);\n"
+	  "case 4u: return textureGrad(materialTextures[4], coords, dx, dy);\n"
+	  "case 5u: return textureGrad(materialTextures[5], coords, dx, dy);\n"
+	  "case 6u: return textureGrad(materialTextures[6], coords, dx, dy);\n"
+	  "case 7u: return textureGrad(materialTextures[7], coords, dx, dy);\n"
+	  "case 8u: return textureGrad(materialTextures[8], coords, dx, dy);\n"
+	  "case 9u: return textureGrad(materialTextures[9], coords, dx, dy);\n"
+	  "case 10u: return textureGrad(materialTextures[10], coords, dx, dy);\n"
+	  "case 11u: return textureGrad(materialTextures[11], coords, dx, dy);\n"
+	  "}\n"
+	  "return vec4(0.0);\n"
+	  "}\n"
+	  "const uint NOTEXTURE = 0xFFFFFFFFu;\n"
+	  "vec3 sampleDiffuse(Material mat, vec2 uv) {\n"
+	  "if (mat.diffuse == NOTEXTURE) return mat.diffuseColor.rgb;\n"
+	  "return sampleMaterial(mat.diffuse, uv).rgb * mat.diffuseColor.rgb;\n"
+	  "}\n"
+	  "vec3 sampleSpecular(Material mat, vec2 uv) {\n"
+	  "if (mat.specular == NOTEXTURE) return mat.specularColor.rgb;\n"
+	  "return sampleMaterial(mat.specular, uv).rgb * mat.specularColor.rgb;\n"
+	  "}\n";
+
+	// The instances of all models of a pass share one buffer, the instance attributes of
+	// older shaders are defined on top of it
+	const std::string instanceInputs =
+	  "struct InstanceData {\n"
+	  "mat4 model;\n"
+	  "mat4 normalModel;\n"
+	  "vec4 lightmapRect;\n"
+	  "uint modifierStart;\n"
+	  "uint modifierCount;\n"
+	  "uint material;\n"   // Index in the material buffer, 0 keeps the material of the draw
+	  "uint pad;\n"
+	  "};\n"
+	  "layout(std430, binding = 10) readonly buffer Instances {\n"
+	  "InstanceData instances[];\n"
 	  "};\n"
-	  "uniform samplerBuffer modifierData;\n"
+	  "layout(binding = 0) uniform samplerBuffer modifierData;\n"
 	  "layout (location = 0) in vec3 aPos;\n"
 	  "layout (location = 1) in vec3 aNormal;\n"
 	  "layout (location = 2) in vec2 aTexCoord;\n"
-	  "layout (location = 3) in mat4 aModel;\n"
-	  "layout (location = 7) in mat3 aNormalModel;\n"
-	  "layout (location = 10) in uint aModifierStart;\n"
-	  "layout (location = 11) in uint aModifierCount;\n";
+	  "layout (location = 12) in vec2 aLightmapUV;\n"
+	  "#define DRAWPARAMS drawParams[gl_BaseInstance]\n"
+	  "#define INSTANCEINDEX (DRAWPARAMS.firstInstance + uint(gl_InstanceID))\n"
+	  "#define aModel instances[INSTANCEINDEX].model\n"
+	  "#define aNormalModel mat3(instances[INSTANCEINDEX].normalModel)\n"
+	  "#define aModifierStart instances[INSTANCEINDEX].modifierStart\n"
+	  "#define aModifierCount instances[INSTANCEINDEX].modifierCount\n"
+	  "#define aLightmapRect instances[INSTANCEINDEX].lightmapRect\n"
+	  "#define aMaterial (instances[INSTANCEINDEX].material != 0u ? instances[INSTANCEINDEX].material : "
+	  "DRAWPARAMS.material)\n"
+	  // The depth pre-pass relies on every pass computing the exact same depth
+	  "invariant gl_Position;\n";
+
+	const std::string vertexInputs = frameBlock + drawLibrary + instanceInputs;
 
 	const std::string basicWhiteVertex = shaderVersion + vertexInputs +
 	  "vec4 transform(vec3 pos) {\n"
@@ -33,7 +123,7 @@ namespace JaroViewer {
 	  "FragColor = vec4(1.0);\n"
 	  "}\n";
 
-	const std::string vertexLibrary = shaderVersion + vertexInputs +
+	const std::string vertexFunctions =
 	  "vec4 transform(vec3 pos) {\n"
 	  "return projection * view * aModel * vec4(pos, 1.0);\n"
 	  "}\n"
@@ -41,24 +131,16 @@ namespace JaroViewer {
 	  "return texelFetch(vec, int(index)).r;\n"
 	  "}\n";
 
-	const std::string fragmentLibrary = shaderVersion +
+	const std::string vertexLibrary = shaderVersion + vertexInputs + vertexFunctions;
+
+	// Light structs and blocks, shared by the lighting and the light culling
+	const std::string lightLibrary =
 	  "#define MAXNUMDIRLIGHTS 2\n"
-	  "#define MAXNUMPOINTLIGHTS 20\n"
-	  "#define MAXNUMSPOTLIGHTS 10\n"
-	  "struct Material {\n"
-	  "sampler2D diffuse;\n"
-	  "sampler2D specular;\n"
-	  "float shininess;\n"
-	  "};\n"
-	  "struct LightPosSet {\n"
-	  "vec3 normal;\n"
-	  "vec3 fragPos;\n"
-	  "vec3 viewPos;\n"
-	  "};\n"
 	  "struct DirectionalLight {\n"
 	  "vec3 direction;\n"
 	  "int enable;\n"
 	  "vec3 ambient;\n"
+	  "int castShadows;\n"
 	  "vec3 diffuse;\n"
 	  "vec3 specular;\n"
 	  "};\n"
@@ -71,6 +153,7 @@ namespace JaroViewer {
 	  "float linear;\n"
 	  "vec3 specular;\n"
 	  "float quadratic;\n"
+	  "int castShadows;\n"
 	  "};\n"
 	  "struct Spotlight {\n"
 	  "vec3 position;\n"
@@ -84,16 +167,49 @@ namespace JaroViewer {
 	  "vec3 specular;\n"
 	  "float quadratic;\n"
 	  "int enable;\n"
+	  "int castShadows;\n"
 	  "};\n"
 	  "layout(std140, binding = 1) uniform LightSet {\n"
 	  "DirectionalLight dirLights[MAXNUMDIRLIGHTS];\n"
-	  "PointLight pointLights[MAXNUMPOINTLIGHTS];\n"
-	  "Spotlight spotlights[MAXNUMSPOTLIGHTS];\n"
 	  "int numDirLights;\n"
 	  "int numPointLights;\n"
 	  "int numSpotlights;\n"
 	  "}\n"
 	  "lightSet;\n"
+	  "layout(std430, binding = 2) readonly buffer PointLights {\n"
+	  "PointLight pointLights[];\n"
+	  "};\n"
+	  "layout(std430, binding = 3) readonly buffer Spotlights {\n"
+	  "Spotlight spotlights[];\n"
+	  "};\n"
+	  "layout(std140, binding = 5) uniform Clusters {\n"
+	  "mat4 clusterInverseProjection;\n"
+	  "mat4 clusterView;\n"
+	  "uvec4 clusterGrid;\n"   // x, y, z and the max lights per cluster
+	  "vec4 clusterScreen;\n"  // width, height, near and far
+	  "};\n";
+
+	// Variants define a fixed amount of directional lights and turn the shadows off
+	const std::string surfaceLibrary =
+	  "#ifndef NUMDIRLIGHTS\n"
+	  "#define NUMDIRLIGHTS lightSet.numDirLights\n"
+	  "#endif\n"
+	  "#ifndef SHADOWS\n"
+	  "#define SHADOWS 1\n"
+	  "#endif\n"
+	  "layout(std430, binding = 4) readonly buffer ClusterLights {\n"
+	  "uint clusterLights[];\n"
+	  "};\n"
+	  "struct LightPosSet {\n"
+	  "vec3 normal;\n"
+	  "vec3 fragPos;\n"
+	  "vec3 viewPos;\n"
+	  "};\n"
+	  "struct Surface {\n"
+	  "vec3 diffuse;\n"
+	  "vec3 specular;\n"
+	  "float shininess;\n"
+	  "};\n"
 	  "vec3 calculateAmbient(vec3 ambLight, vec3 fragColor) {\n"
 	  "return ambLight * fragColor;\n"
 	  "}\n"
@@ -108,123 +224,446 @@ namespace JaroViewer {
 	  "float spec      = pow(max(dot(normal, halfwayDir), 0.0), shininess);\n"
 	  "return specLight * (spec * fragColor);\n"
 	  "}\n"
-	  "vec3 calculateDirectionLight(DirectionalLight light, Material mat, vec2 "
-	  "texCoords, LightPosSet posSet) {\n"
+	  // Shadow tiles of the atlas, the rects hold the offset and scale in the atlas and
+	  // the normal offset of the receivers in w
+	  "#define NUMCASCADES 4\n"
+	  "layout(std140, binding = 6) uniform Shadows {\n"
+	  "mat4 dirShadowMatrices[MAXNUMDIRLIGHTS * NUMCASCADES];\n"
+	  "vec4 dirShadowRects[MAXNUMDIRLIGHTS * NUMCASCADES];\n"
+	  "vec4 cascadeSplits;\n"
+	  "};\n"
+	  "struct SpotShadow {\n"
+	  "mat4 matrix;\n"
+	  "vec4 rect;\n"
+	  "};\n"
+	  "layout(std430, binding = 7) readonly buffer SpotShadows {\n"
+	  "SpotShadow spotShadows[];\n"
+	  "};\n"
+	  "layout(binding = 15) uniform sampler2DShadow shadowAtlas;\n"
+	  "float getShadow(mat4 matrix, vec4 rect, vec3 position) {\n"
+	  "vec4 clip  = matrix * vec4(position, 1.0);\n"
+	  "vec3 coord = clip.xyz / clip.w * 0.5 + 0.5;\n"
+	  "if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) return 1.0;\n"
+	  // Half a texel from the edge, so the filter never reads a neighbouring tile
+	  "vec2 border = 0.5 / vec2(textureSize(shadowAtlas, 0));\n"
+	  "vec2 uv     = clamp(rect.xy + coord.xy * rect.z, rect.xy + border, rect.xy + rect.z - border);\n"
+	  "return texture(shadowAtlas, vec3(uv, coord.z));\n"
+	  "}\n"
+	  // Cube shadow maps of the point lights hold the distance to the light divided by the
+	  // range, per light the cube in the array, the range and the normal offset per distance
+	  "#define POINTSHADOWBIAS 0.002\n"
+	  "layout(std430, binding = 6) readonly buffer PointShadows {\n"
+	  "vec4 pointShadows[];\n"
+	  "};\n"
+	  "layout(binding = 14) uniform samplerCubeArrayShadow pointShadowMaps;\n"
+	  "float getPointShadow(uint light, vec3 lightPos, vec3 fragPos, vec3 normal) {\n"
+	  "if (light >= uint(pointShadows.length())) return 1.0;\n"
+	  "vec4 shadow = pointShadows[light];\n"
+	  "if (shadow.x < 0.0) return 1.0;\n"
+	  "vec3 toFrag = fragPos - lightPos;\n"
+	  "toFrag      = toFrag + normal * shadow.z * length(toFrag);\n"
+	  "return texture(pointShadowMaps, vec4(toFrag, shadow.x), length(toFrag) / shadow.y - "
+	  "POINTSHADOWBIAS);\n"
+	  "}\n"
+	  "float getDirShadow(int light, vec3 fragPos, vec3 normal) {\n"
+	  "float depth = -(clusterView * vec4(fragPos, 1.0)).z;\n"
+	  "int cascade = int(dot(vec4(greaterThan(vec4(depth), cascadeSplits)), vec4(1.0)));\n"
+	  "if (cascade >= NUMCASCADES) return 1.0;\n"
+	  "int index = light * NUMCASCADES + cascade;\n"
+	  "vec4 rect = dirShadowRects[index];\n"
+	  "if (rect.z == 0.0) return 1.0;\n"
+	  "return getShadow(dirShadowMatrices[index], rect, fragPos + normal * rect.w);\n"
+	  "}\n"
+	  "float getSpotShadow(uint light, vec3 fragPos, vec3 normal, float distance) {\n"
+	  "if (light >= uint(spotShadows.length())) return 1.0;\n"
+	  "vec4 rect = spotShadows[light].rect;\n"
+	  "if (rect.z == 0.0) return 1.0;\n"
+	  "return getShadow(spotShadows[light].matrix, rect, fragPos + normal * rect.w * distance);\n"
+	  "}\n"
+	  "vec3 calculateDirectionLight(DirectionalLight light, Surface surface, "
+	  "LightPosSet posSet, float shadow) {\n"
 	  "if (light.enable == 0) return vec3(0.0);\n"
-	  "vec3 norm          = normalize(posSet.normal);\n"
-	  "vec3 lightDir      = normalize(light.direction);\n"
-	  "vec3 viewDir       = normalize(posSet.viewPos - posSet.fragPos);\n"
-	  "vec3 diffuseColor  = vec3(texture(mat.diffuse, texCoords));\n"
-	  "vec3 specularColor = vec3(texture(mat.specular, texCoords));\n"
-	  "vec3 ambient       = calculateAmbient(light.ambient, diffuseColor);\n"
-	  "vec3 diffuse = calculateDiffuse(light.diffuse, diffuseColor, norm, "
+	  "vec3 lightDir = normalize(light.direction);\n"
+	  "vec3 viewDir  = normalize(posSet.viewPos - posSet.fragPos);\n"
+	  "vec3 ambient  = calculateAmbient(light.ambient, surface.diffuse);\n"
+	  "vec3 diffuse = calculateDiffuse(light.diffuse, surface.diffuse, posSet.normal, "
 	  "-lightDir);\n"
 	  "vec3 specular =\n"
-	  "calculateSpecular(light.specular, specularColor, mat.shininess, norm, "
-	  "-lightDir, viewDir);\n"
-	  "return ambient + diffuse + specular;\n"
+	  "calculateSpecular(light.specular, surface.specular, surface.shininess, "
+	  "posSet.normal, -lightDir, viewDir);\n"
+	  "return ambient + shadow * (diffuse + specular);\n"
 	  "}\n"
-	  "vec3 calculatePointLight(PointLight light, Material mat, vec2 texCoords, "
+	  "vec3 calculateDirectionLight(DirectionalLight light, Surface surface, "
 	  "LightPosSet posSet) {\n"
+	  "return calculateDirectionLight(light, surface, posSet, 1.0);\n"
+	  "}\n"
+	  "vec3 calculatePointLight(PointLight light, Surface surface, LightPosSet posSet, "
+	  "float shadow) {\n"
 	  "if (light.enable == 0) return vec3(0.0);\n"
-	  "vec3 norm          = normalize(posSet.normal);\n"
-	  "vec3 lightDir      = normalize(light.position - posSet.fragPos);\n"
-	  "vec3 viewDir       = normalize(posSet.viewPos - posSet.fragPos);\n"
-	  "vec3 diffuseColor  = vec3(texture(mat.diffuse, texCoords));\n"
-	  "vec3 specularColor = vec3(texture(mat.specular, texCoords));\n"
-	  "vec3 ambient       = calculateAmbient(light.ambient, diffuseColor);\n"
-	  "vec3 diffuse = calculateDiffuse(light.diffuse, diffuseColor, norm, "
+	  "vec3 lightDir = normalize(light.position - posSet.fragPos);\n"
+	  "vec3 viewDir  = normalize(posSet.viewPos - posSet.fragPos);\n"
+	  "vec3 ambient  = calculateAmbient(light.ambient, surface.diffuse);\n"
+	  "vec3 diffuse = calculateDiffuse(light.diffuse, surface.diffuse, posSet.normal, "
 	  "lightDir);\n"
 	  "vec3 specular =\n"
-	  "calculateSpecular(light.specular, specularColor, mat.shininess, norm, "
-	  "lightDir, viewDir);\n"
+	  "calculateSpecular(light.specular, surface.specular, surface.shininess, "
+	  "posSet.normal, lightDir, viewDir);\n"
 	  "float distance    = length(light.position - posSet.fragPos);\n"
 	  "float attenuation = 1.0 /\n"
 	  "(light.constant + light.linear * distance + light.quadratic * (distance * "
 	  "distance));\n"
-	  "return attenuation * (ambient + diffuse + specular);\n"
+	  "return attenuation * (ambient + shadow * (diffuse + specular));\n"
 	  "}\n"
-	  "vec3 calculateSpotlight(Spotlight light, Material mat, vec2 texCoords, "
-	  "LightPosSet posSet) {\n"
+	  "vec3 calculatePointLight(PointLight light, Surface surface, LightPosSet posSet) {\n"
+	  "return calculatePointLight(light, surface, posSet, 1.0);\n"
+	  "}\n"
+	  "vec3 calculateSpotlight(Spotlight light, Surface surface, LightPosSet posSet, "
+	  "float shadow) {\n"
 	  "if (light.enable == 0) return vec3(0.0);\n"
-	  "vec3 norm     = normalize(posSet.normal);\n"
 	  "vec3 lightDir = normalize(light.position - posSet.fragPos);\n"
 	  "vec3 viewDir  = normalize(posSet.viewPos - posSet.fragPos);\n"
 	  "float theta   = dot(lightDir, normalize(-light.direction));\n"
 	  "if (theta < light.outerCutOff) return vec3(0.0f);\n"
-	  "float epsilon      = light.cutOff - light.outerCutOff;\n"
-	  "float intensity    = clamp((theta - light.outerCutOff) / epsilon, 0.0, "
+	  "float epsilon   = light.cutOff - light.outerCutOff;\n"
+	  "float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, "
 	  "1.0);\n"
-	  "vec3 diffuseColor  = vec3(texture(mat.diffuse, texCoords));\n"
-	  "vec3 specularColor = vec3(texture(mat.specular, texCoords));\n"
-	  "vec3 ambient       = calculateAmbient(light.ambient, diffuseColor);\n"
-	  "vec3 diffuse = calculateDiffuse(light.diffuse, diffuseColor, norm, "
+	  "vec3 ambient    = calculateAmbient(light.ambient, surface.diffuse);\n"
+	  "vec3 diffuse = calculateDiffuse(light.diffuse, surface.diffuse, posSet.normal, "
 	  "lightDir);\n"
 	  "vec3 specular =\n"
-	  "calculateSpecular(light.specular, specularColor, mat.shininess, norm, "
-	  "lightDir, viewDir);\n"
+	  "calculateSpecular(light.specular, surface.specular, surface.shininess, "
+	  "posSet.normal, lightDir, viewDir);\n"
 	  "float distance    = length(light.position - posSet.fragPos);\n"
 	  "float attenuation = 1.0 /\n"
 	  "(light.constant + light.linear * distance + light.quadratic * (distance * "
 	  "distance));\n"
-	  "return intensity * attenuation * (ambient + diffuse + specular);\n"
-	  "}\n"
-	  "vec4 getLightCorrectedColor(Material mat, vec2 texCoords, LightPosSet "
-	  "posSet) {\n"
-	  "vec3 result = vec3(0.0);\n"
-	  "for (int i = 0; i < lightSet.numDirLights; i++)\n"
-	  "result += calculateDirectionLight(lightSet.dirLights[i], mat, texCoords, "
-	  "posSet);\n"
-	  "for (int i = 0; i < lightSet.numPointLights; i++)\n"
-	  "result += calculatePointLight(lightSet.pointLights[i], mat, texCoords, "
-	  "posSet);\n"
-	  "for (int i = 0; i < lightSet.numSpotlights; i++)\n"
-	  "result += calculateSpotlight(lightSet.spotlights[i], mat, texCoords, "
-	  "posSet);\n"
+	  "return intensity * attenuation * (ambient + shadow * (diffuse + specular));\n"
+	  "}\n"
+	  "vec3 calculateSpotlight(Spotlight light, Surface surface, LightPosSet posSet) {\n"
+	  "return calculateSpotlight(light, surface, posSet, 1.0);\n"
+	  "}\n"
+	  "uint getClusterIndex(vec3 fragPos) {\n"
+	  "float depth = -(clusterView * vec4(fragPos, 1.0)).z;\n"
+	  "float slice = log(depth / clusterScreen.z) / log(clusterScreen.w / clusterScreen.z);\n"
+	  "uint z      = uint(clamp(slice * float(clusterGrid.z), 0.0, float(clusterGrid.z - 1u)));\n"
+	  "uvec2 xy    = uvec2(clamp(gl_FragCoord.xy / clusterScreen.xy, 0.0, 1.0) * "
+	  "vec2(clusterGrid.xy));\n"
+	  "xy          = min(xy, clusterGrid.xy - 1u);\n"
+	  "return xy.x + clusterGrid.x * (xy.y + clusterGrid.y * z);\n"
+	  "}\n"
+	  "vec4 getLitSurfaceColor(Surface surface, LightPosSet posSet) {\n"
+	  "posSet.normal = normalize(posSet.normal);\n"
+	  "vec3 result   = vec3(0.0);\n"
+	  "for (int i = 0; i < NUMDIRLIGHTS; i++) {\n"
+	  "DirectionalLight dirLight = lightSet.dirLights[i];\n"
+	  "float shadow = (SHADOWS != 0 && dirLight.castShadows != 0) ? getDirShadow(i, posSet.fragPos, posSet.normal) : 1.0;\n"
+	  "result += calculateDirectionLight(dirLight, surface, posSet, shadow);\n"
+	  "}\n"
+	  // Only the point lights and spotlights that reach the cluster of the fragment
+	  "uint cluster = getClusterIndex(posSet.fragPos) * (clusterGrid.w + 1u);\n"
+	  "uint count   = clusterLights[cluster];\n"
+	  "for (uint i = 0u; i < count; i++) {\n"
+	  "uint light = clusterLights[cluster + 1u + i];\n"
+	  "if (light < uint(lightSet.numPointLights)) {\n"
+	  "PointLight point = pointLights[light];\n"
+	  "float shadow     = (SHADOWS != 0 && point.castShadows != 0) ? getPointShadow(light, point.position, "
+	  "posSet.fragPos, posSet.normal) : 1.0;\n"
+	  "result += calculatePointLight(point, surface, posSet, shadow);\n"
+	  "} else {\n"
+	  "uint index    = light - uint(lightSet.numPointLights);\n"
+	  "Spotlight spot = spotlights[index];\n"
+	  "float shadow  = (SHADOWS != 0 && spot.castShadows != 0) ? getSpotShadow(index, posSet.fragPos, "
+	  "posSet.normal, length(spot.position - posSet.fragPos)) : 1.0;\n"
+	  "result += calculateSpotlight(spot, surface, posSet, shadow);\n"
+	  "}\n"
+	  "}\n"
 	  "return vec4(result, 1.0);\n"
 	  "}\n"
-	  "uniform Material materials[32];\n"
-	  "uniform int numTextures;\n"
-	  "uniform vec3 viewPos;\n"
+	  "vec4 getLightCorrectedColor(Material mat, vec2 texCoords, LightPosSet posSet) {\n"
+	  "Surface surface = Surface(\n"
+	  "sampleDiffuse(mat, texCoords),\n"
+	  "sampleSpecular(mat, texCoords),\n"
+	  "mat.shininess\n"
+	  ");\n"
+	  "return getLitSurfaceColor(surface, posSet);\n"
+	  "}\n"
 	  "out vec4 FragColor;\n";
 
+	const std::string fragmentLibrary =
+	  shaderVersion + frameBlock + drawLibrary + materialLibrary + lightLibrary + surfaceLibrary;
+
+	// Bins the point lights and spotlights into the clusters, one invocation per cluster
+	const std::string lightCullingCompute = shaderVersion + lightLibrary +
+	  "#define GROUPSIZE 64\n"
+	  // A light is cut off where it adds less than this fraction of its color
+	  "#define LIGHTCUTOFF (5.0 / 256.0)\n"
+	  "layout(local_size_x = GROUPSIZE) in;\n"
+	  "layout(std430, binding = 4) writeonly buffer ClusterLights {\n"
+	  "uint clusterLights[];\n"
+	  "};\n"
+	  // The lights in view, most relevant first, so a full cluster drops the least relevant
+	  "layout(std430, binding = 8) readonly buffer ActiveLights {\n"
+	  "uint numActiveLights;\n"
+	  "uint activeLights[];\n"
+	  "};\n"
+	  "shared vec4 groupLights[GROUPSIZE];\n"
+	  "shared uint groupIndices[GROUPSIZE];\n"
+	  "vec3 getNearPoint(vec2 ndc) {\n"
+	  "vec4 point = clusterInverseProjection * vec4(ndc, -1.0, 1.0);\n"
+	  "return point.xyz / point.w;\n"
+	  "}\n"
+	  "float getLightRange(vec3 color, float constant, float linear, float quadratic) {\n"
+	  "float peak = max(max(color.r, color.g), color.b);\n"
+	  "float c    = constant - peak / LIGHTCUTOFF;\n"
+	  "if (c >= 0.0) return -1.0;\n"
+	  "if (quadratic <= 0.0) return (linear > 0.0) ? -c / linear : 1e30;\n"
+	  "return (-linear + sqrt(linear * linear - 4.0 * quadratic * c)) / (2.0 * quadratic);\n"
+	  "}\n"
+	  // View space position and range of a light, a negative range never reaches anything
+	  "vec4 getLightSphere(uint light) {\n"
+	  "uint numPoint = uint(lightSet.numPointLights);\n"
+	  "if (light < numPoint) {\n"
+	  "PointLight point = pointLights[light];\n"
+	  "if (point.enable == 0) return vec4(0.0, 0.0, 0.0, -1.0);\n"
+	  "float range = getLightRange(point.ambient + point.diffuse + point.specular, "
+	  "point.constant, point.linear, point.quadratic);\n"
+	  "return vec4((clusterView * vec4(point.position, 1.0)).xyz, range);\n"
+	  "}\n"
+	  "Spotlight spot = spotlights[light - numPoint];\n"
+	  "if (spot.enable == 0) return vec4(0.0, 0.0, 0.0, -1.0);\n"
+	  "float range = getLightRange(spot.ambient + spot.diffuse + spot.specular, "
+	  "spot.constant, spot.linear, spot.quadratic);\n"
+	  "return vec4((clusterView * vec4(spot.position, 1.0)).xyz, range);\n"
+	  "}\n"
+	  "void main() {\n"
+	  "uint numClusters = clusterGrid.x * clusterGrid.y * clusterGrid.z;\n"
+	  "uint numLights   = numActiveLights;\n"
+	  "uint index       = gl_GlobalInvocationID.x;\n"
+	  "uint clamped     = min(index, numClusters - 1u);\n"
+	  // The view space bounds of the cluster, the depth slices grow exponentially
+	  "uvec3 cell    = uvec3(clamped % clusterGrid.x, (clamped / clusterGrid.x) % clusterGrid.y, "
+	  "clamped / (clusterGrid.x * clusterGrid.y));\n"
+	  "vec2 tileMin  = vec2(cell.xy) / vec2(clusterGrid.xy) * 2.0 - 1.0;\n"
+	  "vec2 tileMax  = vec2(cell.xy + 1u) / vec2(clusterGrid.xy) * 2.0 - 1.0;\n"
+	  "float ratio   = clusterScreen.w / clusterScreen.z;\n"
+	  "float nearZ   = clusterScreen.z * pow(ratio, float(cell.z) / float(clusterGrid.z));\n"
+	  "float farZ    = clusterScreen.z * pow(ratio, float(cell.z + 1u) / float(clusterGrid.z));\n"
+	  "vec3 pointMin = getNearPoint(tileMin);\n"
+	  "vec3 pointMax = getNearPoint(tileMax);\n"
+	  "vec3 boxMin   = min(min(pointMin * (nearZ / -pointMin.z), pointMin * (farZ / -pointMin.z)),\n"
+	  "min(pointMax * (nearZ / -pointMax.z), pointMax * (farZ / -pointMax.z)));\n"
+	  "vec3 boxMax   = max(max(pointMin * (nearZ / -pointMin.z), pointMin * (farZ / -pointMin.z)),\n"
+	  "max(pointMax * (nearZ / -pointMax.z), pointMax * (farZ / -pointMax.z)));\n"
+	  // Every group loads a batch of lights once and tests all its clusters against it
+	  "uint base  = clamped * (clusterGrid.w + 1u);\n"
+	  "uint count = 0u;\n"
+	  "for (uint batch = 0u; batch < numLights; batch += GROUPSIZE) {\n"
+	  "uint active = batch + gl_LocalInvocationID.x;\n"
+	  "uint light  = (active < numLights) ? activeLights[active] : 0u;\n"
+	  "groupIndices[gl_LocalInvocationID.x] = light;\n"
+	  "groupLights[gl_LocalInvocationID.x]  = (active < numLights) ? getLightSphere(light) : "
+	  "vec4(0.0, 0.0, 0.0, -1.0);\n"
+	  "barrier();\n"
+	  "uint batchSize = min(uint(GROUPSIZE), numLights - batch);\n"
+	  "for (uint i = 0u; i < batchSize && index < numClusters; i++) {\n"
+	  "vec4 sphere = groupLights[i];\n"
+	  "if (sphere.w < 0.0 || count >= clusterGrid.w) continue;\n"
+	  "vec3 offset = clamp(sphere.xyz, boxMin, boxMax) - sphere.xyz;\n"
+	  "if (dot(offset, offset) > sphere.w * sphere.w) continue;\n"
+	  "clusterLights[base + 1u + count] = groupIndices[i];\n"
+	  "count++;\n"
+	  "}\n"
+	  "barrier();\n"
+	  "}\n"
+	  "if (index < numClusters) clusterLights[base] = count;\n"
+	  "}\n";
+
 	const std::string basicVertex =
 	  "out vec2 TexCoord;\n"
 	  "out vec3 FragPos;\n"
 	  "out vec3 Normal;\n"
+	  "flat out uint MaterialID;\n"
 	  "void main() {\n"
 	  "vec3 modified = processModifiers(aPos);\n"
 	  "gl_Position   = transform(modified);\n"
 	  "TexCoord      = aTexCoord;\n"
 	  "FragPos       = vec3(aModel * vec4(modified, 1.0));\n"
 	  "Normal        = aNormalModel * aNormal;\n"
+	  "MaterialID    = aMaterial;\n"
 	  "}\n";
 
 	const std::string basicFragment =
 	  "in vec2 TexCoord;\n"
 	  "in vec3 FragPos;\n"
 	  "in vec3 Normal;\n"
+	  "flat in uint MaterialID;\n"
 	  "void main() {\n"
 	  "LightPosSet posSet = LightPosSet(\n"
 	  "Normal,\n"
 	  "FragPos,\n"
 	  "viewPos\n"
 	  ");\n"
-	  "FragColor = getLightCorrectedColor(materials[0], TexCoord, posSet);\n"
+	  "FragColor = getLightCorrectedColor(materials[MaterialID], TexCoord, posSet);\n"
+	  "}\n";
+
+	// The basic shader with the diffuse lighting of static models read from the lightmap,
+	// instances that were not baked are lit like the basic shader
+	const std::string bakedVertex =
+	  "out vec2 TexCoord;\n"
+	  "out vec2 LightmapCoord;\n"
+	  "out vec3 FragPos;\n"
+	  "out vec3 Normal;\n"
+	  "flat out int Baked;\n"
+	  "flat out uint MaterialID;\n"
+	  "void main() {\n"
+	  "vec3 modified = processModifiers(aPos);\n"
+	  "gl_Position   = transform(modified);\n"
+	  "TexCoord      = aTexCoord;\n"
+	  "LightmapCoord = aLightmapRect.xy + aLightmapUV * aLightmapRect.zw;\n"
+	  "FragPos       = vec3(aModel * vec4(modified, 1.0));\n"
+	  "Normal        = aNormalModel * aNormal;\n"
+	  "Baked         = (aLightmapRect.z > 0.0) ? 1 : 0;\n"
+	  "MaterialID    = aMaterial;\n"
+	  "}\n";
+
+	const std::string bakedFragment =
+	  "in vec2 TexCoord;\n"
+	  "in vec2 LightmapCoord;\n"
+	  "in vec3 FragPos;\n"
+	  "in vec3 Normal;\n"
+	  "flat in int Baked;\n"
+	  "flat in uint MaterialID;\n"
+	  "layout(binding = 13) uniform sampler2D lightmap;\n"
+	  "void main() {\n"
+	  "if (Baked == 0) {\n"
+	  "FragColor = getLightCorrectedColor(materials[MaterialID], TexCoord, LightPosSet(Normal, FragPos, viewPos));\n"
+	  "return;\n"
+	  "}\n"
+	  "vec3 albedo = sampleDiffuse(materials[MaterialID], TexCoord);\n"
+	  "FragColor   = vec4(albedo * texture(lightmap, LightmapCoord).rgb, 1.0);\n"
+	  "}\n";
+
+	// Depth only, positions the vertices exactly like basicVertex
+	const std::string depthVertex =
+	  "void main() {\n"
+	  "vec3 modified = processModifiers(aPos);\n"
+	  "gl_Position   = transform(modified);\n"
+	  "}\n";
+
+	const std::string depthFragment = shaderVersion +
+	  "void main() {}\n";
+
+	// Pass data of one point light cube, the range of the light is in the w of the position
+	const std::string pointShadowPass =
+	  "layout(std140, binding = 2) uniform PointShadowPass {\n"
+	  "mat4 faceMatrices[6];\n"
+	  "vec4 shadowLight;\n"
+	  "int shadowLayer;\n"
+	  "};\n";
+
+	// Renders all six faces of a point light cube in one pass, the geometry shader copies
+	// every triangle to the faces its instance was not culled from
+	const std::string pointShadowVertex =
+	  "layout(std430, binding = 5) readonly buffer ShadowFaces {\n"
+	  "uint shadowFaces[];\n"
+	  "};\n"
+	  "out vec4 vWorldPos;\n"
+	  "flat out uint vFaces;\n"
+	  "void main() {\n"
+	  "vWorldPos   = aModel * vec4(processModifiers(aPos), 1.0);\n"
+	  "vFaces      = shadowFaces[INSTANCEINDEX];\n"
+	  "gl_Position = vWorldPos;\n"
+	  "}\n";
+
+	const std::string pointShadowGeometry = shaderVersion + pointShadowPass +
+	  "layout(triangles, invocations = 6) in;\n"
+	  "layout(triangle_strip, max_vertices = 3) out;\n"
+	  "in vec4 vWorldPos[];\n"
+	  "flat in uint vFaces[];\n"
+	  "out vec3 FragPos;\n"
+	  "void main() {\n"
+	  "if ((vFaces[0] & (1u << uint(gl_InvocationID))) == 0u) return;\n"
+	  "for (int i = 0; i < 3; i++) {\n"
+	  "gl_Layer    = shadowLayer + gl_InvocationID;\n"
+	  "gl_Position = faceMatrices[gl_InvocationID] * vWorldPos[i];\n"
+	  "FragPos     = vWorldPos[i].xyz;\n"
+	  "EmitVertex();\n"
+	  "}\n"
+	  "EndPrimitive();\n"
+	  "}\n";
+
+	const std::string pointShadowFragment = shaderVersion + pointShadowPass +
+	  "in vec3 FragPos;\n"
+	  "void main() {\n"
+	  "gl_FragDepth = length(FragPos - shadowLight.xyz) / shadowLight.w;\n"
+	  "}\n";
+
+	// Writes the surface of the basic shader into the G-buffer of the deferred path
+	const std::string geometryFragment = shaderVersion + materialLibrary +
+	  "in vec2 TexCoord;\n"
+	  "in vec3 FragPos;\n"
+	  "in vec3 Normal;\n"
+	  "flat in uint MaterialID;\n"
+	  "layout (location = 0) out vec4 gAlbedo;\n"
+	  "layout (location = 1) out vec4 gSpecular;\n"
+	  "layout (location = 2) out vec4 gNormal;\n"
+	  "void main() {\n"
+	  "Material material = materials[MaterialID];\n"
+	  "gAlbedo   = vec4(sampleDiffuse(material, TexCoord), 1.0);\n"
+	  "gSpecular = vec4(sampleSpecular(material, TexCoord), 1.0);\n"
+	  "gNormal   = vec4(normalize(Normal), material.shininess);\n"
+	  "}\n";
+
+	// Full screen triangle, drawn with an empty vao
+	const std::string screenVertex = shaderVersion +
+	  "out vec2 TexCoords;\n"
+	  "void main() {\n"
+	  "TexCoords   = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+	  "gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);\n"
+	  "}\n";
+
+	// Shades every pixel of the G-buffer once, the position is rebuilt from the depth
+	const std::string deferredLightingFragment =
+	  "in vec2 TexCoords;\n"
+	  "uniform sampler2D gAlbedo;\n"
+	  "uniform sampler2D gSpecular;\n"
+	  "uniform sampler2D gNormal;\n"
+	  "uniform sampler2D gDepth;\n"
+	  "uniform mat4 inverseViewProjection;\n"
+	  "void main() {\n"
+	  "float depth = texture(gDepth, TexCoords).r;\n"
+	  "if (depth == 1.0) discard;\n"
+	  "vec4 position = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);\n"
+	  "vec4 normal   = texture(gNormal, TexCoords);\n"
+	  "Surface surface = Surface(\n"
+	  "texture(gAlbedo, TexCoords).rgb,\n"
+	  "texture(gSpecular, TexCoords).rgb,\n"
+	  "normal.a\n"
+	  ");\n"
+	  "LightPosSet posSet = LightPosSet(normal.xyz, position.xyz / position.w, viewPos);\n"
+	  "FragColor = getLitSurfaceColor(surface, posSet);\n"
+	  "}\n";
+
+	const std::string presentFragment = shaderVersion +
+	  "in vec2 TexCoords;\n"
+	  "out vec4 FragColor;\n"
+	  "uniform sampler2D screenTexture;\n"
+	  "void main() {\n"
+	  "FragColor = texture(screenTexture, TexCoords);\n"
 	  "}\n";
 
+	// The ids continue over the models, so the instance index in the frame is the id
 	const std::string regionVertex = "flat out uint vInstanceID;\n"
 	                                 "void main() {\n"
 	                                 "vec3 modified = processModifiers(aPos);\n"
 	                                 "gl_Position   = transform(modified);\n"
-	                                 "vInstanceID = uint(gl_InstanceID);\n"
+	                                 "vInstanceID = INSTANCEINDEX;\n"
 	                                 "}\n";
 
 	const std::string regionFragment = shaderVersion +
 	  "flat in uint vInstanceID;\n"
 	  "out uint outID;\n"
-	  "uniform int baseID;\n"
 	  "void main() {\n"
-	  "outID = uint(baseID) + vInstanceID;\n"
+	  "outID = vInstanceID + 1u;\n"
 	  "}\n";
 } // namespace JaroViewer
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "jaroViewer/graphics/frameBuffer.hpp"
+#include "jaroViewer/rendering/shader.hpp"
+
+#include <glm/glm.hpp>
+#include <sys/types.h>
+
+namespace JaroViewer {
+	/**
+	 * Deferred shading, the lit models are first drawn into a G-buffer and the lighting
+	 * is then done once per pixel. The result ends up in a separate lit framebuffer
+	 * that the unlit models, the cubemap and the post processor use
+	 */
+	class DeferredRenderer {
+	public:
+		DeferredRenderer(int width, int height);
+		DeferredRenderer(const DeferredRenderer&)            = delete;
+		DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+		~DeferredRenderer();
+
+		void resize(uint width, uint height);
+
+		void bindGeometry();
+		void renderLighting(const glm::mat4& viewProjection);
+		void present() const;
+
+		uint getLitColor() const;
+
+	private:
+		// Albedo, specular with the normal and shininess, depth
+		FrameBuffer mGBuffer;
+		FrameBuffer mLit;
+
+		Shader mLighting;
+		Shader mPresent;
+		Uniform<glm::mat4> mInverseViewProjection;
+		uint mVao;
+		bool mBlend;
+	};
+} // namespace JaroViewer
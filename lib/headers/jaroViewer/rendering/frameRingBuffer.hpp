@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <sys/types.h>
+#include <vector>
+
+typedef struct __GLsync* GLsync;
+
+namespace JaroViewer {
+	/**
+	 * Persistently mapped buffer split into one region per frame in flight. Every frame
+	 * sub-allocates its dynamic data from its own region, a fence makes sure the gpu is
+	 * done with a region before it is written again
+	 */
+	class FrameRingBuffer {
+	public:
+		struct Allocation {
+			uint buffer;
+			size_t offset;
+			void* data;
+		};
+
+		FrameRingBuffer(size_t regionSize, uint framesInFlight);
+		FrameRingBuffer(const FrameRingBuffer&)            = delete;
+		FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+		~FrameRingBuffer();
+
+		void beginFrame();
+		void endFrame();
+
+		Allocation allocate(size_t size, size_t alignment);
+		Allocation upload(const void* data, size_t size, size_t alignment);
+		void bindUniform(uint position, const void* data, size_t size);
+		void bindStorage(uint position, const void* data, size_t size);
+
+		uint getBuffer() const;
+		size_t getUniformAlignment() const;
+		size_t getStorageAlignment() const;
+
+	private:
+		void createBuffer(size_t regionSize);
+
+		uint mBuffer;
+		char* mData;
+		size_t mRegionSize;
+		size_t mUniformAlignment;
+		size_t mStorageAlignment;
+
+		uint mFrame;
+		size_t mHead;
+		std::vector<GLsync> mFences;
+
+		// Buffers replaced by a larger one, deleted when the frame ends
+		std::vector<uint> mRetired;
+	};
+} // namespace JaroViewer
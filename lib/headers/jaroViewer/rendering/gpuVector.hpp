@@ -13,6 +13,8 @@ namespace JaroViewer {
 		void load(uint position) const;
 
 		void copy(const std::vector<float>& data, size_t offset);
+		void copy(const float* data, size_t count, size_t offset);
+		void copyFromBuffer(uint buffer, size_t bufferOffset, size_t count, size_t offset);
 		void move(size_t from, size_t to);
 		void move(size_t from, size_t to, size_t count);
 
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * On-disk cache of linked shader programs. A program is stored as the binary of the
+	 * driver under a hash of its sources and the gl vendor, renderer and version, so a
+	 * driver update or a changed define compiles the program again. Disabled until a
+	 * directory is set
+	 */
+	class ProgramCache {
+	public:
+		struct Stats {
+			uint loaded;
+			uint compiled;
+		};
+
+		static void setDirectory(const std::string& directory);
+		static bool isEnabled();
+
+		static std::optional<uint> load(const std::vector<const std::string*>& sources);
+		static void store(const std::vector<const std::string*>& sources, uint program);
+		static Stats getStats();
+
+	private:
+		struct Header {
+			uint32_t magic;
+			uint32_t format;
+			uint64_t key;
+			uint64_t length;
+		};
+
+		struct State {
+			std::string directory;
+			std::string driver;
+			bool supported;
+			Stats stats;
+		};
+
+		static uint64_t getKey(const std::vector<const std::string*>& sources);
+		static std::string getPath(uint64_t key);
+		static State& getState();
+	};
+} // namespace JaroViewer
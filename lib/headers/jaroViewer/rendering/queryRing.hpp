@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Ring of query sets, one set per frame. The results of older frames are read once
+	 * the gpu has them, so reading never stalls the frame
+	 */
+	class QueryRing {
+	public:
+		QueryRing(uint target, uint queriesPerFrame, uint frames);
+		QueryRing(const QueryRing&)            = delete;
+		QueryRing& operator=(const QueryRing&) = delete;
+		~QueryRing();
+
+		void begin(uint query);
+		void end();
+		void endFrame();
+
+		const std::vector<uint64_t>& getResults() const;
+
+	private:
+		void collect();
+
+		uint mTarget;
+		uint mQueriesPerFrame;
+		uint mFrame;
+		std::vector<uint> mQueries;
+		std::vector<bool> mUsed;
+		std::vector<bool> mPending;
+
+		// The newest complete set, empty until the first one arrives
+		std::vector<uint64_t> mResults;
+	};
+} // namespace JaroViewer
@@ -4,6 +4,8 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace JaroViewer {
@@ -13,19 +15,42 @@ namespace JaroViewer {
 		const std::string& fragmentCode;
 	};
 
+	struct ComputeCode {
+		const std::string& computeCode;
+	};
+
 	struct ShaderPaths {
 		std::vector<std::string>& vertexPaths;
 		std::vector<std::string>& geometryPaths;
 		std::vector<std::string>& fragmentPaths;
 	};
 
+	// Location of a uniform of a known type, -1 when the shader does not use it
+	template<typename T>
+	struct Uniform {
+		int location = -1;
+	};
+
 	class Shader {
 	public:
-		Shader(const ShaderCode& code);
-		Shader(const ShaderPaths& paths);
+		Shader(const ShaderCode& code, bool wait = true);
+		Shader(const ShaderPaths& paths, bool wait = true);
+		Shader(const ComputeCode& code);
+
+		bool isReady();
+		void wait();
+		bool isLinked() const;
 
 		void use() const;
 
+		// Resolve the handles once, setting them does no lookup
+		template<typename T>
+		Uniform<T> getUniform(std::string_view name) const {
+			return {getLocation(name)};
+		}
+		template<typename T>
+		void set(Uniform<T> uniform, const std::type_identity_t<T>& value) const;
+
 		void setBool(const std::string& name, bool value) const;
 		void setInt(const std::string& name, int value) const;
 		void setUniformBuffer(const std::string& name, int position) const;
@@ -40,14 +65,35 @@ namespace JaroViewer {
 		void setMat4(const std::string& name, glm::mat4 mat) const;
 
 	private:
-		unsigned int
-		  createShaderFromFile(uint shaderType, const std::vector<std::string>* sources, const std::string& errorName);
-		unsigned int createShaderFromString(uint shaderType, const char* code, const std::string& errorName);
-		void createProgram(unsigned int vertexID, unsigned int geometryID, unsigned int fragmentID);
+		struct Stage {
+			unsigned int id;
+			const char* name;
+		};
+
+		// A uniform location or a block index by name, sorted on the name
+		struct Resource {
+			std::string name;
+			int index;
+		};
+
+		static bool hasParallelCompile();
+		void compileStage(unsigned int shaderType, const std::string& code, const char* name);
+		void finishLink();
 		void checkCompilingError(unsigned int shaderID, const std::string& shaderName) const;
-		void checkLinkingError(unsigned int programID) const;
-		int getLocation(const std::string& name) const;
+		bool checkLinkingError(unsigned int programID) const;
+		void introspect();
+		static int findResource(const std::vector<Resource>& resources, std::string_view name);
+		int getLocation(std::string_view name) const;
 
 		unsigned int mProgramId;
+		bool mLinked;
+
+		// Submitted stages and their sources until the link is finished
+		std::vector<Stage> mStages;
+		std::vector<std::string> mSources;
+
+		// The active uniforms and uniform blocks, read once the program is linked
+		std::vector<Resource> mUniforms;
+		std::vector<Resource> mBlocks;
 	};
 }; // namespace JaroViewer
@@ -1,10 +1,34 @@
 #pragma once
 
 #include "shader.hpp"
+
+#include <compare>
+#include <cstdint>
+#include <deque>
 #include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace JaroViewer {
-	enum PredefinedShader { WHITE = 0, REGION = 1, BASIC = 2 };
+	enum PredefinedShader { WHITE = 0, REGION = 1, BASIC = 2, GEOMETRY = 3, DEPTH = 4, POINTSHADOW = 5, BAKED = 6 };
+
+	/**
+	 * What a variant of a built-in shader is compiled for, the defaults handle everything
+	 */
+	struct ShaderFeatures {
+		// Bit per modifier ident, the vertex shader only applies these modifiers
+		uint64_t modifiers = ~0ull;
+
+		// The loop over the directional lights has a fixed length, negative reads the light set
+		int numDirLights = -1;
+
+		// Leaves out the shadow lookups when no light casts shadows
+		bool shadows = true;
+
+		auto operator<=>(const ShaderFeatures&) const = default;
+	};
 
 	class ShaderManager {
 	public:
@@ -12,15 +36,39 @@ namespace JaroViewer {
 
 		uint loadShader(const ShaderCode& codes);
 		uint loadShader(const ShaderPaths& paths);
+		uint getVariant(uint ident, const ShaderFeatures& features);
+		bool isReady(uint ident);
 
 		Shader* getShader(uint ident);
 		bool activateShader(uint ident);
+		void resetActiveShader();
 
 	private:
-		std::string pathsToKey(const ShaderPaths& paths) const;
+		// A built-in shader without the modifier library, lit shaders also read the light features.
+		// Without a fallback the pass waits for the shader instead of drawing white
+		struct VariantSource {
+			std::string vertex;
+			std::string geometry;
+			std::string fragment;
+			bool lit;
+			bool fallback;
+		};
 
-		std::map<std::string, uint> mPathToIdent;
-		std::vector<Shader> mShaders;
+		uint loadVariantSource(const VariantSource& source);
+		uint findVariant(uint ident, const ShaderFeatures& features);
+		bool isUsable(uint ident);
+		uint addShader(Shader&& shader);
+		uint
+		  addUniqueShader(const std::string& vertex, const std::string& geometry, const std::string& fragment);
+
+		std::unordered_map<std::string, uint> mSourceToIdent;
+		// A deque, so the shaders stay in place when a variant is added mid frame
+		std::deque<Shader> mShaders;
+		std::vector<bool> mReady;
 		uint mActiveShader;
+
+		// Variants are compiled the first time they are asked for
+		std::map<uint, VariantSource> mVariantSources;
+		std::map<std::pair<uint, ShaderFeatures>, uint> mVariants;
 	};
 } // namespace JaroViewer
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace JaroViewer {
+	/**
+	 * Expands #include directives in glsl sources. Every file is included once per stage,
+	 * so a file needs no guards and includes may form cycles. Includes are looked up next
+	 * to the including file and in a table of virtual files, which holds the built-in
+	 * libraries under jaroViewer/. Files are memory mapped and kept until they change
+	 */
+	class ShaderPreprocessor {
+	public:
+		using Provider = std::function<std::string()>;
+
+		static void setVirtualFile(const std::string& name, const std::string& source);
+		static void setVirtualFile(const std::string& name, Provider provider);
+
+		static std::string process(const std::string& source);
+		static std::string processFiles(const std::vector<std::string>& paths);
+
+	private:
+		struct State;
+
+		static void expand(
+		  std::string_view source,
+		  const std::filesystem::path& directory,
+		  bool root,
+		  std::set<std::string>* included,
+		  std::string* out
+		);
+		static void include(
+		  std::string_view name,
+		  bool angled,
+		  const std::filesystem::path& directory,
+		  std::set<std::string>* included,
+		  std::string* out
+		);
+		static State& getState();
+	};
+} // namespace JaroViewer
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <sys/types.h>
+
+namespace JaroViewer {
+	/**
+	 * Shader storage buffer bound to a fixed binding point, the size can grow at runtime
+	 */
+	class StorageBuffer {
+	public:
+		StorageBuffer(uint position, size_t size);
+		StorageBuffer(const StorageBuffer&)            = delete;
+		StorageBuffer& operator=(const StorageBuffer&) = delete;
+		~StorageBuffer();
+
+		bool reserve(size_t size);
+		void copyFromBuffer(uint buffer, size_t bufferOffset, size_t offset, size_t size);
+
+		size_t getSize() const;
+		uint getID() const;
+
+	private:
+		void create(size_t size);
+
+		uint mPosition;
+		size_t mSize;
+		uint mID;
+	};
+} // namespace JaroViewer
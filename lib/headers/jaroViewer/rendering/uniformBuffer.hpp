@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <sys/types.h>
 
 namespace JaroViewer {
@@ -7,6 +8,7 @@ namespace JaroViewer {
 	public:
 		UniformBuffer(uint position, uint size, uint usage);
 		void updateData(const void* data);
+		void copyFromBuffer(uint buffer, size_t bufferOffset, size_t offset, size_t size);
 
 	private:
 		uint mSize;
@@ -13,9 +13,12 @@ namespace JaroViewer {
 	struct ModifierStack {
 		uint count;
 		std::vector<float> params;
+
+		// Bit per modifier ident in the stack, all bits when an ident does not fit
+		uint64_t types;
 	};
 
-	enum ObjectEvent { MODIFIER, DELETE, TRANSFORM, VISIBILITY };
+	enum ObjectEvent { MODIFIER, DELETE, TRANSFORM, VISIBILITY, MATERIAL };
 
 	using Object    = std::shared_ptr<class RawObject>;
 	using ObjectRef = std::weak_ptr<class RawObject>;
@@ -30,11 +33,14 @@ namespace JaroViewer {
 
 		void setVisibility(bool visibility);
 		bool getVisibility() const;
+		void setMaterial(uint material);
+		uint getMaterial() const;
 		glm::mat4 getModelMatrix() const;
 		glm::vec3 getPosition() const;
 
 		glm::vec3 getEulerAngles() const;
 		glm::quat getQuaternion() const;
+		glm::vec3 getScale() const;
 
 		// Manage child objects
 		void addChild(Object child);
@@ -70,6 +76,7 @@ namespace JaroViewer {
 		glm::quat mRotation;
 		glm::vec3 mScale;
 		bool mVisibility;
+		uint mMaterial;
 
 		// Modifiers
 		std::vector<std::shared_ptr<Modifier>> mModifiers;
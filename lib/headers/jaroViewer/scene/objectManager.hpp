@@ -1,15 +1,24 @@
 #pragma once
 
+#include "jaroViewer/core/jobSystem.hpp"
+#include "jaroViewer/geometry/frustum.hpp"
 #include "jaroViewer/graphics/materialManager.hpp"
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
 #include "jaroViewer/rendering/gpuVector.hpp"
+#include "jaroViewer/rendering/queryRing.hpp"
 #include "jaroViewer/rendering/shader.hpp"
 #include "jaroViewer/rendering/shaderManager.hpp"
 #include "jaroViewer/scene/object.hpp"
+#include "jaroViewer/scene/sceneSnapshot.hpp"
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <sys/types.h>
+#include <thread>
 #include <variant>
 #include <vector>
 
@@ -24,35 +33,136 @@ struct aiMaterial;
 namespace JaroViewer {
 	enum class TextureType { DIFFUSE, SPECULAR, NORMAL, HEIGHT };
 
+	// FORWARD draws every model, the deferred path splits the models over two passes
+	enum class RenderPass { FORWARD, DEFERRED_GEOMETRY, DEFERRED_FORWARD };
+
 	struct Instance {
 		ObjectRef object;
-		glm::mat4 model;
+		uint generation;
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
 		uint modifierStart;
 		uint modifierCount;
+		uint modifierSize;
+		bool visible;
+		uint material;
+
+		// Offset and scale of the instance in the lightmap, zero when it is not baked
+		glm::vec4 lightmapRect;
+
+		// World space bounds, refitted when the transform changes
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+
+		// Pending changes, cleared when the journal is drained
+		bool queued;
+		bool transformChanged;
+		bool modifierChanged;
+		bool visibilityChanged;
+		bool materialChanged;
 	};
 
+	// Element of the instance storage block, std430
 	struct InstanceData {
 		glm::mat4 model;
-		glm::mat3 normalModel;
+		glm::mat4 normalModel;
+		glm::vec4 lightmapRect;
 		uint modifierStart;
 		uint modifierCount;
+		// Index in the material buffer, 0 draws the material of the mesh
+		uint material = 0;
+		uint pad      = 0;
+	};
+
+	// Element of the draw parameter storage block, std430. The draws of a pass pass their
+	// index as base instance, so no uniform is set per draw
+	struct DrawParams {
+		uint firstInstance;
+		uint material;
+		uint numTextures;
+		uint pad = 0;
 	};
 
+	// Element of the indirect buffer, in the layout of glMultiDrawElementsIndirect
+	struct DrawCommand {
+		uint count;
+		uint instanceCount;
+		uint firstIndex;
+		int baseVertex;
+		uint baseInstance;
+	};
+
+	// Interleaved position, normal and uv like the vaos, no indices for a plain triangle list
+	struct MeshGeometry {
+		std::vector<float> vertices;
+		std::vector<uint> indices;
+	};
+
+	// A range of the buffers of its model, a mesh without indices gets sequential ones
 	struct Mesh {
-		uint vao;
-		uint instanceVBO;
+		uint firstIndex;
+		int baseVertex;
 		uint count;
 		uint material;
 		glm::vec3 minPoint;
 		glm::vec3 maxPoint;
+		std::shared_ptr<const MeshGeometry> geometry{};
+		std::shared_ptr<const std::vector<glm::vec2>> lightmapUVs{};
 	};
 
 	struct ModelState {
 		std::vector<Mesh> meshes;
-		bool useIndices;
-		uint shader;
-		GpuVector modifierData;
-		std::vector<Instance> instances;
+		uint shader = 0;
+		// The meshes share these buffers, so the meshes of a model are drawn with one multi-draw
+		uint vao            = 0;
+		uint vertexBuffer   = 0;
+		uint indexBuffer    = 0;
+		uint lightmapBuffer = 0;
+		glm::vec3 minPoint{0.0f};
+		glm::vec3 maxPoint{0.0f};
+
+		// Owned by the simulation
+		std::vector<float> modifierParams{};
+		uint64_t modifierTypes    = 0;
+		size_t modifierDirtyBegin = 0;
+		size_t modifierDirtyEnd   = 0;
+		std::shared_ptr<const std::vector<float>> modifierSnapshot{};
+		uint modifierVersion        = 0;
+		size_t modifierVersionBegin = 0;
+		size_t modifierVersionEnd   = 0;
+		std::vector<Instance> instances{};
+		std::optional<bool> depthPrePass{};
+		std::optional<bool> castShadows{};
+		bool isStatic = false;
+
+		// Owned by the renderer, the packed data of the instances that are drawn this frame
+		GpuVector modifierData{};
+		uint uploadedModifierVersion = 0;
+		std::vector<InstanceData> frameData{};
+		std::vector<InstanceKey> frameInstances{};
+		uint frameFirstDraw         = 0;
+		bool frameDepthPrePass      = false;
+		uint64_t frameModifierTypes = 0;
+
+		// Owned by the renderer, the casters of the shadow map that was packed last
+		std::vector<InstanceData> shadowData{};
+		std::vector<uint> shadowFaces{};
+		uint64_t shadowHash  = 0;
+		uint shadowFirstDraw = 0;
+	};
+
+	using ModelHandle = uint;
+
+	struct StaticInstance {
+		ModelHandle model;
+		uint slot;
+		glm::mat4 matrix;
+	};
+
+	struct ObjectChange {
+		ModelHandle model;
+		size_t index;
 	};
 
 	using ShaderParams =
@@ -60,36 +170,149 @@ namespace JaroViewer {
 
 	class ObjectManager {
 	public:
-		ObjectManager();
+		ObjectManager(JobSystem* jobs);
 
 		MaterialManager* getMaterialManager();
 
-		void registerModel(const std::string& ident, const std::vector<float>& vertices, ShaderParams shaderParams, uint material);
-		void registerModel(const std::string& ident, const std::string& modelPath, ShaderParams shaderParams);
-		Object createObject(const std::string& model);
+		std::optional<ModelHandle>
+		  registerModel(const std::string& ident, const std::vector<float>& vertices, ShaderParams shaderParams, uint material);
+		std::optional<ModelHandle>
+		  registerModel(const std::string& ident, const std::string& modelPath, ShaderParams shaderParams);
+		std::optional<ModelHandle> getModelHandle(const std::string& ident) const;
+
+		void setDepthPrePass(bool enable);
+		void setDepthPrePass(ModelHandle model, bool enable);
+		void setCastShadows(ModelHandle model, bool enable);
 
-		void renderObjects(bool usingPostProcessor, const glm::vec3& viewPos);
-		void renderRegions(const glm::vec3& viewPos);
+		// Lightmaps, the geometry of static models is baked once before the engine starts
+		void setStatic(ModelHandle model, bool enable);
+		std::vector<StaticInstance> getStaticInstances() const;
+		std::vector<std::shared_ptr<const MeshGeometry>> getGeometry(ModelHandle model) const;
+		void setLightmapGeometry(
+		  ModelHandle model,
+		  size_t meshIndex,
+		  const MeshGeometry& geometry,
+		  const std::vector<glm::vec2>& lightmapUVs
+		);
+		void setLightmapRect(ModelHandle model, uint slot, const glm::vec4& rect);
+		void setLightmapTexture(uint texture);
 
-		Object getFromObjectId(uint id) const;
+		void setLightFeatures(int numDirLights, bool shadows);
+
+		Object createObject(ModelHandle model);
+		Object createObject(const std::string& model);
+		void destroyObject(const Object& obj);
+		// Simulation side
+		void applyChanges();
+		void captureSnapshot(std::vector<ModelSnapshot>* models);
+		Object getObject(const InstanceKey& key) const;
+		float getRefitTime() const;
+
+		// Render side
+		void prepareFrame(
+		  const std::vector<ModelSnapshot>& previous,
+		  const std::vector<ModelSnapshot>& current,
+		  float alpha,
+		  const glm::mat4& viewProjection,
+		  FrameRingBuffer& ring
+		);
+		bool renderDepthPrePass();
+		void renderObjects(RenderPass pass = RenderPass::FORWARD);
+		void renderRegions();
+		std::optional<InstanceKey> getDrawnInstance(uint id) const;
+		std::optional<uint64_t> getSavedFragmentInvocations() const;
+		float getCullTime() const;
+		float getPackTime() const;
+		uint64_t packShadowCasters(
+		  const std::vector<ModelSnapshot>& previous,
+		  const std::vector<ModelSnapshot>& current,
+		  float alpha,
+		  std::span<const glm::mat4> viewProjections
+		);
+		void renderShadowCasters(FrameRingBuffer& ring, uint shaderIdent = PredefinedShader::DEPTH);
 
 	private:
-		void updateModifierTex(const ModifierStack& stack, const std::string& model, uint instanceIdent);
+		// The instances, draw parameters and indirect commands of a pass in the ring
+		struct DrawData {
+			FrameRingBuffer::Allocation instances;
+			size_t instancesSize;
+			FrameRingBuffer::Allocation params;
+			size_t paramsSize;
+			FrameRingBuffer::Allocation commands;
+		};
+
+		// Deletes the baked lightmap with the manager, behind a pointer so the manager stays movable
+		struct LightmapTexture {
+			uint texture;
+			~LightmapTexture();
+		};
 
-		Mesh registerVerticesModel(const std::vector<float>& vertices, uint material);
-		Mesh registerIndicesModel(const std::vector<float>& vertices, const std::vector<uint>& indices, uint material);
-		uint handleBuffers();
+		void recordChange(ModelHandle model, size_t index, RawObject* obj, ObjectEvent event);
+		void updateModifierTex(const ModifierStack& stack, ModelState& state, Instance& instance);
+		void releaseModifierRange(ModelState& state, Instance& instance);
+		void syncModifierData(ModelState& state, const ModelSnapshot& snapshot, FrameRingBuffer& ring);
+		void refitInstance(const ModelState& state, Instance& instance, const RawObject& obj);
+		void snapshotModel(const ModelState& state, ModelSnapshot* snapshot);
+		void cullInstances(
+		  ModelHandle model,
+		  const ModelSnapshot* previous,
+		  const ModelSnapshot& current,
+		  float alpha,
+		  const Frustum& frustum
+		);
+		void packInstances(ModelState& state);
+		void packShadowModel(
+		  ModelState& state,
+		  const ModelSnapshot* previous,
+		  const ModelSnapshot& current,
+		  float alpha,
+		  const std::vector<Frustum>& frustums
+		);
+		void updateModelBounds(ModelState& state);
+		DrawData uploadDraws(bool shadows, FrameRingBuffer& ring);
+		void bindDraws(const DrawData& draws) const;
+		void drawModel(ModelState& state, uint shaderIdent, const DrawData& draws, uint firstDraw);
 
-		void registerFileModel(const std::string& ident, const std::string& modelPath, uint shader);
-		void processNode(aiNode* node, const std::string& ident, const std::string& directory, const aiScene* scene);
+		Mesh createMesh(const std::vector<float>& vertices, const std::vector<uint>& indices, uint material) const;
+		void uploadModel(ModelState& state);
+		void handleBuffers(uint vertexBuffer);
+
+		std::optional<ModelHandle>
+		  registerFileModel(const std::string& ident, const std::string& modelPath, uint shader);
+		void processNode(aiNode* node, ModelHandle model, const std::string& directory, const aiScene* scene);
 		Mesh processMesh(aiMesh* mesh, const std::string& directory, const aiScene* scene);
 		std::vector<std::string> loadMaterials(aiMaterial* mat, TextureType type);
 
-		size_t getNextFreeSlot(const std::string& model) const;
+		size_t getNextFreeSlot(ModelHandle model) const;
 
-		std::map<std::string, ModelState> mModels;
+		std::vector<ModelState> mModels;
+		std::map<std::string, ModelHandle> mModelHandles;
+		std::vector<ObjectChange> mChanges;
+		JobSystem* mJobs;
 		ShaderManager mShaderManager;
 		MaterialManager mMaterialManager;
+
+		// Depth pre-pass, the queries count the fragment shader invocations of both passes
+		static const uint cQUERYFRAMES = 4;
+		bool mDepthPrePass;
+		std::unique_ptr<QueryRing> mFragmentQueries;
 		std::shared_ptr<Assimp::Importer> mImporter;
+		std::unique_ptr<LightmapTexture> mLightmapTexture;
+
+		// The draws of the camera passes, shared by all passes of a frame
+		DrawData mFrameDraws;
+		std::vector<DrawParams> mDrawParams;
+		std::vector<DrawCommand> mDrawCommands;
+
+		// The light features of this frame, the built-in shaders are specialized on them
+		ShaderFeatures mLightFeatures;
+
+		// Cpu time of the jobs summed over all threads, the refit is owned by the simulation
+		float mRefitTime;
+		float mCullTime;
+		float mPackTime;
+
+		// The thread with the gl context, the only one that may register models
+		std::thread::id mGlThread;
 	};
 } // namespace JaroViewer
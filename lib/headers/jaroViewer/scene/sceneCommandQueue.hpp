@@ -0,0 +1,94 @@
+#pragma once
+
+#include "jaroViewer/core/mpscQueue.hpp"
+#include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/modifiers/modifier.hpp"
+#include "jaroViewer/scene/object.hpp"
+#include "jaroViewer/scene/objectManager.hpp"
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <variant>
+
+namespace JaroViewer {
+	/**
+	 * Records scene changes from any thread, the thread that owns the scene applies them
+	 * at the start of every update
+	 */
+	class SceneCommandQueue {
+	public:
+		// Objects
+		void createObject(ModelHandle model, std::function<void(Object)> onCreated = {});
+		void destroyObject(Object obj);
+		void setTranslation(Object obj, const glm::vec3& translation);
+		void setRotation(Object obj, float angleX, float angleY, float angleZ);
+		void setScale(Object obj, const glm::vec3& scale);
+		void setVisibility(Object obj, bool visibility);
+		void addModifier(Object obj, std::shared_ptr<Modifier> modifier);
+
+		// Lights
+		void addDirLight(std::shared_ptr<DirectionalLight> light);
+		void addPointLight(std::shared_ptr<PointLight> light);
+		void addSpotlight(std::shared_ptr<Spotlight> light);
+		void editLights(std::function<void(LightSet&)> edit);
+
+		size_t apply(ObjectManager& objectManager, LightSet& lights);
+
+	private:
+		struct CreateObject {
+			ModelHandle model;
+			std::function<void(Object)> onCreated;
+		};
+		struct DestroyObject {
+			Object obj;
+		};
+		struct SetTranslation {
+			Object obj;
+			glm::vec3 translation;
+		};
+		struct SetRotation {
+			Object obj;
+			glm::vec3 angles;
+		};
+		struct SetScale {
+			Object obj;
+			glm::vec3 scale;
+		};
+		struct SetVisibility {
+			Object obj;
+			bool visibility;
+		};
+		struct AddModifier {
+			Object obj;
+			std::shared_ptr<Modifier> modifier;
+		};
+		struct AddDirLight {
+			std::shared_ptr<DirectionalLight> light;
+		};
+		struct AddPointLight {
+			std::shared_ptr<PointLight> light;
+		};
+		struct AddSpotlight {
+			std::shared_ptr<Spotlight> light;
+		};
+		struct EditLights {
+			std::function<void(LightSet&)> edit;
+		};
+
+		using Command = std::variant<
+		  CreateObject,
+		  DestroyObject,
+		  SetTranslation,
+		  SetRotation,
+		  SetScale,
+		  SetVisibility,
+		  AddModifier,
+		  AddDirLight,
+		  AddPointLight,
+		  AddSpotlight,
+		  EditLights>;
+
+		MpscQueue<Command> mCommands;
+	};
+} // namespace JaroViewer
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "jaroViewer/lighting/lightSet.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+namespace JaroViewer {
+	struct InstanceKey {
+		uint model;
+		uint slot;
+		uint generation;
+	};
+
+	struct InstanceSnapshot {
+		uint slot;
+		uint generation;
+		glm::vec3 translation;
+		glm::quat rotation;
+		glm::vec3 scale;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		uint modifierStart;
+		uint modifierCount;
+		glm::vec4 lightmapRect;
+		uint material;
+	};
+
+	struct ModelSnapshot {
+		// Visible instances sorted on slot
+		std::vector<InstanceSnapshot> instances;
+
+		// Shared with the model until the modifier data changes again
+		std::shared_ptr<const std::vector<float>> modifierParams;
+		uint64_t modifierTypes;
+		uint modifierVersion;
+		size_t modifierDirtyBegin;
+		size_t modifierDirtyEnd;
+
+		bool depthPrePass;
+		bool castShadows;
+	};
+
+	/**
+	 * Everything the renderer needs from the simulation to draw a frame
+	 */
+	struct SceneSnapshot {
+		double time = 0.0;
+		float updateTime = 0.0f;
+		float refitTime  = 0.0f;
+		glm::vec3 cameraPosition{0.0f};
+		glm::quat cameraRotation{1.0f, 0.0f, 0.0f, 0.0f};
+		std::shared_ptr<const LightSet::Image> lights{};
+		std::vector<ModelSnapshot> models{};
+	};
+} // namespace JaroViewer
@@ -4,10 +4,15 @@
 #include "jaroViewer/core/window.hpp"
 #include "jaroViewer/graphics/cubemap.hpp"
 #include "jaroViewer/graphics/frameBuffer.hpp"
+#include "jaroViewer/graphics/textureCache.hpp"
 #include "jaroViewer/input/inputHandler.hpp"
 #include "jaroViewer/lighting/lightSet.hpp"
+#include "jaroViewer/rendering/programCache.hpp"
 
-#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
 #include <memory>
 #include <optional>
 
@@ -17,30 +22,31 @@ EngineState Engine::argsToState(const EngineArgs& args) {
 	glfwInit();
 	Window window{args.openGLMajor,  args.openGLMinor, args.windowWidth,
 	              args.windowHeight, args.windowTitle, args.windowSamples};
-
-	std::optional<Cubemap> mp = std::visit(
-	  Tools::Overloaded{
-	    [&](const std::string& dirPath) -> std::optional<Cubemap> {
-		    if (dirPath == "") return std::nullopt;
-		    return Cubemap(dirPath);
-	    },
-	    [&](const std::vector<std::string>& filePaths) -> std::optional<Cubemap> {
-		    if (filePaths.size() == 0) return std::nullopt;
-		    return Cubemap(filePaths);
-	    },
-	  },
-	  args.cubemapParams
-	);
+	ProgramCache::setDirectory(args.shaderCacheDirectory);
+	TextureCache::setDirectory(args.textureCacheDirectory);
 
 	std::optional<PostProcessor> pp = (args.postProcessShader != "") ?
 	  std::optional<PostProcessor>(PostProcessor(&window, args.postProcessShader)) :
 	  std::nullopt;
 
 	EngineState state{
-	  std::move(window), Camera(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
-	  std::move(mp), std::move(pp)
+	  std::move(window), Camera(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), std::move(pp),
+	  args.workerThreads
 	};
 	state.camera.addControls(state.input);
+
+	// The faces of the cubemap are read on the job system of the state
+	std::visit(
+	  Tools::Overloaded{
+	    [&](const std::string& dirPath) {
+		    if (dirPath != "") state.cubemap.emplace(dirPath, state.jobs.get());
+	    },
+	    [&](const std::vector<std::string>& filePaths) {
+		    if (filePaths.size() != 0) state.cubemap.emplace(filePaths, state.jobs.get());
+	    },
+	  },
+	  args.cubemapParams
+	);
 	return state;
 }
 
@@ -48,8 +54,24 @@ Engine::Engine(const EngineArgs& args)
   : mClickCallback(
       [](JaroViewer::InputHandler::KeyAction, std::shared_ptr<JaroViewer::RawObject>) {}
     ),
+    mGlfw(),
     mState(argsToState(args)),
+    mFrameStats{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0, 0, 0, 0, 0, 0, 0.0f, 0, 0},
+    mPublishedStats(mFrameStats),
+    mThreaded(args.simulationThread),
+    mSimulationRate(args.simulationRate),
+    mStopSimulation(false),
+    mFramesInFlight(args.framesInFlight),
+    mClusterGrid(args.clusterGrid),
+    mMaxLightsPerCluster(args.maxLightsPerCluster),
+    mMaxActiveLights(args.maxActiveLights),
+    mDeferredShading(args.deferredShading),
+    mShadowAtlasSize(args.shadowAtlasSize),
+    mShadowDistance(args.shadowDistance),
     mUpdateFunc([](float) {}) {
+	mState.objectManager.setDepthPrePass(args.depthPrePass);
+	mState.objectManager.getMaterialManager()->setUploadBudget(args.textureUploadBudget);
+	if (mState.cubemap) mState.cubemap->setUploadBudget(args.textureUploadBudget);
 	mState.input.addMouseKey(GLFW_MOUSE_BUTTON_LEFT, InputHandler::KeyAction::PRESS, [this](InputParams params) {
 		this->triggerClick(InputHandler::KeyAction::PRESS, params);
 	});
@@ -57,39 +79,64 @@ Engine::Engine(const EngineArgs& args)
 		this->triggerClick(InputHandler::KeyAction::RELEASE, params);
 	});
 }
-Engine::~Engine() { glfwTerminate(); }
+/**
+ * Releases the renderers before the state, glfw is terminated after the state is destroyed
+ */
+Engine::~Engine() {
+	mShadowMaps.reset();
+	mDeferred.reset();
+	mLightClusters.reset();
+	mFrameRing.reset();
+}
+
+Engine::GlfwLibrary::~GlfwLibrary() { glfwTerminate(); }
 
 void Engine::start() {
-	mTransformUBO = std::make_shared<UniformBuffer>(0, sizeof(Tranformation), GL_STATIC_DRAW);
-	mLightsUBO = std::shared_ptr<UniformBuffer>(
-	  new UniformBuffer(1, sizeof(LightSet::LightSetStruct), GL_STATIC_DRAW)
-	);
+	mFrameRing = std::make_unique<FrameRingBuffer>(1 << 20, mFramesInFlight);
+	mLightClusters =
+	  std::make_unique<LightClusters>(mClusterGrid, mMaxLightsPerCluster, mMaxActiveLights);
+	mShadowMaps = std::make_unique<ShadowMaps>(mShadowAtlasSize, mShadowDistance);
+	if (mDeferredShading) {
+		Size size = mState.window.getSize();
+		mDeferred = std::make_unique<DeferredRenderer>(size.width, size.height);
+	}
+
+	// Fill both snapshots of the renderer, so the first frame has something to interpolate
+	for (int i = 0; i < 2; ++i) {
+		captureSnapshot(0.0f);
+		mSnapshots.acquire();
+	}
+
+	if (mThreaded) mSimulation = std::thread([this]() { this->simulationLoop(); });
 	render();
+	if (mThreaded) {
+		mStopSimulation = true;
+		mSimulation.join();
+	}
 }
 
 EngineState* Engine::getState() { return &mState; }
 
+/**
+ * Returns the cpu time in seconds spent on the stages of the last frame
+ */
+/**
+ * Returns the stats of the last completed frame, safe to call from the update function
+ * on the simulation thread
+ */
+FrameStats Engine::getFrameStats() const {
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	return mPublishedStats;
+}
+
+/**
+ * Queues a click, the clicked object is looked up when the next frame is rendered
+ * and the click callback is called on the next update
+ */
 void Engine::triggerClick(InputHandler::KeyAction action, InputParams params) {
 	if (!params.mouseInScreen) return;
-	auto size    = mState.window.getSize();
-	int flippedY = size.height - (int)params.mouseY - 1;
-	FrameBuffer buffer{
-	  {mState.window.getSize().width, mState.window.getSize().height, true, true, GL_R32UI}
-	};
-	buffer.bind();
-	buffer.clear(0, 0, 0, 0);
-	glDisable(GL_BLEND);
-	mState.objectManager.renderRegions(mState.camera.getPosition());
-	glEnable(GL_BLEND);
-
-	unsigned int id;
-	glReadPixels(params.mouseX, flippedY, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &id);
-	buffer.unbind();
-
-	if (id == 0) return;
-	Object obj = mState.objectManager.getFromObjectId(id - 1);
-	assert(obj != nullptr);
-	mClickCallback(action, obj);
+	std::lock_guard<std::mutex> lock(mPickMutex);
+	mPickRequests.push_back({action, params.mouseX, params.mouseY});
 }
 
 void Engine::setUpdateFunc(std::function<void(float delta)> func) {
@@ -97,37 +144,212 @@ void Engine::setUpdateFunc(std::function<void(float delta)> func) {
 }
 
 void Engine::render() {
-	Tranformation trans{mState.window.getProjection(), mState.camera.getView()};
+	Tranformation trans{
+	  mState.window.getProjection(), mState.camera.getView(), mState.camera.getPosition(), 0.0f
+	};
 	Timer timer{};
 	while (!mState.window.shouldClose()) {
-
-		// Update the UBOs
-		trans.view = mState.camera.getView();
+		mFrameRing->beginFrame();
 		if (mState.window.updateView()) {
-			if (mState.postProcessor)
-				mState.postProcessor
-				  ->resize(mState.window.getSize().width, mState.window.getSize().height);
+			Size size = mState.window.getSize();
+			if (mState.postProcessor) mState.postProcessor->resize(size.width, size.height);
+			if (mDeferred) mDeferred->resize(size.width, size.height);
 			trans.projection = mState.window.getProjection();
 		}
-		mTransformUBO->updateData(&trans);
-		LightSet::LightSetStruct lights = mState.lights.getStruct();
-		mLightsUBO->updateData(&lights);
+
+		if (mState.cubemap) mState.cubemap->update(*mFrameRing);
 
 		// Updates
-		float delta = timer.getDeltaTime();
-		mUpdateFunc(delta);
-		mState.input.processInputs(delta);
+		mState.input.pollInputs();
+		if (!mThreaded) simulate(timer.getDeltaTime());
+		mSnapshots.acquire();
+		const SceneSnapshot& prev = mSnapshots.getPrevious();
+		const SceneSnapshot& curr = mSnapshots.getCurrent();
+		mFrameStats.updateTime    = curr.updateTime;
+		mFrameStats.refitTime     = curr.refitTime;
+
+		// Render one update behind the simulation, so there are two updates to interpolate
+		float alpha = 1.0f;
+		if (mThreaded && curr.time > prev.time) {
+			double renderTime = glfwGetTime() - 1.0 / mSimulationRate;
+			alpha = std::clamp<float>((renderTime - prev.time) / (curr.time - prev.time), 0.0f, 1.0f);
+		}
+
+		// Update the UBOs
+		glm::vec3 viewPos = glm::mix(prev.cameraPosition, curr.cameraPosition, alpha);
+		glm::quat viewRot = glm::slerp(prev.cameraRotation, curr.cameraRotation, alpha);
+		trans.view        = glm::mat4_cast(viewRot) * glm::translate(glm::mat4(1.0f), -viewPos);
+		trans.viewPos     = viewPos;
+		mLightClusters->upload(*curr.lights, *mFrameRing);
+		mState.objectManager.setLightFeatures(curr.lights->header.numDirLights, curr.lights->castShadows);
+		mLightClusters->build(
+		  *curr.lights, trans.view, trans.projection, mState.window.getSize(), mState.window.getNearPlane(),
+		  mState.window.getFarPlane(), *mFrameRing
+		);
+
+		double stageTime = glfwGetTime();
+		mState.objectManager
+		  .prepareFrame(prev.models, curr.models, alpha, trans.projection * trans.view, *mFrameRing);
+		mFrameStats.prepareTime = glfwGetTime() - stageTime;
+		mFrameStats.cullTime    = mState.objectManager.getCullTime();
+		mFrameStats.packTime    = mState.objectManager.getPackTime();
+
+		// The shadow tiles are drawn with the matrices of their light, the camera is bound after
+		stageTime = glfwGetTime();
+		mShadowMaps->update(
+		  prev, curr, alpha, trans.view, trans.projection, mState.window.getNearPlane(),
+		  mState.window.getFarPlane(), mState.window.getSize(), mState.objectManager, *mFrameRing
+		);
+		mFrameRing->bindUniform(0, &trans, sizeof(Tranformation));
 
 		// Redraw the screen
 		mState.window.clear();
-		if (mState.postProcessor)
+		if (mState.postProcessor && !mDeferred)
 			mState.postProcessor->bindAndClear(0.0f, 0.0f, 0.0f, 0.0f);
 
-		mState.objectManager
-		  .renderObjects(mState.postProcessor.has_value(), mState.camera.getPosition());
-		if (mState.cubemap) mState.cubemap->render();
+		if (mDeferred) {
+			renderDeferred(trans.projection * trans.view);
+		} else {
+			mState.objectManager.renderDepthPrePass();
+			mState.objectManager.renderObjects();
+			if (mState.cubemap) mState.cubemap->render();
+			if (mState.postProcessor) mState.postProcessor->render();
+		}
+		mFrameStats.renderTime = glfwGetTime() - stageTime;
+		mFrameStats.savedFragmentInvocations =
+		  mState.objectManager.getSavedFragmentInvocations().value_or(0);
+		mFrameStats.activeLights = mLightClusters->getNumActiveLights();
+		ShadowMaps::Stats shadowStats    = mShadowMaps->getStats();
+		mFrameStats.shadowTilesRendered  = shadowStats.tilesRendered;
+		mFrameStats.shadowTilesCached    = shadowStats.tilesCached;
+		mFrameStats.shadowAtlasBytes     = shadowStats.atlasBytes;
+		mFrameStats.shadowAtlasUsedBytes = shadowStats.atlasUsedBytes;
 
-		if (mState.postProcessor) mState.postProcessor->render();
+		processPicks();
+		mFrameRing->endFrame();
 		mState.window.update();
+
+		// The glfw timer starts at glfwInit, so the first frame includes every shader compile
+		if (mFrameStats.timeToFirstFrame == 0.0f) {
+			ProgramCache::Stats programs = ProgramCache::getStats();
+			mFrameStats.timeToFirstFrame = glfwGetTime();
+			mFrameStats.programsLoaded   = programs.loaded;
+			mFrameStats.programsCompiled = programs.compiled;
+			std::cout << "[Engine] First frame after " << mFrameStats.timeToFirstFrame << "s ("
+			          << programs.loaded << " programs cached, " << programs.compiled << " compiled)"
+			          << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		mPublishedStats = mFrameStats;
+	}
+}
+
+/**
+ * Runs one update and publishes the result to the renderer
+ * @param delta The time the update covers
+ */
+void Engine::simulate(float delta) {
+	double startTime = glfwGetTime();
+	mState.commands->apply(mState.objectManager, mState.lights);
+
+	std::vector<PickResult> results;
+	{
+		std::lock_guard<std::mutex> lock(mPickMutex);
+		std::swap(results, mPickResults);
+	}
+	for (const PickResult& result : results) {
+		Object obj = mState.objectManager.getObject(result.instance);
+		if (obj) mClickCallback(result.action, obj);
+	}
+
+	mUpdateFunc(delta);
+	mState.input.processInputs(delta);
+	captureSnapshot(glfwGetTime() - startTime);
+}
+
+void Engine::simulationLoop() {
+	float tick        = 1.0f / mSimulationRate;
+	double nextUpdate = glfwGetTime();
+	while (!mStopSimulation) {
+		simulate(tick);
+
+		// Updates that fall behind are not caught up, the simulation slows down instead
+		nextUpdate += tick;
+		double now = glfwGetTime();
+		if (nextUpdate > now)
+			std::this_thread::sleep_for(std::chrono::duration<double>(nextUpdate - now));
+		else
+			nextUpdate = now;
+	}
+}
+
+/**
+ * Copies the camera, lights and objects into the write slot of the snapshots and publishes it
+ * @param updateTime The time the update took, only used for the frame stats
+ */
+void Engine::captureSnapshot(float updateTime) {
+	SceneSnapshot& snapshot = mSnapshots.getWriteSlot();
+	mState.lights.update();
+	snapshot.time           = glfwGetTime();
+	snapshot.updateTime     = updateTime;
+	snapshot.cameraPosition = mState.camera.getPosition();
+	snapshot.cameraRotation = glm::quat_cast(glm::mat3(mState.camera.getView()));
+	snapshot.lights         = mState.lights.getImage();
+	mState.objectManager.captureSnapshot(&snapshot.models);
+	snapshot.refitTime = mState.objectManager.getRefitTime();
+	mSnapshots.publish();
+}
+
+/**
+ * Draws the frame through the G-buffer, the models without the basic shader and the
+ * cubemap are drawn forward on top of the lit result
+ * @param viewProjection The view projection matrix of this frame
+ */
+void Engine::renderDeferred(const glm::mat4& viewProjection) {
+	mDeferred->bindGeometry();
+	mState.objectManager.renderObjects(RenderPass::DEFERRED_GEOMETRY);
+	mDeferred->renderLighting(viewProjection);
+	mState.objectManager.renderObjects(RenderPass::DEFERRED_FORWARD);
+	if (mState.cubemap) mState.cubemap->render();
+
+	if (mState.postProcessor)
+		mState.postProcessor->render(mDeferred->getLitColor());
+	else
+		mDeferred->present();
+}
+
+/**
+ * Renders the object ids of the current frame for the queued clicks
+ */
+void Engine::processPicks() {
+	std::vector<PickRequest> requests;
+	{
+		std::lock_guard<std::mutex> lock(mPickMutex);
+		std::swap(requests, mPickRequests);
 	}
+	if (requests.empty()) return;
+
+	Size size = mState.window.getSize();
+	FrameBuffer buffer{{size.width, size.height, true, true, GL_R32UI}};
+	buffer.bind();
+	buffer.clear(0, 0, 0, 0);
+	glDisable(GL_BLEND);
+	mState.objectManager.renderRegions();
+	glEnable(GL_BLEND);
+
+	std::vector<PickResult> results;
+	for (const PickRequest& request : requests) {
+		unsigned int id;
+		int flippedY = size.height - request.y - 1;
+		glReadPixels(request.x, flippedY, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &id);
+		if (id == 0) continue;
+
+		std::optional<InstanceKey> instance = mState.objectManager.getDrawnInstance(id - 1);
+		if (instance.has_value()) results.push_back({request.action, instance.value()});
+	}
+	buffer.unbind();
+
+	std::lock_guard<std::mutex> lock(mPickMutex);
+	mPickResults.insert(mPickResults.end(), results.begin(), results.end());
 }
@@ -0,0 +1,244 @@
+#include "jaroViewer/core/jobSystem.hpp"
+
+#include <algorithm>
+
+using namespace JaroViewer;
+
+namespace {
+	// Index of the worker that runs on this thread, -1 for threads outside the pool
+	thread_local int tWorkerIndex = -1;
+} // namespace
+
+/**
+ * Creates a work stealing job system
+ * @param numThreads The amount of threads that execute jobs including the thread that waits on them,
+ *                   0 uses all hardware threads
+ */
+JobSystem::JobSystem(uint numThreads)
+  : mPending(0), mNextWorker(0), mStopping(false), mPendingBackground(0), mRunningBackground(0) {
+	if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// The waiting thread helps out, so it takes the place of one worker
+	for (uint i = 0; i + 1 < numThreads; ++i)
+		mWorkers.push_back(std::make_unique<Worker>());
+
+	// Half of the workers stay free for the frame, without workers one thread only runs background jobs
+	mMaxBackground = std::max<uint>(mWorkers.size() / 2, 1);
+	for (uint i = 0; i < mWorkers.size(); ++i)
+		mThreads.emplace_back([this, i]() { this->workerLoop(i); });
+	if (mWorkers.empty()) mThreads.emplace_back([this]() { this->workerLoop(-1); });
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mStopping = true;
+	}
+	mWakeUp.notify_all();
+	for (auto& thread : mThreads) thread.join();
+}
+
+uint JobSystem::getNumThreads() const { return mWorkers.size() + 1; }
+
+/**
+ * Queues a job, jobs submitted from a worker end up in its own deque
+ * @param job The job to execute
+ */
+void JobSystem::submit(Job job) {
+	if (mWorkers.empty()) {
+		job();
+		return;
+	}
+
+	uint index = (tWorkerIndex >= 0) ? tWorkerIndex : mNextWorker++ % mWorkers.size();
+	mPending++;
+	{
+		std::lock_guard<std::mutex> lock(mWorkers.at(index)->mutex);
+		mWorkers.at(index)->jobs.push_back(std::move(job));
+	}
+	{ std::lock_guard<std::mutex> lock(mSleepMutex); }
+	mWakeUp.notify_one();
+}
+
+/**
+ * Queues a long job that must not stall a thread waiting on other jobs. It runs on a worker
+ * that has no other job, never inside waitFor
+ * @param job The job to execute
+ */
+void JobSystem::submitBackground(Job job) {
+	{
+		std::lock_guard<std::mutex> lock(mBackgroundMutex);
+		mBackground.push_back(std::move(job));
+		mPendingBackground++;
+	}
+	{ std::lock_guard<std::mutex> lock(mSleepMutex); }
+	mWakeUp.notify_one();
+}
+
+/**
+ * Executes jobs until the counter reaches zero, background jobs are left to the workers
+ * @param remaining Counter that the awaited jobs decrement when they finish
+ */
+void JobSystem::waitFor(const std::atomic<size_t>& remaining) {
+	while (remaining.load(std::memory_order_acquire) > 0)
+		if (!runOne(tWorkerIndex)) std::this_thread::yield();
+}
+
+/**
+ * Splits a range into chunks and executes them on all threads
+ * @param count The size of the range
+ * @param grainSize The maximum size of one chunk
+ * @param func The function that handles the range [begin, end)
+ */
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& func) {
+	if (count == 0) return;
+	grainSize     = std::max<size_t>(grainSize, 1);
+	size_t chunks = (count + grainSize - 1) / grainSize;
+	if (chunks == 1 || mWorkers.empty()) {
+		func(0, count);
+		return;
+	}
+
+	std::atomic<size_t> remaining = chunks - 1;
+	for (size_t chunk = 1; chunk < chunks; ++chunk) {
+		submit([&func, &remaining, chunk, grainSize, count]() {
+			size_t begin = chunk * grainSize;
+			func(begin, std::min(begin + grainSize, count));
+			remaining.fetch_sub(1, std::memory_order_release);
+		});
+	}
+	func(0, std::min(grainSize, count));
+	waitFor(remaining);
+}
+
+// A worker of index -1 only runs background jobs
+void JobSystem::workerLoop(int index) {
+	tWorkerIndex = index;
+	while (true) {
+		if ((index >= 0 && runOne(index)) || runBackground()) continue;
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mWakeUp.wait(lock, [this, index]() { return mStopping || hasWork(index); });
+		if (mStopping && !hasWork(index)) return;
+	}
+}
+
+// Takes the oldest background job, unless the most that may run at once are running
+bool JobSystem::runBackground() {
+	if (mRunningBackground.fetch_add(1) >= mMaxBackground) {
+		mRunningBackground--;
+		return false;
+	}
+
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mBackgroundMutex);
+		if (!mBackground.empty()) {
+			job = std::move(mBackground.front());
+			mBackground.pop_front();
+			mPendingBackground--;
+		}
+	}
+	if (job) job();
+	mRunningBackground--;
+
+	// A worker may sleep on a background job that could not be started until now
+	if (job) {
+		{ std::lock_guard<std::mutex> lock(mSleepMutex); }
+		mWakeUp.notify_all();
+	}
+	return static_cast<bool>(job);
+}
+
+bool JobSystem::hasWork(int index) const {
+	return (index >= 0 && mPending > 0) || (mPendingBackground > 0 && mRunningBackground < mMaxBackground);
+}
+
+/**
+ * Runs a single job from the own deque or stolen from another worker
+ * @param ownIndex The index of the worker, -1 if only stealing is possible
+ * @return If a job was executed
+ */
+bool JobSystem::runOne(int ownIndex) {
+	Job job;
+	if ((ownIndex >= 0 && popJob(ownIndex, &job)) || stealJob(ownIndex, &job)) {
+		job();
+		return true;
+	}
+	return false;
+}
+
+// Takes the newest job of a worker, which is the most likely to still be in cache
+bool JobSystem::popJob(uint index, Job* out) {
+	Worker& worker = *mWorkers.at(index);
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.jobs.empty()) return false;
+	*out = std::move(worker.jobs.back());
+	worker.jobs.pop_back();
+	mPending--;
+	return true;
+}
+
+// Takes the oldest job of the first other worker that has one
+bool JobSystem::stealJob(int thief, Job* out) {
+	size_t start = (thief < 0) ? 0 : thief;
+	for (size_t i = 1; i <= mWorkers.size(); ++i) {
+		Worker& victim = *mWorkers.at((start + i) % mWorkers.size());
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty()) continue;
+		*out = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		mPending--;
+		return true;
+	}
+	return false;
+}
+
+TaskGraph::TaskHandle TaskGraph::addTask(Job func) {
+	mTasks.push_back(std::make_unique<Task>());
+	mTasks.back()->func            = std::move(func);
+	mTasks.back()->numDependencies = 0;
+	return mTasks.size() - 1;
+}
+
+/**
+ * Adds a task that starts when another task is finished
+ * @param task The task that has to finish first
+ * @param func The continuation
+ */
+TaskGraph::TaskHandle TaskGraph::addContinuation(TaskHandle task, Job func) {
+	TaskHandle next = addTask(std::move(func));
+	addDependency(task, next);
+	return next;
+}
+
+/**
+ * Makes sure a task only starts after another one finished
+ * @pre The dependencies don't form a cycle
+ */
+void TaskGraph::addDependency(TaskHandle before, TaskHandle after) {
+	mTasks.at(before)->successors.push_back(after);
+	mTasks.at(after)->numDependencies++;
+}
+
+/**
+ * Runs all tasks respecting their dependencies, returns when all are done
+ * @param jobs The job system that executes the tasks
+ */
+void TaskGraph::run(JobSystem& jobs) {
+	std::atomic<size_t> remaining = mTasks.size();
+	for (auto& task : mTasks) task->pending = task->numDependencies;
+	for (TaskHandle i = 0; i < mTasks.size(); ++i)
+		if (mTasks.at(i)->numDependencies == 0) schedule(jobs, i, remaining);
+	jobs.waitFor(remaining);
+}
+
+void TaskGraph::schedule(JobSystem& jobs, TaskHandle task, std::atomic<size_t>& remaining) {
+	jobs.submit([this, &jobs, task, &remaining]() {
+		Task& current = *mTasks.at(task);
+		current.func();
+		for (TaskHandle next : current.successors)
+			if (mTasks.at(next)->pending.fetch_sub(1) == 1) schedule(jobs, next, remaining);
+		remaining.fetch_sub(1, std::memory_order_release);
+	});
+}
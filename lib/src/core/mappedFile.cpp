@@ -0,0 +1,75 @@
+#include "jaroViewer/core/mappedFile.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace JaroViewer;
+
+/**
+ * Maps a file, isOpen tells if it could be read
+ * @param path The path to the file
+ */
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) : mData(nullptr), mSize(0), mOpen(false) {
+	HANDLE file = CreateFileA(
+	  path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size)) {
+		mOpen = true;
+		if (size.QuadPart > 0) {
+			// The view keeps the file mapped after both handles are closed
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			void* data     = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (data) {
+				mData = static_cast<const char*>(data);
+				mSize = (size_t)size.QuadPart;
+			} else {
+				mOpen = false;
+			}
+			if (mapping) CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+}
+
+MappedFile::~MappedFile() {
+	if (mData) UnmapViewOfFile(mData);
+}
+#else
+MappedFile::MappedFile(const std::string& path) : mData(nullptr), mSize(0), mOpen(false) {
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) return;
+	struct stat info;
+	if (fstat(file, &info) == 0) {
+		mOpen = true;
+		if (info.st_size > 0) {
+			void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED) {
+				mData = static_cast<const char*>(data);
+				mSize = info.st_size;
+			} else {
+				mOpen = false;
+			}
+		}
+	}
+	close(file);
+}
+
+MappedFile::~MappedFile() {
+	if (mData) munmap(const_cast<char*>(mData), mSize);
+}
+#endif
+
+bool MappedFile::isOpen() const { return mOpen; }
+
+std::string_view MappedFile::getView() const { return {mData, mSize}; }
@@ -20,6 +20,7 @@ unsigned int
 template unsigned int Tools::generateBuffer(const std::vector<float>&, unsigned int, unsigned int);
 template unsigned int
   Tools::generateBuffer(const std::vector<unsigned int>&, unsigned int, unsigned int);
+template unsigned int Tools::generateBuffer(const std::vector<glm::vec2>&, unsigned int, unsigned int);
 
 glm::mat3 Tools::getNormalModelMatrix(const glm::mat4& model) {
 	return glm::mat3(glm::transpose(glm::inverse(model)));
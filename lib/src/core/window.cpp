@@ -12,7 +12,7 @@ Window::Window(int major, int minor, int width, int height, const std::string& t
   : Window(major, minor, width, height, title, 1) {}
 
 Window::Window(int major, int minor, int width, int height, const std::string& title, uint samples)
-  : mWidth(width), mHeight(height) {
+  : mWidth(width), mHeight(height), mMouseMode(GLFW_CURSOR_NORMAL), mAppliedMouseMode(GLFW_CURSOR_NORMAL) {
 	// TODO: Initialize glfw in engine
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
@@ -61,7 +61,9 @@ Window::Window(Window&& other) noexcept
     mPosX(other.mPosX),
     mPosY(other.mPosY),
     mSamples(other.mSamples),
-    mIsFullscreen(other.mIsFullscreen) {
+    mIsFullscreen(other.mIsFullscreen),
+    mMouseMode(other.mMouseMode.load()),
+    mAppliedMouseMode(other.mAppliedMouseMode) {
 	other.mWindow = nullptr; // prevent the old object from destroying the window
 }
 
@@ -88,6 +90,12 @@ void Window::clear() {
 }
 
 void Window::update() {
+	int mouseMode = mMouseMode;
+	if (mouseMode != mAppliedMouseMode) {
+		glfwSetInputMode(mWindow, GLFW_CURSOR, mouseMode);
+		mAppliedMouseMode = mouseMode;
+	}
+
 	glfwSwapBuffers(mWindow);
 	glfwPollEvents();
 }
@@ -121,9 +129,11 @@ void Window::setShouldClose(bool close) {
 	glfwSetWindowShouldClose(mWindow, close);
 }
 
-void Window::setMouseMode(GLenum mode) {
-	glfwSetInputMode(mWindow, GLFW_CURSOR, mode);
-}
+/**
+ * Sets the cursor mode, it is applied on the next update so it can be called from any thread
+ * @param mode The glfw cursor mode
+ */
+void Window::setMouseMode(GLenum mode) { mMouseMode = mode; }
 
 void Window::makeActive() { glfwMakeContextCurrent(mWindow); }
 
@@ -133,14 +143,15 @@ bool Window::insideScreen(int x, int y) const {
 
 bool Window::shouldClose() const { return glfwWindowShouldClose(mWindow); }
 
-int Window::getMouseMode() const {
-	return glfwGetInputMode(mWindow, GLFW_CURSOR);
-}
+int Window::getMouseMode() const { return mMouseMode; }
 
 Size Window::getSize() const { return {mWidth, mHeight}; }
 
 GLFWwindow* Window::cPtr() const { return mWindow; }
 
 glm::mat4 Window::getProjection() const {
-	return glm::perspective(glm::radians(45.0f), (float)mWidth / (float)mHeight, 0.1f, 100.0f);
+	return glm::perspective(glm::radians(45.0f), (float)mWidth / (float)mHeight, cNEARPLANE, cFARPLANE);
 }
+
+float Window::getNearPlane() const { return cNEARPLANE; }
+float Window::getFarPlane() const { return cFARPLANE; }
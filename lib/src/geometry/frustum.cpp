@@ -0,0 +1,83 @@
+#include "jaroViewer/geometry/frustum.hpp"
+
+#include <algorithm>
+
+using namespace JaroViewer;
+
+/**
+ * Creates a frustum that contains everything
+ */
+Frustum::Frustum() { mPlanes.fill(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)); }
+
+/**
+ * Extracts the six clip planes from a projection matrix
+ * @param viewProjection The combined projection and view matrix
+ */
+Frustum::Frustum(const glm::mat4& viewProjection) {
+	glm::mat4 m = glm::transpose(viewProjection);
+	mPlanes[0]  = m[3] + m[0]; // left
+	mPlanes[1]  = m[3] - m[0]; // right
+	mPlanes[2]  = m[3] + m[1]; // bottom
+	mPlanes[3]  = m[3] - m[1]; // top
+	mPlanes[4]  = m[3] + m[2]; // near
+	mPlanes[5]  = m[3] - m[2]; // far
+	for (glm::vec4& plane : mPlanes) plane /= glm::length(glm::vec3(plane));
+}
+
+/**
+ * Checks if an axis aligned box is (partially) inside the frustum
+ * @param minPoint The minimum corner of the box
+ * @param maxPoint The maximum corner of the box
+ * @return False if the box is completely outside of the frustum
+ */
+bool Frustum::intersects(const glm::vec3& minPoint, const glm::vec3& maxPoint) const {
+	for (const glm::vec4& plane : mPlanes) {
+		glm::vec3 positive{
+		  plane.x >= 0.0f ? maxPoint.x : minPoint.x,
+		  plane.y >= 0.0f ? maxPoint.y : minPoint.y,
+		  plane.z >= 0.0f ? maxPoint.z : minPoint.z
+		};
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
+
+/**
+ * Checks if a sphere is (partially) inside the frustum
+ * @param center The center of the sphere
+ * @param radius The radius of the sphere
+ * @return False if the sphere is completely outside of the frustum
+ */
+bool Frustum::intersects(const glm::vec3& center, float radius) const {
+	for (const glm::vec4& plane : mPlanes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	return true;
+}
+
+/**
+ * Calculates the axis aligned bounds of a transformed box
+ * @param model The transformation of the box
+ * @param minPoint The minimum corner of the untransformed box
+ * @param maxPoint The maximum corner of the untransformed box
+ * @param outMin The minimum corner of the transformed bounds
+ * @param outMax The maximum corner of the transformed bounds
+ */
+void Frustum::transformBounds(
+  const glm::mat4& model,
+  const glm::vec3& minPoint,
+  const glm::vec3& maxPoint,
+  glm::vec3* outMin,
+  glm::vec3* outMax
+) {
+	glm::vec3 translation = glm::vec3(model[3]);
+	*outMin               = translation;
+	*outMax               = translation;
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++) {
+			float a = model[col][row] * minPoint[col];
+			float b = model[col][row] * maxPoint[col];
+			(*outMin)[row] += std::min(a, b);
+			(*outMax)[row] += std::max(a, b);
+		}
+	}
+}
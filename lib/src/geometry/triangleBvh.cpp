@@ -0,0 +1,240 @@
+#include "jaroViewer/geometry/triangleBvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+using namespace JaroViewer;
+
+namespace {
+	const uint cNUMBINS     = 12;
+	const uint cMAXLEAFSIZE = 4;
+	const uint cMAXDEPTH    = 60;
+
+	float getArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	// Returns the distance at which the ray enters the box, infinity if it misses
+	float intersectBox(
+	  const glm::vec3& boundsMin,
+	  const glm::vec3& boundsMax,
+	  const glm::vec3& origin,
+	  const glm::vec3& inverseDirection,
+	  float maxDistance
+	) {
+		glm::vec3 t0   = (boundsMin - origin) * inverseDirection;
+		glm::vec3 t1   = (boundsMax - origin) * inverseDirection;
+		glm::vec3 near = glm::min(t0, t1);
+		glm::vec3 far  = glm::max(t0, t1);
+		float enter    = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+		float exit     = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+		return (enter <= exit) ? enter : std::numeric_limits<float>::infinity();
+	}
+} // namespace
+
+/**
+ * Builds the hierarchy
+ * @param corners Three corners per triangle
+ */
+TriangleBvh::TriangleBvh(std::vector<glm::vec3> corners)
+  : mCorners(std::move(corners)), mTriangles(mCorners.size() / 3), mCentroids(), mNodes() {
+	std::iota(mTriangles.begin(), mTriangles.end(), 0);
+	mCentroids.reserve(mTriangles.size());
+	for (size_t i = 0; i < mTriangles.size(); ++i)
+		mCentroids.push_back((mCorners[i * 3] + mCorners[i * 3 + 1] + mCorners[i * 3 + 2]) / 3.0f);
+
+	mNodes.reserve(mTriangles.size() * 2 + 1);
+	mNodes.push_back(Node{glm::vec3(0.0f), 0, glm::vec3(0.0f), (uint)mTriangles.size()});
+	build(0, 0);
+
+	// Store the corners in leaf order, so a leaf reads them in one block
+	std::vector<glm::vec3> ordered;
+	ordered.reserve(mCorners.size());
+	for (uint triangle : mTriangles)
+		for (uint i = 0; i < 3; ++i) ordered.push_back(mCorners[triangle * 3 + i]);
+	mCorners = std::move(ordered);
+	mCentroids.clear();
+}
+
+/**
+ * Finds the closest triangle along a ray
+ * @param direction The normalized direction of the ray
+ * @param maxDistance Triangles further away are ignored
+ * @return The distance and the triangle, empty if nothing was hit
+ */
+std::optional<TriangleBvh::Hit>
+  TriangleBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	return traverse<false>(origin, direction, maxDistance);
+}
+
+/**
+ * Checks if any triangle is in the way, stops at the first one found
+ */
+bool TriangleBvh::occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	return traverse<true>(origin, direction, maxDistance).has_value();
+}
+
+/**
+ * Returns the normalized geometric normal of a triangle that was hit
+ */
+glm::vec3 TriangleBvh::getNormal(uint triangle) const {
+	const glm::vec3* corner = &mCorners[triangle * 3];
+	return glm::normalize(glm::cross(corner[1] - corner[0], corner[2] - corner[0]));
+}
+
+size_t TriangleBvh::getNumTriangles() const { return mTriangles.size(); }
+
+void TriangleBvh::build(uint node, uint depth) {
+	uint first = mNodes[node].first;
+	uint count = mNodes[node].count;
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+	glm::vec3 centroidMin = boundsMin, centroidMax = boundsMax;
+	for (uint i = first; i < first + count; ++i) {
+		uint triangle = mTriangles[i];
+		for (uint c = 0; c < 3; ++c) {
+			boundsMin = glm::min(boundsMin, mCorners[triangle * 3 + c]);
+			boundsMax = glm::max(boundsMax, mCorners[triangle * 3 + c]);
+		}
+		centroidMin = glm::min(centroidMin, mCentroids[triangle]);
+		centroidMax = glm::max(centroidMax, mCentroids[triangle]);
+	}
+	mNodes[node].boundsMin = boundsMin;
+	mNodes[node].boundsMax = boundsMax;
+	if (count <= cMAXLEAFSIZE || depth >= cMAXDEPTH) return;
+
+	// Bin the centroids on every axis and keep the cheapest split
+	struct Bin {
+		glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+		glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+		uint count = 0;
+	};
+	auto getBin = [&](uint triangle, int axis) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		return std::min<uint>((mCentroids[triangle][axis] - centroidMin[axis]) / extent * cNUMBINS, cNUMBINS - 1);
+	};
+	float bestCost = getArea(boundsMin, boundsMax) * count;
+	int bestAxis   = -1;
+	uint bestSplit = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (centroidMax[axis] <= centroidMin[axis]) continue;
+
+		std::array<Bin, cNUMBINS> bins{};
+		for (uint i = first; i < first + count; ++i) {
+			uint triangle = mTriangles[i];
+			uint bin      = getBin(triangle, axis);
+			bins[bin].count++;
+			for (uint c = 0; c < 3; ++c) {
+				bins[bin].boundsMin = glm::min(bins[bin].boundsMin, mCorners[triangle * 3 + c]);
+				bins[bin].boundsMax = glm::max(bins[bin].boundsMax, mCorners[triangle * 3 + c]);
+			}
+		}
+
+		// Sweep from the right to get the cost of every right side
+		std::array<float, cNUMBINS> rightCost{};
+		Bin right;
+		for (uint b = cNUMBINS - 1; b > 0; --b) {
+			right.boundsMin  = glm::min(right.boundsMin, bins[b].boundsMin);
+			right.boundsMax  = glm::max(right.boundsMax, bins[b].boundsMax);
+			right.count     += bins[b].count;
+			rightCost[b]     = getArea(right.boundsMin, right.boundsMax) * right.count;
+		}
+		Bin left;
+		for (uint b = 0; b + 1 < cNUMBINS; ++b) {
+			left.boundsMin  = glm::min(left.boundsMin, bins[b].boundsMin);
+			left.boundsMax  = glm::max(left.boundsMax, bins[b].boundsMax);
+			left.count     += bins[b].count;
+			if (left.count == 0 || left.count == count) continue;
+			float cost = getArea(left.boundsMin, left.boundsMax) * left.count + rightCost[b + 1];
+			if (cost < bestCost) {
+				bestCost  = cost;
+				bestAxis  = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+	if (bestAxis < 0) return;
+
+	auto middle = std::partition(mTriangles.begin() + first, mTriangles.begin() + first + count, [&](uint triangle) {
+		return getBin(triangle, bestAxis) < bestSplit;
+	});
+	uint leftCount = middle - (mTriangles.begin() + first);
+
+	uint children = mNodes.size();
+	mNodes.push_back(Node{glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount});
+	mNodes.push_back(Node{glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount});
+	mNodes[node].first = children;
+	mNodes[node].count = 0;
+	build(children, depth + 1);
+	build(children + 1, depth + 1);
+}
+
+// Möller-Trumbore, returns infinity if the triangle is missed
+float TriangleBvh::intersectTriangle(uint triangle, const glm::vec3& origin, const glm::vec3& direction) const {
+	const float epsilon     = 1e-8f;
+	const glm::vec3* corner = &mCorners[triangle * 3];
+	glm::vec3 edge1         = corner[1] - corner[0];
+	glm::vec3 edge2         = corner[2] - corner[0];
+	glm::vec3 p             = glm::cross(direction, edge2);
+	float determinant       = glm::dot(edge1, p);
+	if (std::abs(determinant) < epsilon) return std::numeric_limits<float>::infinity();
+
+	float inverse = 1.0f / determinant;
+	glm::vec3 s   = origin - corner[0];
+	float u       = glm::dot(s, p) * inverse;
+	if (u < 0.0f || u > 1.0f) return std::numeric_limits<float>::infinity();
+	glm::vec3 q = glm::cross(s, edge1);
+	float v     = glm::dot(direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) return std::numeric_limits<float>::infinity();
+	float t = glm::dot(edge2, q) * inverse;
+	return (t > 0.0f) ? t : std::numeric_limits<float>::infinity();
+}
+
+template <bool AnyHit>
+std::optional<TriangleBvh::Hit>
+  TriangleBvh::traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	if (mNodes.empty() || mTriangles.empty()) return std::nullopt;
+	glm::vec3 inverseDirection = 1.0f / direction;
+
+	std::optional<Hit> hit;
+	std::array<uint, cMAXDEPTH * 2 + 2> stack;
+	uint size     = 0;
+	stack[size++] = 0;
+	while (size > 0) {
+		const Node& node = mNodes[stack[--size]];
+		if (intersectBox(node.boundsMin, node.boundsMax, origin, inverseDirection, maxDistance) ==
+		    std::numeric_limits<float>::infinity())
+			continue;
+
+		if (node.count > 0) {
+			for (uint i = node.first; i < node.first + node.count; ++i) {
+				float distance = intersectTriangle(i, origin, direction);
+				if (distance >= maxDistance) continue;
+				hit         = Hit{distance, i};
+				maxDistance = distance;
+				if (AnyHit) return hit;
+			}
+			continue;
+		}
+
+		// Visit the closer child first
+		const Node& left  = mNodes[node.first];
+		const Node& right = mNodes[node.first + 1];
+		float leftDistance =
+		  intersectBox(left.boundsMin, left.boundsMax, origin, inverseDirection, maxDistance);
+		float rightDistance =
+		  intersectBox(right.boundsMin, right.boundsMax, origin, inverseDirection, maxDistance);
+		if (leftDistance < rightDistance) {
+			stack[size++] = node.first + 1;
+			stack[size++] = node.first;
+		} else {
+			stack[size++] = node.first;
+			stack[size++] = node.first + 1;
+		}
+	}
+	return hit;
+}
@@ -6,11 +6,15 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
-#include <stb_image.h>
 #include <vector>
 
 using namespace JaroViewer;
 
+namespace {
+	// Bytes of the faces uploaded per frame unless the engine sets it
+	const size_t cUPLOADBUDGET = 8 << 20;
+} // namespace
+
 // TODO : Rework the view because in needs 2 cast for each call (Whut????)
 const std::string vertex = shaderVersion + vertexInputs +
   "out vec3 TexCoords;\n"
@@ -30,9 +34,14 @@ const std::string fragment = shaderVersion +
 /**
  * Creates a cubemap based of the paths to the textures
  * @param paths The paths to the texture in order (right, left, top, bottom, front, back);
+ * @param jobs The job system the images are read on
  */
-Cubemap::Cubemap(const std::vector<std::string>& paths)
-  : mShader{ShaderCode{vertex, "", fragment}} {
+Cubemap::Cubemap(const std::vector<std::string>& paths, JobSystem* jobs)
+  : mCubemap(0),
+    mVaoBuffer(0),
+    mShader{ShaderCode{vertex, "", fragment}},
+    mLoader(std::make_unique<TextureLoader>(jobs, cUPLOADBUDGET)),
+    mFacesLoaded(0) {
 	loadVao();
 	loadMap(paths);
 }
@@ -40,14 +49,34 @@ Cubemap::Cubemap(const std::vector<std::string>& paths)
 /**
  * Creates a cubemap based of the path to the directory with all textures
  * @param dir The directory with all the textures
+ * @param jobs The job system the images are read on
  */
-Cubemap::Cubemap(const std::string& dir) : Cubemap(getPaths(dir)) {}
+Cubemap::Cubemap(const std::string& dir, JobSystem* jobs) : Cubemap(getPaths(dir), jobs) {}
+
+/**
+ * Uploads the faces that were read within the budget of this frame, must be called once
+ * per frame on the gl thread until the cubemap is complete
+ * @param ring The buffer of this frame, the pixels are staged in it
+ */
+void Cubemap::update(FrameRingBuffer& ring) {
+	if (mFacesLoaded == 6) return;
+	mLoader->update(ring, [this](uint face, uint texture) {
+		if (texture == 0) return;
+		copyFace(face, texture);
+		glDeleteTextures(1, &texture);
+	});
+}
 
 /**
- * Renders the cubemap
+ * Sets the bytes of the faces that are uploaded per frame
+ */
+void Cubemap::setUploadBudget(size_t bytes) { mLoader->setBudget(bytes); }
+
+/**
+ * Renders the cubemap, once all faces are loaded
  */
 void Cubemap::render() const {
-	if (mVaoBuffer == 0) return;
+	if (mVaoBuffer == 0 || mFacesLoaded < 6) return;
 	glDepthFunc(GL_LEQUAL);
 	mShader.use();
 	glBindVertexArray(mVaoBuffer);
@@ -115,34 +144,56 @@ std::vector<std::string> Cubemap::getPaths(const std::string dir) const {
 }
 
 /**
- * Loads a cubemap texture into a new buffer
+ * Queues the faces on the loader, the cubemap texture is created when the first one arrives
  * @param paths The paths to the texture in order (right, left, top, bottom, front, back);
  */
 void Cubemap::loadMap(const std::vector<std::string>& paths) {
-	genBuffer();
+	if (paths.size() < 6) std::cout << "[Cubemap] Error: Expected six faces, got " << paths.size() << std::endl;
+	for (uint i = 0; i < paths.size() && i < 6; i++) mLoader->load(paths[i], false, i);
+}
+
+/**
+ * Generates the cubemap texture in the size and format of a face, so the faces are copied in as they are
+ * @param texture The first face that was loaded
+ */
+void Cubemap::genBuffer(uint texture) {
+	int width, height, format;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+	glGenTextures(1, &mCubemap);
 	bind();
-	bindTextures(paths);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, format, width, height);
 	setupParams();
+	unbind();
 }
 
-// Generates a new cubemap texture
-void Cubemap::genBuffer() { glGenTextures(1, &mCubemap); }
-
 /**
- * Binds all paths to the texture
- * @param paths The paths to the texture in order (right, left, top, bottom, front, back);
- * @pre The cubemap is active
+ * Copies the first level of a loaded image into a face of the cubemap
+ * @param face The index of the face (right, left, top, bottom, front, back)
+ * @param texture The loaded image
  */
-void Cubemap::bindTextures(const std::vector<std::string>& paths) {
-	int width, height, nrChannels;
-	for (unsigned int i = 0; i < paths.size(); i++) {
-		unsigned char* data = stbi_load(paths[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		else
-			std::cout << "ERROR::CUBEMAP::UNABLE_TO_LOAD::" << paths[i] << std::endl;
-		stbi_image_free(data);
+void Cubemap::copyFace(uint face, uint texture) {
+	if (mCubemap == 0) genBuffer(texture);
+
+	int width, height, format, faceWidth, faceHeight, faceFormat;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+	glGetTextureLevelParameteriv(mCubemap, 0, GL_TEXTURE_WIDTH, &faceWidth);
+	glGetTextureLevelParameteriv(mCubemap, 0, GL_TEXTURE_HEIGHT, &faceHeight);
+	glGetTextureLevelParameteriv(mCubemap, 0, GL_TEXTURE_INTERNAL_FORMAT, &faceFormat);
+	if (width != faceWidth || height != faceHeight || format != faceFormat) {
+		std::cout << "[Cubemap] Error: Face " << face << " differs in size or format from the other faces"
+		          << std::endl;
+		return;
 	}
+
+	glCopyImageSubData(
+	  texture, GL_TEXTURE_2D, 0, 0, 0, 0, mCubemap, GL_TEXTURE_CUBE_MAP, 0, 0, 0, face, width, height, 1
+	);
+	mFacesLoaded++;
 }
 
 /**
@@ -13,6 +13,7 @@ FrameBuffer::FrameBuffer(const FrameBufferArgs& args) {
 	mReadableColor        = args.readableColor;        // save these
 	mReadableDepthStencil = args.readableDepthStencil; // save these
 	mFormatType           = args.formatType;
+	mExtraColorFormats    = args.extraColorFormats;
 
 	genBuffer();
 	bind();
@@ -20,6 +21,7 @@ FrameBuffer::FrameBuffer(const FrameBufferArgs& args) {
 	  args.readableColor, &mColorTexture, &mColorRBO, GL_COLOR_ATTACHMENT0, args.formatType
 	);
 	createStorage(args.readableDepthStencil, &mDepthStencilTexture, &mDepthStencilRBO, GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8);
+	createExtraColors();
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cout << "[FrameBuffer] Error: Buffer is not complete" << std::endl;
 	unbind();
@@ -62,6 +64,8 @@ void FrameBuffer::resize(uint width, uint height) {
 	if (mDepthStencilTexture) glDeleteTextures(1, &mDepthStencilTexture);
 	if (mColorRBO) glDeleteRenderbuffers(1, &mColorRBO);
 	if (mDepthStencilRBO) glDeleteRenderbuffers(1, &mDepthStencilRBO);
+	if (!mExtraColorTextures.empty())
+		glDeleteTextures(mExtraColorTextures.size(), mExtraColorTextures.data());
 	if (mID) glDeleteFramebuffers(1, &mID);
 
 	mColorTexture = mDepthStencilTexture = 0;
@@ -72,6 +76,7 @@ void FrameBuffer::resize(uint width, uint height) {
 	bind();
 	createStorage(mReadableColor, &mColorTexture, &mColorRBO, GL_COLOR_ATTACHMENT0, mFormatType);
 	createStorage(mReadableDepthStencil, &mDepthStencilTexture, &mDepthStencilRBO, GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8);
+	createExtraColors();
 	unbind();
 }
 
@@ -85,6 +90,18 @@ uint FrameBuffer::getColor() const {
 	return 0;
 }
 
+/**
+ * Returns a color attachment as a texture id
+ * @param index The render target, 0 is the main color buffer
+ * @return The id of the texture with all the data
+ */
+uint FrameBuffer::getColor(uint index) const {
+	if (index == 0) return getColor();
+	if (index <= mExtraColorTextures.size()) return mExtraColorTextures.at(index - 1);
+	std::cout << "[FrameBuffer] Error: Color attachment " << index << " does not exist" << std::endl;
+	return 0;
+}
+
 /**
  * Returns the depth stencil buffer as a texture id
  * @return The id of the texture with all the data
@@ -95,6 +112,20 @@ uint FrameBuffer::getDepthStencil() const {
 	return 0;
 }
 
+/**
+ * Copies the depth and stencil values into another framebuffer of the same size
+ * @param target The framebuffer to copy to, stays bound afterwards
+ */
+void FrameBuffer::blitDepthStencil(const FrameBuffer& target) const {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.mID);
+	glBlitFramebuffer(
+	  0, 0, mWidth, mHeight, 0, 0, target.mWidth, target.mHeight,
+	  GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST
+	);
+	target.bind();
+}
+
 void FrameBuffer::genBuffer() { glGenFramebuffers(1, &mID); }
 
 /**
@@ -114,6 +145,12 @@ uint FrameBuffer::genTexure(GLenum formatType) {
 	} else if (formatType == GL_R32UI) {
 		format = GL_RED_INTEGER;
 		type   = GL_UNSIGNED_INT;
+	} else if (formatType == GL_RGBA8) {
+		format = GL_RGBA;
+		type   = GL_UNSIGNED_BYTE;
+	} else if (formatType == GL_RGBA16F) {
+		format = GL_RGBA;
+		type   = GL_FLOAT;
 	} else {
 		std::cout << "Unsupported texture format!" << std::endl;
 		return 0;
@@ -185,3 +222,19 @@ void FrameBuffer::createStorage(bool readable, uint* textureStorage, uint* rende
 	else
 		*renderStorage = bindRenderBuffer(usage);
 }
+
+/**
+ * Creates the extra color attachments and makes every attachment a render target
+ */
+void FrameBuffer::createExtraColors() {
+	mExtraColorTextures.clear();
+	if (mExtraColorFormats.empty()) return;
+
+	std::vector<GLenum> attachments{GL_COLOR_ATTACHMENT0};
+	for (size_t i = 0; i < mExtraColorFormats.size(); i++) {
+		GLenum attachment = GL_COLOR_ATTACHMENT1 + i;
+		mExtraColorTextures.push_back(bindTexture(attachment, mExtraColorFormats.at(i)));
+		attachments.push_back(attachment);
+	}
+	glDrawBuffers(attachments.size(), attachments.data());
+}
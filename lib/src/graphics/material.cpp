@@ -1,60 +1,60 @@
 #include "jaroViewer/graphics/material.hpp"
 
-#include <memory>
-#include <string>
-
 using namespace JaroViewer;
 
+namespace {
+	uint packTexture(uint texture, const std::vector<TextureLayer>& textures) {
+		if (texture == Material::cNOTEXTURE) return Material::cNOTEXTURE;
+		return textures.at(texture).pack();
+	}
+} // namespace
+
 /**
  * Creates a material based of 2 textures and a shininess value
  * @param diffuse The diffuse texture that forms the basic color of each fragment
  * @param specular The specular texture that forms the highlight colors of the fragment
  * @param shininess The shininess of the material
  */
-Material::Material(const Texture2D& diffuse, const Texture2D& specular, float shininess)
-  : mDiffuse{diffuse}, mSpecular{specular} {
-	mShininess = shininess;
-
-	mVariableName = "material";
-	mArrayName    = "materials";
-}
-
-Material::Material(const MaterialArgs& args)
-  : Material(Texture2D(args.diffusePath), Texture2D(args.specularPath), args.shininess) {}
-
-Material::Material(const ColorMaterialArgs& args)
-  : Material(Texture2D(args.diffuse), Texture2D(args.specular), args.shininess) {}
+Material::Material(uint diffuse, uint specular, float shininess)
+  : mDiffuse(diffuse),
+    mSpecular(specular),
+    mDiffuseColor(1.0f),
+    mSpecularColor(1.0f),
+    mShininess(shininess),
+    mTint(1.0f) {}
 
 /**
- * Loads the material in a variable set by the variable name
- * @param shader The shader you want to set the material to
- * @pre shader != nullptr
+ * Creates a material of flat colors, the shaders read them from the material buffer
+ * without sampling a texture
+ * @param diffuse The basic color of each fragment
+ * @param specular The highlight color of each fragment
+ * @param shininess The shininess of the material
  */
-void Material::load(const Shader* shader, uint offset) const {
-	// Setup the shader
-	shader->setInt(mVariableName + ".diffuse", offset);
-	shader->setInt(mVariableName + ".specular", offset + 1);
-	shader->setFloat1(mVariableName + ".shininess", mShininess);
+Material::Material(const glm::vec4& diffuse, const glm::vec4& specular, float shininess)
+  : mDiffuse(cNOTEXTURE),
+    mSpecular(cNOTEXTURE),
+    mDiffuseColor(diffuse),
+    mSpecularColor(specular),
+    mShininess(shininess),
+    mTint(1.0f) {}
 
-	// Load the textures
-	mDiffuse.bind(offset);
-	mSpecular.bind(offset + 1);
+/**
+ * Returns a copy that shares the textures, the tint replaces the tint of this material
+ * @param tint Multiplies the diffuse color, only the rgb is used
+ */
+Material Material::withTint(const glm::vec4& tint) const {
+	Material material = *this;
+	material.mTint    = tint;
+	return material;
 }
 
 /**
- * Loads the material in an array set by the array name
- * @param shader The shader that contains the array
- * @param arrayIndex The index where the materials will be placed
+ * Returns the material as the shaders read it from the material buffer
+ * @param textures The layers of the textures of the material manager
  */
-void Material::loadIntoArray(const Shader* shader, int arrayIndex, uint offset) const {
-	// Setup the shader
-	std::string base = (mArrayName + "[") + std::to_string(arrayIndex) + "]";
-	int baseIndex    = arrayIndex * 2 + offset;
-	shader->setInt(base + ".diffuse", baseIndex);
-	shader->setInt(base + ".specular", baseIndex + 1);
-	shader->setFloat1(base + ".shininess", mShininess);
-
-	// Load the textures
-	mDiffuse.bind(baseIndex);
-	mSpecular.bind(baseIndex + 1);
+MaterialData Material::getData(const std::vector<TextureLayer>& textures) const {
+	return {
+	  mDiffuseColor * mTint, mSpecularColor, packTexture(mDiffuse, textures), packTexture(mSpecular, textures),
+	  mShininess
+	};
 }
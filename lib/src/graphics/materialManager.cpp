@@ -1,41 +1,179 @@
 #include "jaroViewer/graphics/materialManager.hpp"
-#include "jaroViewer/graphics/texture2D.hpp"
+
+#include <glad/glad.h>
+
+#include <cassert>
+#include <mutex>
+#include <thread>
 
 using namespace JaroViewer;
 
-MaterialManager::MaterialManager()
-  : mMaterials(), mTextures(), mLastMaterial(0), mLastShader(nullptr) {}
+namespace {
+	// Binding point of the material storage block
+	const uint cMATERIALBINDING = 11;
+
+	// Texture unit of the first texture array
+	const uint cMATERIALUNIT = 1;
+
+	// Bytes of decoded images uploaded per frame unless the engine sets it
+	const size_t cUPLOADBUDGET = 8 << 20;
+} // namespace
+
+/**
+ * Creates the manager without materials
+ * @param jobs The job system the image files are decoded on
+ */
+MaterialManager::MaterialManager(JobSystem* jobs)
+  : mMaterials(),
+    mTextures(),
+    mTextureArrays(std::make_unique<TextureArrays>(cMATERIALUNIT)),
+    mLoader(std::make_unique<TextureLoader>(jobs, cUPLOADBUDGET)),
+    mTextureLayers(),
+    mPlaceholder(),
+    mBuffer(std::make_unique<StorageBuffer>(cMATERIALBINDING, sizeof(MaterialData))),
+    mFirstMaterial(),
+    mDirty(true),
+    mNumTextures(),
+    mMutex(std::make_unique<std::mutex>()),
+    mGlThread(std::this_thread::get_id()) {}
 
 uint MaterialManager::createNew() {
+	std::lock_guard<std::mutex> lock(*mMutex);
 	mMaterials.push_back(std::vector<Material>());
 	return mMaterials.size();
 }
 
+/**
+ * Adds a texture set to a material, the textures are loaded in the background. Creates gl
+ * objects, so only the thread that created the manager may call it
+ */
 void MaterialManager::addMaterial(uint ident, const MaterialArgs& args) {
+	assert(std::this_thread::get_id() == mGlThread && "Textures are loaded on the gl thread");
 	if (ident == 0) return;
-	if (!mTextures.contains(args.diffusePath))
-		mTextures[args.diffusePath] = std::make_shared<Texture2D>(args.diffusePath);
-	if (!mTextures.contains(args.specularPath))
-		mTextures[args.specularPath] = std::make_shared<Texture2D>(args.specularPath);
-
-	mMaterials.at(ident - 1).push_back(
-	  Material(*mTextures[args.diffusePath], *mTextures[args.specularPath], args.shininess)
-	);
+	uint diffuse  = loadTexture(args.diffusePath);
+	uint specular = loadTexture(args.specularPath);
+	std::lock_guard<std::mutex> lock(*mMutex);
+	mMaterials.at(ident - 1).push_back(Material(diffuse, specular, args.shininess));
+	mDirty = true;
 }
 
 void MaterialManager::addMaterial(uint ident, const ColorMaterialArgs& args) {
 	if (ident == 0) return;
-	mMaterials.at(ident - 1).push_back(Material(args));
+	std::lock_guard<std::mutex> lock(*mMutex);
+	mMaterials.at(ident - 1).push_back(Material(args.diffuse, args.specular, args.shininess));
+	mDirty = true;
+}
+
+/**
+ * Creates a material that shares the textures of another material with a different tint,
+ * objects pick it with RawObject::setMaterial and stay in the draws of their model. Safe to
+ * call from the update function on the simulation thread, the draws see it after the next upload
+ * @param ident The material to copy, all its textures are copied
+ * @param tint Multiplies the diffuse color of the copy
+ * @return The ident of the new material, 0 when the material does not exist
+ */
+uint MaterialManager::createVariant(uint ident, const glm::vec4& tint) {
+	std::lock_guard<std::mutex> lock(*mMutex);
+	if (ident == 0 || ident > mMaterials.size()) return 0;
+	std::vector<Material> variant;
+	for (const Material& material : mMaterials[ident - 1]) variant.push_back(material.withTint(tint));
+	mMaterials.push_back(std::move(variant));
+	mDirty = true;
+	return mMaterials.size();
+}
+
+/**
+ * Uploads the textures that finished decoding within the budget, then writes the materials
+ * into the storage buffer when one was added or got its texture since the last upload
+ * @param ring The buffer of this frame, the pixels and materials are copied from it on the gpu
+ */
+void MaterialManager::upload(FrameRingBuffer& ring) {
+	bool arrived = false;
+	mLoader->update(ring, [this, &arrived](uint index, uint texture) {
+		if (texture == 0) return;
+		mTextureLayers.at(index) = mTextureArrays->add(texture);
+		glDeleteTextures(1, &texture);
+		arrived = true;
+	});
+
+	std::vector<MaterialData> data{
+	  MaterialData{glm::vec4(1.0f), glm::vec4(1.0f), Material::cNOTEXTURE, Material::cNOTEXTURE, 0.0f}
+	};
+	{
+		std::lock_guard<std::mutex> lock(*mMutex);
+		if (!mDirty && !arrived) return;
+		mDirty = false;
+
+		mFirstMaterial.assign(mMaterials.size(), 0);
+		mNumTextures.assign(mMaterials.size(), 0);
+		for (size_t i = 0; i < mMaterials.size(); ++i) {
+			mFirstMaterial[i] = mMaterials[i].empty() ? 0 : data.size();
+			mNumTextures[i]   = mMaterials[i].size();
+			for (const Material& material : mMaterials[i]) data.push_back(material.getData(mTextureLayers));
+		}
+	}
+
+	size_t size = data.size() * sizeof(MaterialData);
+	mBuffer->reserve(size);
+	FrameRingBuffer::Allocation allocation = ring.upload(data.data(), size, ring.getStorageAlignment());
+	mBuffer->copyFromBuffer(allocation.buffer, allocation.offset, 0, size);
+}
+
+/**
+ * Binds the texture arrays, needed after another pass used their units
+ */
+void MaterialManager::bindTextures() const { mTextureArrays->bind(); }
+
+/**
+ * Returns the index of the first texture of a material in the storage buffer, the only
+ * one the built-in shaders sample
+ */
+uint MaterialManager::getIndex(uint ident) const {
+	if (ident == 0 || ident > mFirstMaterial.size()) return 0;
+	return mFirstMaterial.at(ident - 1);
+}
+
+/**
+ * Returns the number of textures of a material as of the last upload
+ */
+uint MaterialManager::getNumTextures(uint ident) const {
+	if (ident == 0 || ident > mNumTextures.size()) return 0;
+	return mNumTextures.at(ident - 1);
 }
 
-void MaterialManager::loadMaterial(Shader* shader, uint material, uint offset) {
-	if (material == 0 || (mLastShader == shader && mLastMaterial == material))
-		return;
-	mLastShader                 = shader;
-	mLastMaterial               = material;
-	std::vector<Material>& mats = mMaterials.at(material - 1);
+/**
+ * Sets the bytes of decoded images that are uploaded per frame, a large budget loads
+ * faster but makes the frames that upload slower
+ */
+void MaterialManager::setUploadBudget(size_t bytes) { mLoader->setBudget(bytes); }
+
+/**
+ * Returns the textures that are still being decoded or uploaded
+ */
+uint MaterialManager::getNumLoading() const { return mLoader->getNumPending(); }
+
+/**
+ * Returns the gpu memory of the textures that are loaded, with the memory they would take uncompressed
+ */
+const std::vector<TextureStats>& MaterialManager::getTextureStats() const { return mLoader->getStats(); }
+
+// Starts with the placeholder, the texture is only kept as a layer of the arrays once it is loaded
+uint MaterialManager::loadTexture(const std::string& path) {
+	auto loaded = mTextures.find(path);
+	if (loaded != mTextures.end()) return loaded->second;
+
+	uint index = mTextureLayers.size();
+	mTextureLayers.push_back(getPlaceholder());
+	mLoader->load(path, true, index);
+	mTextures[path] = index;
+	return index;
+}
 
-	shader->setInt("numTextures", mats.size());
-	for (unsigned int i = 0; i < mats.size(); i++)
-		mats.at(i).loadIntoArray(shader, i, offset);
+// A grey texel shared by all textures that are loading
+TextureLayer MaterialManager::getPlaceholder() {
+	if (mPlaceholder) return *mPlaceholder;
+	uint texture = TextureLoader::createPlaceholder(glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+	mPlaceholder = mTextureArrays->add(texture);
+	glDeleteTextures(1, &texture);
+	return *mPlaceholder;
 }
@@ -1,4 +1,5 @@
 #include "jaroViewer/graphics/texture2D.hpp"
+#include "jaroViewer/graphics/textureCache.hpp"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -6,6 +7,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <optional>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -34,22 +36,16 @@ Texture2D::Texture2D(const std::string& filepath, bool flip) {
 	loadImageToTexture(filepath.c_str(), flip);
 }
 
+/**
+ * Creates a texture of a single texel in a color, a flat color needs no more since every
+ * texture coordinate samples the same texel
+ * @param color The color of the texel
+ */
 Texture2D::Texture2D(const glm::vec4 color) {
 	genTexture();
 	setupParameters();
-
-	GLuint fbo;
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTextureID, 0);
-
-	glViewport(0, 0, 512, 512);
-
-	glClearColor(color.x, color.y, color.z, color.a);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+	glClearTexImage(mTextureID, 0, GL_RGBA, GL_FLOAT, &color.x);
 }
 
 /**
@@ -63,6 +59,14 @@ void Texture2D::bind(unsigned int position) const {
 	glBindTexture(GL_TEXTURE_2D, mTextureID);
 }
 
+/**
+ * Deletes the gl texture, copies of this texture refer to a deleted texture afterwards
+ */
+void Texture2D::destroy() {
+	glDeleteTextures(1, &mTextureID);
+	mTextureID = 0;
+}
+
 unsigned int Texture2D::getID() const { return mTextureID; }
 
 // Private methods
@@ -85,34 +89,25 @@ void Texture2D::setupParameters() {
 }
 
 /**
- * Load the image for the texture
+ * Load the image for the texture, from the texture cache when it is enabled. The storage
+ * is immutable and has every mip level
  * @param filepath The path to the image
  * @param flip If the image needs to be flipped
  */
 void Texture2D::loadImageToTexture(const char* filepath, bool flip) {
-	glBindTexture(GL_TEXTURE_2D, mTextureID);
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(flip);
-	unsigned char* imageData = stbi_load(filepath, &width, &height, &nrChannels, 0);
-
-	if (imageData) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, getFileFormat(nrChannels), GL_UNSIGNED_BYTE, imageData);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	} else {
+	std::string error;
+	std::optional<TextureData> data = TextureCache::read(filepath, flip, &error);
+	if (!data) {
 		std::cout << "[Texture 2D] Error: Unable to load image => " << filepath << std::endl;
-		std::cout << stbi_failure_reason() << std::endl;
+		std::cout << error << std::endl;
+		return;
 	}
-	stbi_image_free(imageData);
-}
 
-uint Texture2D::getFileFormat(int numChannels) const {
-	switch (numChannels) {
-	case 1: return GL_RED;
-	case 3: return GL_RGB;
-	case 4: return GL_RGBA;
-	default:
-		std::cout << "[Texture 2D] Error: Unknown number of channels => "
-		          << numChannels << std::endl;
-		assert(false);
-	}
+	glDeleteTextures(1, &mTextureID);
+	mTextureID = TextureCache::createTexture(*data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < (int)data->data.size(); ++level)
+		data->uploadRows(mTextureID, level, 0, data->getRowCount(level), data->data[level].pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if ((int)data->data.size() < data->levels) glGenerateTextureMipmap(mTextureID);
 }
@@ -0,0 +1,191 @@
+#include "jaroViewer/graphics/textureArrays.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <iostream>
+
+using namespace JaroViewer;
+
+namespace {
+	const uint cINITIALLAYERS = 4;
+
+	// The parameters of the separate textures, so the look does not change
+	uint createArray(uint format, int width, int height, int levels, uint layers) {
+		uint texture;
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		glTextureStorage3D(texture, levels, format, width, height, layers);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	// Blits can not write or read block compressed textures
+	bool isCompressed(uint texture) {
+		int compressed = GL_FALSE;
+		glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		return compressed == GL_TRUE;
+	}
+} // namespace
+
+/**
+ * Creates the pool without any array
+ * @param firstUnit The texture unit of the first array, the others follow it
+ */
+TextureArrays::TextureArrays(uint firstUnit)
+  : mArrays(), mFirstUnit(firstUnit), mReadFramebuffer(0), mDrawFramebuffer(0) {}
+
+TextureArrays::~TextureArrays() {
+	for (const Array& array : mArrays) glDeleteTextures(1, &array.texture);
+	uint framebuffers[2] = {mReadFramebuffer, mDrawFramebuffer};
+	glDeleteFramebuffers(2, framebuffers);
+}
+
+/**
+ * Copies a texture with its mipmaps into a layer of the array of its size, the texture
+ * itself is not needed afterwards
+ * @param texture A GL_TEXTURE_2D, one without storage becomes a black texel like it
+ * sampled before
+ * @return The layer that holds the copy
+ */
+TextureLayer TextureArrays::add(uint texture) {
+	int width = 0, height = 0, format = 0;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+	bool empty = width == 0 || height == 0;
+	if (empty) {
+		width  = 1;
+		height = 1;
+		format = GL_RGB8;
+	}
+
+	bool exact;
+	uint index   = findArray(format, width, height, &exact);
+	Array& array = mArrays.at(index);
+	if (array.layers == array.capacity) grow(array);
+	uint layer = array.layers++;
+
+	if (empty) {
+		const unsigned char black[3] = {0, 0, 0};
+		glClearTexSubImage(array.texture, 0, 0, 0, layer, 1, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, black);
+	} else if (exact) {
+		copyLevels(texture, array, layer);
+	} else if (isCompressed(texture) || isCompressed(array.texture)) {
+		std::cout << "[TextureArrays] Warning: Compressed textures can not be scaled, the layer stays empty"
+		          << std::endl;
+	} else {
+		copyScaled(texture, width, height, array, layer);
+	}
+	return {index, layer};
+}
+
+/**
+ * Binds every array to its unit with one call
+ */
+void TextureArrays::bind() const {
+	uint textures[cMAXARRAYS];
+	for (size_t i = 0; i < mArrays.size(); ++i) textures[i] = mArrays[i].texture;
+	if (!mArrays.empty()) glBindTextures(mFirstUnit, mArrays.size(), textures);
+}
+
+/**
+ * Finds the array of a size or creates it, when all units are taken the array with the
+ * same format and the closest area is used
+ * @param exact Set to false when the texture has to be scaled into the array
+ */
+uint TextureArrays::findArray(uint format, int width, int height, bool* exact) {
+	*exact = true;
+	for (size_t i = 0; i < mArrays.size(); ++i) {
+		const Array& array = mArrays[i];
+		if (array.format == format && array.width == width && array.height == height) return i;
+	}
+
+	if (mArrays.size() < cMAXARRAYS) {
+		int levels = std::bit_width<uint>(std::max(width, height));
+		mArrays.push_back(
+		  {createArray(format, width, height, levels, cINITIALLAYERS), format, width, height, levels, 0,
+		   cINITIALLAYERS}
+		);
+		return mArrays.size() - 1;
+	}
+
+	*exact       = false;
+	uint closest = 0;
+	long best    = -1;
+	for (size_t i = 0; i < mArrays.size(); ++i) {
+		const Array& array = mArrays[i];
+		long distance      = std::labs((long)array.width * array.height - (long)width * height);
+		if (array.format != format) distance += 1l << 40;
+		if (best < 0 || distance < best) {
+			best    = distance;
+			closest = i;
+		}
+	}
+	std::cout << "[TextureArrays] Warning: More than " << cMAXARRAYS << " texture sizes, " << width << "x"
+	          << height << " is scaled to " << mArrays[closest].width << "x" << mArrays[closest].height
+	          << std::endl;
+	return closest;
+}
+
+/**
+ * Doubles the layers of an array, the layers are copied on the gpu
+ */
+void TextureArrays::grow(Array& array) {
+	uint capacity = array.capacity * 2;
+	uint texture  = createArray(array.format, array.width, array.height, array.levels, capacity);
+	for (int level = 0; level < array.levels; ++level)
+		glCopyImageSubData(
+		  array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+		  std::max(1, array.width >> level), std::max(1, array.height >> level), array.layers
+		);
+	glDeleteTextures(1, &array.texture);
+	array.texture  = texture;
+	array.capacity = capacity;
+}
+
+/**
+ * Copies the mip levels of a texture of the same size, the levels it is missing are generated
+ */
+void TextureArrays::copyLevels(uint texture, const Array& array, uint layer) {
+	for (int level = 0; level < array.levels; ++level) {
+		int width = 0, height = 0;
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0) {
+			glGenerateTextureMipmap(array.texture);
+			return;
+		}
+		glCopyImageSubData(
+		  texture, GL_TEXTURE_2D, level, 0, 0, 0, array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width,
+		  height, 1
+		);
+	}
+}
+
+/**
+ * Scales the first level of a texture into a layer with a blit and generates the mipmaps
+ * of the array again
+ */
+void TextureArrays::copyScaled(uint texture, int width, int height, const Array& array, uint layer) {
+	if (mReadFramebuffer == 0) {
+		glCreateFramebuffers(1, &mReadFramebuffer);
+		glCreateFramebuffers(1, &mDrawFramebuffer);
+	}
+	glNamedFramebufferTexture(mReadFramebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+	glNamedFramebufferTextureLayer(mDrawFramebuffer, GL_COLOR_ATTACHMENT0, array.texture, 0, layer);
+
+	// The blit is clipped by the scissor test
+	bool scissor = glIsEnabled(GL_SCISSOR_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glBlitNamedFramebuffer(
+	  mReadFramebuffer, mDrawFramebuffer, 0, 0, width, height, 0, 0, array.width, array.height,
+	  GL_COLOR_BUFFER_BIT, GL_LINEAR
+	);
+	if (scissor) glEnable(GL_SCISSOR_TEST);
+	glGenerateTextureMipmap(array.texture);
+}
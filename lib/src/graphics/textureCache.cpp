@@ -0,0 +1,506 @@
+#include "jaroViewer/graphics/textureCache.hpp"
+#include "jaroViewer/core/mappedFile.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stb_image.h>
+#include <system_error>
+
+using namespace JaroViewer;
+
+namespace {
+	const uint32_t cMAGIC   = 0x5854564a; // "JVTX"
+	const uint32_t cVERSION = 1;
+
+	const int cBC7WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	void hashBytes(uint64_t* hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			*hash ^= bytes[i];
+			*hash *= 0x100000001b3ull;
+		}
+	}
+
+	uint getSizedFormat(int channels) {
+		switch (channels) {
+		case 1: return GL_R8;
+		case 2: return GL_RG8;
+		case 4: return GL_RGBA8;
+		default: return GL_RGB8;
+		}
+	}
+
+	uint getCompressedFormat(int channels) {
+		switch (channels) {
+		case 1: return GL_COMPRESSED_RED_RGTC1;
+		case 2: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	size_t getBlockSize(uint internalFormat) { return internalFormat == GL_COMPRESSED_RED_RGTC1 ? 8 : 16; }
+
+	size_t getLevelSize(uint internalFormat, int width, int height) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(internalFormat);
+	}
+
+	// Writes the bits of a block from the lowest bit up
+	class BitWriter {
+	public:
+		BitWriter(unsigned char* out) : mOut(out), mPosition(0) {}
+
+		void write(uint value, int count) {
+			for (int i = 0; i < count; ++i, ++mPosition)
+				if (value >> i & 1) mOut[mPosition / 8] |= 1 << mPosition % 8;
+		}
+
+	private:
+		unsigned char* mOut;
+		int mPosition;
+	};
+
+	// BC4, the values are spread over 8 steps between the lowest and highest value
+	void encodeBC4(const unsigned char values[16], unsigned char* out) {
+		unsigned char low = 255, high = 0;
+		for (int i = 0; i < 16; ++i) {
+			low  = std::min(low, values[i]);
+			high = std::max(high, values[i]);
+		}
+		std::memset(out, 0, 8);
+		out[0] = high;
+		out[1] = low;
+		if (high == low) return;
+
+		// Index 0 is the high value, 1 the low value and 2 to 7 step from high to low
+		BitWriter bits(out + 2);
+		for (int i = 0; i < 16; ++i) {
+			int step = ((values[i] - low) * 14 + (high - low)) / (2 * (high - low));
+			bits.write(step == 7 ? 0 : step == 0 ? 1 : 8 - step, 3);
+		}
+	}
+
+	/**
+	 * BC7 mode 6, a single line through rgba with 16 steps. The endpoints are the corners
+	 * of the bounding box along the channel with the largest range
+	 */
+	void encodeBC7(const unsigned char pixels[16][4], unsigned char* out) {
+		int low[4] = {255, 255, 255, 255}, high[4] = {0, 0, 0, 0};
+		float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c) {
+				low[c]   = std::min<int>(low[c], pixels[i][c]);
+				high[c]  = std::max<int>(high[c], pixels[i][c]);
+				mean[c] += pixels[i][c] / 16.0f;
+			}
+
+		// Channels that fall while the widest one rises run from high to low
+		int axis = 0;
+		for (int c = 1; c < 4; ++c)
+			if (high[c] - low[c] > high[axis] - low[axis]) axis = c;
+		for (int c = 0; c < 4; ++c) {
+			float covariance = 0.0f;
+			for (int i = 0; i < 16; ++i)
+				covariance += (pixels[i][axis] - mean[axis]) * (pixels[i][c] - mean[c]);
+			if (covariance < 0.0f) std::swap(low[c], high[c]);
+		}
+
+		// 7 bits per channel and a parity bit shared by the channels of an endpoint
+		int quantized[2][4], parity[2];
+		const int* endpoints[2] = {low, high};
+		for (int e = 0; e < 2; ++e) {
+			int bestError = -1;
+			for (int p = 0; p < 2; ++p) {
+				int values[4], error = 0;
+				for (int c = 0; c < 4; ++c) {
+					values[c] = std::clamp((endpoints[e][c] - p + 1) / 2, 0, 127);
+					int delta = ((values[c] << 1) | p) - endpoints[e][c];
+					error    += delta * delta;
+				}
+				if (bestError >= 0 && error >= bestError) continue;
+				bestError = error;
+				parity[e] = p;
+				std::copy(values, values + 4, quantized[e]);
+			}
+		}
+
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c) {
+				int e0 = (quantized[0][c] << 1) | parity[0], e1 = (quantized[1][c] << 1) | parity[1];
+				palette[i][c] = ((64 - cBC7WEIGHTS[i]) * e0 + cBC7WEIGHTS[i] * e1 + 32) >> 6;
+			}
+		int indices[16];
+		for (int i = 0; i < 16; ++i) {
+			int bestError = -1;
+			for (int j = 0; j < 16; ++j) {
+				int error = 0;
+				for (int c = 0; c < 4; ++c) error += (palette[j][c] - pixels[i][c]) * (palette[j][c] - pixels[i][c]);
+				if (bestError >= 0 && error >= bestError) continue;
+				bestError  = error;
+				indices[i] = j;
+			}
+		}
+
+		// The highest bit of the first index is implied zero
+		if (indices[0] >= 8) {
+			std::swap(quantized[0], quantized[1]);
+			std::swap(parity[0], parity[1]);
+			for (int& index : indices) index = 15 - index;
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter bits(out);
+		bits.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c) {
+			bits.write(quantized[0][c], 7);
+			bits.write(quantized[1][c], 7);
+		}
+		bits.write(parity[0], 1);
+		bits.write(parity[1], 1);
+		bits.write(indices[0], 3);
+		for (int i = 1; i < 16; ++i) bits.write(indices[i], 4);
+	}
+
+	// Compresses one level, the blocks at the edges repeat the last row and column
+	void encodeLevel(const unsigned char* pixels, int width, int height, int channels, unsigned char* out) {
+		size_t blockSize = getBlockSize(getCompressedFormat(channels));
+		for (int by = 0; by < height; by += 4)
+			for (int bx = 0; bx < width; bx += 4) {
+				unsigned char block[16][4];
+				for (int i = 0; i < 16; ++i) {
+					int x                      = std::min(bx + i % 4, width - 1);
+					int y                      = std::min(by + i / 4, height - 1);
+					const unsigned char* pixel = pixels + ((size_t)y * width + x) * channels;
+					for (int c = 0; c < 4; ++c) block[i][c] = c < channels ? pixel[c] : (c == 3 ? 255 : 0);
+				}
+
+				if (channels <= 2) {
+					for (int c = 0; c < channels; ++c) {
+						unsigned char values[16];
+						for (int i = 0; i < 16; ++i) values[i] = block[i][c];
+						encodeBC4(values, out + c * 8);
+					}
+				} else {
+					encodeBC7(block, out);
+				}
+				out += blockSize;
+			}
+	}
+
+	// Averages every 2x2 texels, an odd row or column is repeated
+	std::vector<unsigned char> downsample(const unsigned char* pixels, int width, int height, int channels) {
+		int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+		std::vector<unsigned char> next((size_t)nextWidth * nextHeight * channels);
+		for (int y = 0; y < nextHeight; ++y)
+			for (int x = 0; x < nextWidth; ++x) {
+				int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+				int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+				for (int c = 0; c < channels; ++c) {
+					int sum = pixels[((size_t)y0 * width + x0) * channels + c] +
+					  pixels[((size_t)y0 * width + x1) * channels + c] +
+					  pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+					next[((size_t)y * nextWidth + x) * channels + c] = (sum + 2) / 4;
+				}
+			}
+		return next;
+	}
+} // namespace
+
+bool TextureData::isCompressed() const { return pixelFormat == 0; }
+
+/**
+ * Returns the rows of a level as they are uploaded, a row of blocks covers 4 rows of texels
+ */
+int TextureData::getRowCount(int level) const {
+	int height = data.at(level).height;
+	return isCompressed() ? (height + 3) / 4 : height;
+}
+
+size_t TextureData::getRowSize(int level) const { return data.at(level).size / getRowCount(level); }
+
+/**
+ * Uploads rows of a level, the unpack alignment must be 1
+ * @param pixels The first row in memory, or the offset in the bound pixel unpack buffer
+ */
+void TextureData::uploadRows(uint texture, int level, int row, int rows, const void* pixels) const {
+	const TextureLevel& target = data.at(level);
+	int rowHeight              = isCompressed() ? 4 : 1;
+	int y                      = row * rowHeight;
+	int height                 = std::min(rows * rowHeight, target.height - y);
+	if (isCompressed())
+		glCompressedTextureSubImage2D(
+		  texture, level, 0, y, target.width, height, internalFormat, rows * getRowSize(level), pixels
+		);
+	else
+		glTextureSubImage2D(texture, level, 0, y, target.width, height, pixelFormat, GL_UNSIGNED_BYTE, pixels);
+}
+
+/**
+ * Returns the bytes of all levels on the gpu, levels that are generated on the gpu included
+ */
+size_t TextureData::getMemory() const {
+	size_t size = 0;
+	int width = data.at(0).width, height = data.at(0).height;
+	for (int level = 0; level < levels; ++level) {
+		size  += isCompressed() ? getLevelSize(internalFormat, width, height) : (size_t)width * height * channels;
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return size;
+}
+
+/**
+ * Returns the bytes all levels take with the uncompressed format of the channels
+ */
+size_t TextureData::getUncompressedMemory() const {
+	size_t size = 0;
+	int width = data.at(0).width, height = data.at(0).height;
+	for (int level = 0; level < levels; ++level) {
+		size   += (size_t)width * height * channels;
+		width   = std::max(1, width / 2);
+		height  = std::max(1, height / 2);
+	}
+	return size;
+}
+
+/**
+ * Enables the cache
+ * @param directory The directory of the cache files, created when missing. Empty disables the cache
+ */
+void TextureCache::setDirectory(const std::string& directory) {
+	State& state    = getState();
+	state.directory = directory;
+	if (directory == "") return;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		std::cout << "[TextureCache] Warning: Could not create " << directory << " (" << error.message()
+		          << "), textures are uploaded uncompressed" << std::endl;
+		state.directory = "";
+	}
+}
+
+bool TextureCache::isEnabled() { return getState().directory != ""; }
+
+/**
+ * Reads an image with all its levels from the cache, it is built and stored when it is
+ * missing. Can be called from any thread
+ * @param path The path to the image
+ * @param flip If the image needs to be flipped for the texture
+ * @param error Set to the reason when the image can not be read
+ * @return The compressed levels, or only the uncompressed first level without the cache
+ */
+std::optional<TextureData> TextureCache::read(const std::string& path, bool flip, std::string* error) {
+	if (!isEnabled()) return decode(path, flip, error);
+	std::optional<uint64_t> key = getKey(path, flip);
+	if (!key) {
+		*error = "File not found";
+		return std::nullopt;
+	}
+	if (std::optional<TextureData> data = load(path, *key)) {
+		getState().loaded++;
+		return data;
+	}
+	return build(path, *key, flip, error);
+}
+
+/**
+ * Allocates the immutable storage of a texture with all its levels, no pixels are uploaded
+ */
+uint TextureCache::createTexture(const TextureData& data) {
+	uint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, data.levels, data.internalFormat, data.data.at(0).width, data.data.at(0).height);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
+
+// The format of uncompressed pixels with a number of channels
+uint TextureCache::getPixelFormat(int channels) {
+	switch (channels) {
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 4: return GL_RGBA;
+	default: return GL_RGB;
+	}
+}
+
+/**
+ * Returns the textures read from the cache and the textures built since the start
+ */
+TextureCache::Stats TextureCache::getStats() {
+	const State& state = getState();
+	return {state.loaded.load(), state.built.load()};
+}
+
+/**
+ * Maps a cache file, the levels point into the mapping
+ * @return Nothing when the file is missing or does not match the image
+ */
+std::optional<TextureData> TextureCache::load(const std::string& path, uint64_t key) {
+	auto file = std::make_shared<const MappedFile>(getPath(key));
+	if (!file->isOpen()) return std::nullopt;
+	std::string_view view = file->getView();
+
+	Header header;
+	if (view.size() < sizeof(Header)) return std::nullopt;
+	std::memcpy(&header, view.data(), sizeof(Header));
+	if (header.magic != cMAGIC || header.version != cVERSION || header.key != key || header.levels == 0 ||
+	    header.internalFormat != getCompressedFormat(header.channels))
+		return std::nullopt;
+
+	TextureData data{header.internalFormat, 0, (int)header.channels, (int)header.levels, {}, file};
+	const unsigned char* pixels = reinterpret_cast<const unsigned char*>(view.data()) + sizeof(Header);
+	size_t offset               = sizeof(Header);
+	int width = header.width, height = header.height;
+	for (uint level = 0; level < header.levels; ++level) {
+		size_t size = getLevelSize(header.internalFormat, width, height);
+		if (offset + size > view.size()) {
+			std::cout << "[TextureCache] Warning: The cache file of " << path << " is cut off, it is built again"
+			          << std::endl;
+			return std::nullopt;
+		}
+		data.data.push_back({width, height, pixels, size});
+		pixels += size;
+		offset += size;
+		width   = std::max(1, width / 2);
+		height  = std::max(1, height / 2);
+	}
+	return data;
+}
+
+/**
+ * Decodes an image, compresses all its levels and writes the cache file
+ */
+std::optional<TextureData>
+  TextureCache::build(const std::string& path, uint64_t key, bool flip, std::string* error) {
+	std::optional<TextureData> image = decode(path, flip, error);
+	if (!image) return std::nullopt;
+	const TextureLevel& source = image->data.at(0);
+
+	Header header{
+	  cMAGIC,
+	  cVERSION,
+	  key,
+	  getCompressedFormat(image->channels),
+	  (uint32_t)image->channels,
+	  (uint32_t)source.width,
+	  (uint32_t)source.height,
+	  (uint32_t)image->levels,
+	  0
+	};
+	size_t size = 0;
+	int width = source.width, height = source.height;
+	for (int level = 0; level < image->levels; ++level) {
+		size   += getLevelSize(header.internalFormat, width, height);
+		width   = std::max(1, width / 2);
+		height  = std::max(1, height / 2);
+	}
+
+	auto blocks = std::make_shared<std::vector<unsigned char>>(size);
+	TextureData data{header.internalFormat, 0, image->channels, image->levels, {}, blocks};
+	std::vector<unsigned char> mip;
+	const unsigned char* pixels = source.pixels;
+	unsigned char* out          = blocks->data();
+	width                       = source.width;
+	height                      = source.height;
+	for (int level = 0; level < image->levels; ++level) {
+		size_t levelSize = getLevelSize(header.internalFormat, width, height);
+		encodeLevel(pixels, width, height, image->channels, out);
+		data.data.push_back({width, height, out, levelSize});
+		out += levelSize;
+		if (level + 1 == image->levels) break;
+
+		mip    = downsample(pixels, width, height, image->channels);
+		pixels = mip.data();
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	getState().built++;
+
+	// Written next to the cache file and renamed, so another reader never maps a partial file
+	std::string cachePath = getPath(key);
+	std::string writePath = cachePath + ".tmp";
+	{
+		std::ofstream file(writePath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(reinterpret_cast<const char*>(blocks->data()), blocks->size());
+		if (!file) {
+			std::cout << "[TextureCache] Warning: Could not write " << writePath << std::endl;
+			return data;
+		}
+	}
+	std::error_code renameError;
+	std::filesystem::rename(writePath, cachePath, renameError);
+	if (renameError) std::remove(writePath.c_str());
+	return data;
+}
+
+/**
+ * Decodes an image into its first level with the sized format of its channels, the flip
+ * is only set for this thread
+ */
+std::optional<TextureData> TextureCache::decode(const std::string& path, bool flip, std::string* error) {
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(flip);
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	if (!pixels) {
+		*error = stbi_failure_reason();
+		return std::nullopt;
+	}
+	std::shared_ptr<const void> storage(pixels, [](const void* data) {
+		stbi_image_free(const_cast<void*>(data));
+	});
+	return TextureData{
+	  getSizedFormat(channels),
+	  getPixelFormat(channels),
+	  channels,
+	  (int)std::bit_width<uint>(std::max(width, height)),
+	  {{width, height, pixels, (size_t)width * height * channels}},
+	  storage
+	};
+}
+
+/**
+ * Hashes the canonical path, the modification time, the size and the flip with FNV-1a,
+ * so a changed image is built again
+ */
+std::optional<uint64_t> TextureCache::getKey(const std::string& path, bool flip) {
+	std::error_code error;
+	std::string canonical = std::filesystem::weakly_canonical(path, error).string();
+	if (error) canonical = path;
+	auto time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error) return std::nullopt;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error) return std::nullopt;
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hashBytes(&hash, canonical.data(), canonical.size());
+	hashBytes(&hash, &time, sizeof(time));
+	hashBytes(&hash, &size, sizeof(size));
+	hashBytes(&hash, &flip, sizeof(flip));
+	return hash;
+}
+
+std::string TextureCache::getPath(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(getState().directory) / name).string();
+}
+
+TextureCache::State& TextureCache::getState() {
+	static State instance{"", 0, 0};
+	return instance;
+}
@@ -0,0 +1,124 @@
+#include "jaroViewer/graphics/textureLoader.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the loader
+ * @param jobs The job system the images are decoded on
+ * @param budget The bytes that are uploaded per frame at most, one row is always uploaded
+ */
+TextureLoader::TextureLoader(JobSystem* jobs, size_t budget)
+  : mJobs(jobs), mBudget(budget), mPending(0), mDecoding(0), mDecoded(), mUploads(), mStats() {}
+
+TextureLoader::~TextureLoader() {
+	mJobs->waitFor(mDecoding);
+	for (Upload& upload : mUploads) glDeleteTextures(1, &upload.texture);
+}
+
+/**
+ * Queues an image to be read as a background job, so a thread that waits on the frame
+ * jobs never runs it. A missing cache file is built there
+ * @param path The path to the image
+ * @param flip If the image needs to be flipped for the texture
+ * @param request Passed to the callback of update, so the caller knows which texture arrived
+ */
+void TextureLoader::load(const std::string& path, bool flip, uint request) {
+	mPending++;
+	mDecoding++;
+	auto image = std::make_unique<Image>(Image{path, flip, request, std::nullopt, ""});
+	mJobs->submitBackground([this, image = image.release()]() {
+		image->data = TextureCache::read(image->path, image->flip, &image->error);
+		mDecoded.push(std::unique_ptr<Image>(image));
+		mDecoding--;
+	});
+}
+
+/**
+ * Uploads the decoded images within the budget of this frame, must be called once per
+ * frame on the gl thread
+ * @param ring The buffer of this frame, the rows are staged in it
+ * @param callback Gets every texture that is complete
+ */
+void TextureLoader::update(FrameRingBuffer& ring, const Callback& callback) {
+	std::unique_ptr<Image> image;
+	while (mDecoded.pop(&image)) startUpload(std::move(image), callback);
+	if (mUploads.empty()) return;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	size_t left = mBudget;
+	while (!mUploads.empty() && left > 0) {
+		Upload& upload          = mUploads.front();
+		const TextureData& data = *upload.image->data;
+		size_t rowSize          = data.getRowSize(upload.level);
+		int rowCount            = data.getRowCount(upload.level);
+		int rows                = std::clamp<size_t>(left / rowSize, 1, rowCount - upload.row);
+		size_t size             = rows * rowSize;
+
+		const unsigned char* pixels         = data.data[upload.level].pixels + upload.row * rowSize;
+		FrameRingBuffer::Allocation staging = ring.upload(pixels, size, 16);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		data.uploadRows(upload.texture, upload.level, upload.row, rows, reinterpret_cast<const void*>(staging.offset));
+		upload.row += rows;
+		left       -= std::min(left, size);
+		if (upload.row < rowCount) continue;
+		upload.row = 0;
+		if (++upload.level < (int)data.data.size()) continue;
+
+		// Without the cache only the first level is read
+		if ((int)data.data.size() < data.levels) glGenerateTextureMipmap(upload.texture);
+		mStats.push_back(
+		  {upload.image->path, data.data[0].width, data.data[0].height, data.isCompressed(), data.getMemory(),
+		   data.getUncompressedMemory()}
+		);
+		callback(upload.image->request, upload.texture);
+		mPending--;
+		mUploads.pop_front();
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureLoader::setBudget(size_t bytes) { mBudget = std::max<size_t>(bytes, 1); }
+
+/**
+ * Returns the images that were loaded but not handed to a callback yet
+ */
+uint TextureLoader::getNumPending() const { return mPending; }
+
+/**
+ * Returns the memory of every texture that was uploaded, in the order they completed
+ */
+const std::vector<TextureStats>& TextureLoader::getStats() const { return mStats; }
+
+/**
+ * Creates a texture of a single texel, shown in place of an image until it is loaded
+ */
+uint TextureLoader::createPlaceholder(const glm::vec4& color) {
+	uint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_RGB8, 1, 1);
+	glClearTexImage(texture, 0, GL_RGBA, GL_FLOAT, &color.x);
+	return texture;
+}
+
+/**
+ * Allocates the texture of a read image with all its levels, images that could not be
+ * read go to the callback right away
+ */
+void TextureLoader::startUpload(std::unique_ptr<Image> image, const Callback& callback) {
+	if (!image->data) {
+		std::cout << "[Texture Loader] Error: Unable to load image => " << image->path << std::endl;
+		std::cout << image->error << std::endl;
+		callback(image->request, 0);
+		mPending--;
+		return;
+	}
+
+	uint texture = TextureCache::createTexture(*image->data);
+	mUploads.push_back({std::move(image), texture, 0, 0});
+}
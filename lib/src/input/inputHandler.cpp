@@ -6,19 +6,33 @@
 
 using namespace JaroViewer;
 
-InputHandler::InputHandler(Window* window) : mWindow{window} {
+InputHandler::InputHandler(Window* window)
+  : mWindow{window}, mCursorX{0}, mCursorY{0}, mCursorInScreen{false} {
 	addMouseCallback();
 }
 
+InputHandler::InputHandler(InputHandler&& other) noexcept
+  : mWindow{other.mWindow},
+    mKeys{std::move(other.mKeys)},
+    mMouseMoveEvents{std::move(other.mMouseMoveEvents)},
+    mCursorMoves{std::move(other.mCursorMoves)},
+    mProcessedMoves{std::move(other.mProcessedMoves)},
+    mCursorX{other.mCursorX},
+    mCursorY{other.mCursorY},
+    mCursorInScreen{other.mCursorInScreen} {}
+
 Window* InputHandler::getWindow() const { return mWindow; }
 
 void InputHandler::addKey(int key, KeyAction action, std::function<void(InputParams)> func) {
-	mKeys.insert({key, KeyState{func, glfwGetKey(mWindow->cPtr(), key) == GLFW_PRESS, action, true}});
+	mKeys.insert(
+	  {key, KeyState{func, glfwGetKey(mWindow->cPtr(), key) == GLFW_PRESS, action, true, false, false}}
+	);
 }
 
 void InputHandler::addMouseKey(int key, KeyAction action, std::function<void(InputParams)> func) {
 	mKeys.insert(
-	  {key, KeyState{func, glfwGetMouseButton(mWindow->cPtr(), key) == GLFW_PRESS, action, false}}
+	  {key,
+	   KeyState{func, glfwGetMouseButton(mWindow->cPtr(), key) == GLFW_PRESS, action, false, false, false}}
 	);
 }
 
@@ -26,40 +40,68 @@ void InputHandler::addMouseMoveEvent(std::function<void(GLFWwindow*, double, dou
 	mMouseMoveEvents.push_back(func);
 }
 
+/**
+ * Samples the keys and the cursor, presses and releases are remembered until
+ * the inputs are processed so a slower processing thread doesn't miss them
+ */
+void InputHandler::pollInputs() {
+	double xpos, ypos;
+	glfwGetCursorPos(mWindow->cPtr(), &xpos, &ypos);
+
+	std::lock_guard<std::mutex> lock(mPollMutex);
+	mCursorX        = xpos;
+	mCursorY        = ypos;
+	mCursorInScreen = mWindow->insideScreen(mCursorX, mCursorY);
+	for (auto keyIter = mKeys.begin(); keyIter != mKeys.end(); keyIter++) {
+		KeyState& state = keyIter->second;
+		bool pressed    = (state.isKey) ?
+		     glfwGetKey(mWindow->cPtr(), keyIter->first) == GLFW_PRESS :
+		     glfwGetMouseButton(mWindow->cPtr(), keyIter->first) == GLFW_PRESS;
+		state.wasPressed |= pressed && !state.isPressed;
+		state.wasReleased |= !pressed && state.isPressed;
+		state.isPressed = pressed;
+	}
+}
+
+/**
+ * Calls the functions of the keys and cursor moves with the last polled state
+ * @param deltaTime The time since the inputs were last processed
+ */
 void InputHandler::processInputs(float deltaTime) {
+	std::unique_lock<std::mutex> lock(mPollMutex);
+	std::swap(mCursorMoves, mProcessedMoves);
+	InputParams params{deltaTime, mCursorInScreen, mCursorX, mCursorY};
+
+	std::vector<const KeyState*> triggered;
 	for (auto keyIter = mKeys.begin(); keyIter != mKeys.end(); keyIter++) {
-		KeyState state = keyIter->second;
-		bool pressed   = (state.isKey) ?
-		    glfwGetKey(mWindow->cPtr(), keyIter->first) == GLFW_PRESS :
-		    glfwGetMouseButton(mWindow->cPtr(), keyIter->first) == GLFW_PRESS;
-		double xpos, ypos;
-		glfwGetCursorPos(mWindow->cPtr(), &xpos, &ypos);
-		InputParams params{deltaTime, false, (int)xpos, (int)ypos};
-		params.mouseInScreen = mWindow->insideScreen(params.mouseX, params.mouseY);
+		KeyState& state = keyIter->second;
+		bool trigger    = false;
 		switch (state.action) {
-		case KeyAction::DOWN:
-			if (pressed) state.function(params);
-			break;
-		case KeyAction::UP:
-			if (!pressed) state.function(params);
-			break;
-		case KeyAction::PRESS:
-			if (pressed && !state.isPressed) state.function(params);
-			break;
-		case KeyAction::RELEASE:
-			if (!pressed && state.isPressed) state.function(params);
-			break;
+		case KeyAction::DOWN: trigger = state.isPressed || state.wasPressed; break;
+		case KeyAction::UP: trigger = !state.isPressed || state.wasReleased; break;
+		case KeyAction::PRESS: trigger = state.wasPressed; break;
+		case KeyAction::RELEASE: trigger = state.wasReleased; break;
 		}
-		keyIter->second.isPressed = pressed;
+		state.wasPressed  = false;
+		state.wasReleased = false;
+		if (trigger) triggered.push_back(&state);
 	}
+	lock.unlock();
+
+	// The callbacks run without the lock, so polling is never blocked by them
+	for (const CursorMove& move : mProcessedMoves)
+		for (auto& event : mMouseMoveEvents) event(mWindow->cPtr(), move.x, move.y);
+	mProcessedMoves.clear();
+	for (const KeyState* key : triggered) key->function(params);
 }
 
 void InputHandler::addMouseCallback() {
 	glfwSetWindowUserPointer(mWindow->cPtr(), this);
-	glfwSetInputMode(mWindow->cPtr(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	mWindow->setMouseMode(GLFW_CURSOR_DISABLED);
 	glfwSetCursorPosCallback(mWindow->cPtr(), [](GLFWwindow* window, double xpos, double ypos) {
+		// Queued so the move events run on the thread that processes the inputs
 		InputHandler* handler = static_cast<InputHandler*>(glfwGetWindowUserPointer(window));
-		for (size_t i = 0; i < handler->mMouseMoveEvents.size(); ++i)
-			handler->mMouseMoveEvents.at(i)(window, xpos, ypos);
+		std::lock_guard<std::mutex> lock(handler->mPollMutex);
+		handler->mCursorMoves.push_back({xpos, ypos});
 	});
 }
@@ -10,13 +10,28 @@ using namespace JaroViewer;
  * @param specular The specular color of the light
  */
 DirectionalLight::DirectionalLight(glm::vec3 direction, Tools::LightColor lightColor)
-  : mDirection{direction}, mLightColor{lightColor}, mEnable{true} {}
+  : mDirection{direction},
+    mLightColor{lightColor},
+    mEnable{true},
+    mCastShadows{false},
+    mDirty{true} {}
 
 /**
  * Enables or disables the light
  * @param enable New enable state of the light
  */
-void DirectionalLight::enable(bool enable) { mEnable = enable; }
+void DirectionalLight::enable(bool enable) {
+	mEnable = enable;
+	mDirty  = true;
+}
+
+/**
+ * Enables or disables the cascaded shadow map of the light
+ */
+void DirectionalLight::setCastShadows(bool castShadows) {
+	mCastShadows = castShadows;
+	mDirty       = true;
+}
 
 /**
  * Returns a struct with all data
@@ -24,7 +39,13 @@ void DirectionalLight::enable(bool enable) { mEnable = enable; }
  */
 DirectionalLight::DirectionalLightStruct DirectionalLight::getStruct() const {
 	return DirectionalLightStruct{mDirection,           mEnable,
-	                              mLightColor.ambient,  0,
+	                              mLightColor.ambient,  mCastShadows,
 	                              mLightColor.diffuse,  0,
 	                              mLightColor.specular, 0};
 }
+
+/**
+ * Returns if the light changed since it was last marked clean
+ */
+bool DirectionalLight::isDirty() const { return mDirty; }
+void DirectionalLight::setClean() { mDirty = false; }
@@ -0,0 +1,166 @@
+#include "jaroViewer/lighting/lightClusters.hpp"
+#include "jaroViewer/geometry/frustum.hpp"
+#include "jaroViewer/rendering/basicShaders.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace JaroViewer;
+
+namespace {
+	const uint cGROUPSIZE = 64;
+
+	// Binding point of the indices of the lights that are culled this frame
+	const uint cACTIVEBINDING = 8;
+
+	/**
+	 * How much a light can add to what the camera sees, its brightest channel with the
+	 * attenuation of the distance to the camera
+	 */
+	template <typename Light>
+	float getRelevance(const Light& light, float distance) {
+		glm::vec3 color = light.ambient + light.diffuse + light.specular;
+		float peak      = std::max(std::max(color.x, color.y), color.z);
+		return peak / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+	}
+} // namespace
+
+/**
+ * Creates the light buffers and the culling pass
+ * @param grid The amount of clusters on the x and y axis of the screen and in depth
+ * @param maxLightsPerCluster The least relevant lights past this amount are not shaded in a cluster
+ * @param maxActiveLights The most relevant lights in view that are culled each frame, 0 culls all
+ */
+LightClusters::LightClusters(const glm::uvec3& grid, uint maxLightsPerCluster, uint maxActiveLights)
+  : mGrid(grid),
+    mMaxLights(maxLightsPerCluster),
+    mMaxActiveLights(maxActiveLights),
+    mCulling(ComputeCode{lightCullingCompute}),
+    mHeader(1, sizeof(LightSet::LightSetStruct), GL_DYNAMIC_DRAW),
+    mPointLights(2, 64 * sizeof(PointLight::PointLightStruct)),
+    mSpotlights(3, 16 * sizeof(Spotlight::SpotlightStruct)),
+    mClusterLights(4, grid.x * grid.y * grid.z * (maxLightsPerCluster + 1) * sizeof(uint)),
+    mUploadedVersion(0),
+    mScores(),
+    mActiveLights() {}
+
+/**
+ * Uploads the lights that changed since the last upload, the changes are staged
+ * in the ring and copied into the light buffers on the gpu
+ * @param image The newest lights
+ */
+void LightClusters::upload(const LightSet::Image& image, FrameRingBuffer& ring) {
+	if (image.version == mUploadedVersion) return;
+
+	if (image.headerVersion > mUploadedVersion) {
+		FrameRingBuffer::Allocation staged =
+		  ring.upload(&image.header, sizeof(LightSet::LightSetStruct), 16);
+		mHeader.copyFromBuffer(staged.buffer, staged.offset, 0, sizeof(LightSet::LightSetStruct));
+	}
+	uploadArray(
+	  mPointLights, image.pointLights->data(), *image.pointLightVersions,
+	  sizeof(PointLight::PointLightStruct), ring
+	);
+	uploadArray(
+	  mSpotlights, image.spotlights->data(), *image.spotlightVersions,
+	  sizeof(Spotlight::SpotlightStruct), ring
+	);
+	mUploadedVersion = image.version;
+}
+
+/**
+ * Assigns the lights to the clusters of this frame, must run before the lit draws
+ * @param image The lights that were uploaded last
+ * @param size The size of the render target in pixels
+ */
+void LightClusters::build(
+  const LightSet::Image& image,
+  const glm::mat4& view,
+  const glm::mat4& projection,
+  Size size,
+  float nearPlane,
+  float farPlane,
+  FrameRingBuffer& ring
+) {
+	ClusterStruct clusters{
+	  glm::inverse(projection), view, glm::uvec4(mGrid, mMaxLights),
+	  glm::vec4(size.width, size.height, nearPlane, farPlane)
+	};
+	ring.bindUniform(5, &clusters, sizeof(ClusterStruct));
+	selectLights(image, view, projection, ring);
+
+	uint numClusters = mGrid.x * mGrid.y * mGrid.z;
+	mCulling.use();
+	glDispatchCompute((numClusters + cGROUPSIZE - 1) / cGROUPSIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/**
+ * Returns the amount of lights the culling pass used in the last frame
+ */
+uint LightClusters::getNumActiveLights() const {
+	return mActiveLights.empty() ? 0 : mActiveLights.size() - 1;
+}
+
+/**
+ * Ranks the point lights and spotlights whose range reaches the view frustum and binds
+ * their indices, most relevant first. Spotlights follow the point lights in the indices
+ */
+void LightClusters::selectLights(
+  const LightSet::Image& image,
+  const glm::mat4& view,
+  const glm::mat4& projection,
+  FrameRingBuffer& ring
+) {
+	Frustum frustum{projection * view};
+	glm::vec3 viewPos = glm::vec3(glm::inverse(view)[3]);
+	auto score = [&](const auto& light, uint index) {
+		if (light.enable == 0) return;
+		float range = LightSet::getLightRange(light);
+		if (range <= 0.0f || !frustum.intersects(light.position, range)) return;
+		mScores.push_back({getRelevance(light, glm::distance(viewPos, light.position)), index});
+	};
+
+	mScores.clear();
+	const std::vector<PointLight::PointLightStruct>& pointLights = *image.pointLights;
+	const std::vector<Spotlight::SpotlightStruct>& spotlights    = *image.spotlights;
+	uint numPointLights = pointLights.size();
+	for (uint i = 0; i < numPointLights; ++i) score(pointLights[i], i);
+	for (uint i = 0; i < spotlights.size(); ++i) score(spotlights[i], numPointLights + i);
+
+	size_t count = mScores.size();
+	if (mMaxActiveLights > 0) count = std::min<size_t>(count, mMaxActiveLights);
+	std::partial_sort(mScores.begin(), mScores.begin() + count, mScores.end(), std::greater<>());
+
+	mActiveLights.resize(count + 1);
+	mActiveLights[0] = count;
+	for (size_t i = 0; i < count; ++i) mActiveLights[i + 1] = mScores[i].second;
+	ring.bindStorage(cACTIVEBINDING, mActiveLights.data(), mActiveLights.size() * sizeof(uint));
+}
+
+/**
+ * Copies the changed lights of one array, everything is copied again when the buffer grows
+ * @param stride The size of one light in bytes
+ */
+void LightClusters::uploadArray(
+  StorageBuffer& buffer,
+  const void* data,
+  const std::vector<uint>& versions,
+  size_t stride,
+  FrameRingBuffer& ring
+) {
+	if (versions.empty()) return;
+	bool grown        = buffer.reserve(versions.size() * stride);
+	uint since        = grown ? 0 : mUploadedVersion;
+	const char* bytes = static_cast<const char*>(data);
+
+	std::vector<std::pair<size_t, size_t>> ranges;
+	LightSet::getChangedRanges(versions, stride, since, &ranges);
+	for (auto [offset, size] : ranges) {
+		FrameRingBuffer::Allocation staged = ring.upload(bytes + offset, size, 16);
+		buffer.copyFromBuffer(staged.buffer, staged.offset, offset, size);
+	}
+}
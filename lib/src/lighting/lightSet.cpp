@@ -5,16 +5,57 @@
 
 using namespace JaroViewer;
 
+namespace {
+	// Writes the changed lights of one array into a copy of it, the arrays of the previous
+	// image are left alone for the snapshots that still hold them
+	template <typename Light, typename Struct>
+	void writeLights(
+	  const std::vector<std::shared_ptr<Light>>& lights,
+	  std::vector<size_t>& changed,
+	  unsigned int version,
+	  unsigned int& shadowCasters,
+	  std::shared_ptr<const std::vector<Struct>>& structs,
+	  std::shared_ptr<const std::vector<unsigned int>>& versions
+	) {
+		if (changed.empty()) return;
+		auto newStructs  = std::make_shared<std::vector<Struct>>(*structs);
+		auto newVersions = std::make_shared<std::vector<unsigned int>>(*versions);
+		newStructs->resize(lights.size(), Struct{});
+		newVersions->resize(lights.size(), 0);
+
+		for (size_t index : changed) {
+			Struct light = lights.at(index)->getStruct();
+			shadowCasters += (light.castShadows != 0) - (newStructs->at(index).castShadows != 0);
+			newStructs->at(index) = light;
+			lights.at(index)->setClean();
+			newVersions->at(index) = version;
+		}
+		changed.clear();
+		structs  = std::move(newStructs);
+		versions = std::move(newVersions);
+	}
+} // namespace
+
 /**
  * Creates a lightset
  */
 LightSet::LightSet()
   : mDirectionalLights{std::array<std::shared_ptr<DirectionalLight>, mMAXNUMDIRLIGHTS>()},
-    mPointLights{std::array<std::shared_ptr<PointLight>, mMAXNUMPOINTLIGHTS>()},
-    mSpotlights{std::array<std::shared_ptr<Spotlight>, mMAXNUMSPOTLIGHTS>()},
+    mPointLights{},
+    mSpotlights{},
     mNumDirLights{0},
-    mNumPointLights{0},
-    mNumSpotlights{0} {}
+    mChanged{std::make_shared<ChangedLights>()},
+    mPointShadowCasters{0},
+    mSpotShadowCasters{0},
+    mImage{},
+    mCountsChanged{true} {
+	Image image{};
+	image.pointLights        = std::make_shared<const std::vector<PointLight::PointLightStruct>>();
+	image.spotlights         = std::make_shared<const std::vector<Spotlight::SpotlightStruct>>();
+	image.pointLightVersions = std::make_shared<const std::vector<unsigned int>>();
+	image.spotlightVersions  = std::make_shared<const std::vector<unsigned int>>();
+	mImage                   = std::make_shared<const Image>(std::move(image));
+}
 
 void LightSet::addDirLight(std::shared_ptr<DirectionalLight> dirLight) {
 	if ((uint)mNumDirLights >= mMAXNUMDIRLIGHTS) {
@@ -24,40 +65,101 @@ void LightSet::addDirLight(std::shared_ptr<DirectionalLight> dirLight) {
 		return;
 	}
 	mDirectionalLights[mNumDirLights++] = dirLight;
+	mCountsChanged                      = true;
 }
 
+/**
+ * Adds a point light, the set listens to its changes from now on
+ */
 void LightSet::addPointLight(std::shared_ptr<PointLight> pointLight) {
-	if ((uint)mNumPointLights >= mMAXNUMPOINTLIGHTS) {
-		std::cout << "[Light Set] Warning: Pointlight light not added because "
-		             "array was full!"
-		          << std::endl;
-		return;
-	}
-	mPointLights[mNumPointLights++] = pointLight;
+	size_t index = mPointLights.size();
+	pointLight->setChangeListener([changed = mChanged, index]() { changed->pointLights.push_back(index); });
+	mChanged->pointLights.push_back(index);
+	mPointLights.push_back(std::move(pointLight));
+	mCountsChanged = true;
 }
 
+/**
+ * Adds a spotlight, the set listens to its changes from now on
+ */
 void LightSet::addSpotlight(std::shared_ptr<Spotlight> spotlight) {
-	if ((uint)mNumSpotlights >= mMAXNUMSPOTLIGHTS) {
-		std::cout << "[Light Set] Warning: Spotlight not added because "
-		             "array was full!"
-		          << std::endl;
+	size_t index = mSpotlights.size();
+	spotlight->setChangeListener([changed = mChanged, index]() { changed->spotlights.push_back(index); });
+	mChanged->spotlights.push_back(index);
+	mSpotlights.push_back(std::move(spotlight));
+	mCountsChanged = true;
+}
+
+/**
+ * Makes a new image when lights changed, only the lights that reported a change are
+ * rewritten and get the new version. An array without changes is shared with the last image
+ */
+void LightSet::update() {
+	bool dirLightsChanged = false;
+	for (int i = 0; i < mNumDirLights; i++) dirLightsChanged |= mDirectionalLights.at(i)->isDirty();
+	if (!mCountsChanged && !dirLightsChanged && mChanged->pointLights.empty() &&
+	    mChanged->spotlights.empty())
 		return;
+
+	Image image       = *mImage;
+	unsigned int next = image.version + 1;
+	image.version     = next;
+
+	for (int i = 0; i < mNumDirLights; i++) {
+		if (!mDirectionalLights.at(i)->isDirty()) continue;
+		image.header.directionalLights[i] = mDirectionalLights.at(i)->getStruct();
+		mDirectionalLights.at(i)->setClean();
+		image.headerVersion = next;
+	}
+	if (mCountsChanged) {
+		image.header.numDirLights   = mNumDirLights;
+		image.header.numPointLights = mPointLights.size();
+		image.header.numSpotlights  = mSpotlights.size();
+		image.headerVersion         = next;
+		mCountsChanged              = false;
 	}
-	mSpotlights[mNumSpotlights++] = spotlight;
+
+	writeLights(
+	  mPointLights, mChanged->pointLights, next, mPointShadowCasters, image.pointLights,
+	  image.pointLightVersions
+	);
+	writeLights(
+	  mSpotlights, mChanged->spotlights, next, mSpotShadowCasters, image.spotlights,
+	  image.spotlightVersions
+	);
+
+	image.castShadows = mPointShadowCasters > 0 || mSpotShadowCasters > 0;
+	for (int i = 0; i < mNumDirLights; i++)
+		image.castShadows |= image.header.directionalLights[i].castShadows != 0;
+	mImage = std::make_shared<const Image>(std::move(image));
 }
 
 /**
- * Returns a struct that contains all data
- * @return A struct that contains all data and complies to glsl std140 layout rules
+ * Returns all light data as of the last update, complies to glsl std140 and std430 layout rules
  */
-LightSet::LightSetStruct LightSet::getStruct() const {
-	LightSetStruct lightStruct =
-	  LightSetStruct{{}, {}, {}, mNumDirLights, mNumPointLights, mNumSpotlights};
-	for (int i = 0; i < mNumDirLights; i++)
-		lightStruct.directionalLights[i] = mDirectionalLights.at(i)->getStruct();
-	for (int i = 0; i < mNumPointLights; i++)
-		lightStruct.pointLights[i] = mPointLights.at(i)->getStruct();
-	for (int i = 0; i < mNumSpotlights; i++)
-		lightStruct.spotlights[i] = mSpotlights.at(i)->getStruct();
-	return lightStruct;
+std::shared_ptr<const LightSet::Image> LightSet::getImage() const { return mImage; }
+
+/**
+ * Collects the byte ranges of a light array that changed after a version, neighbouring
+ * lights are merged into one range
+ * @param versions The version in which every light last changed
+ * @param stride The size of one light in bytes
+ * @param since The last version that is already known
+ * @param ranges The (offset, size) pairs of the changed ranges
+ */
+void LightSet::getChangedRanges(
+  const std::vector<unsigned int>& versions,
+  size_t stride,
+  unsigned int since,
+  std::vector<std::pair<size_t, size_t>>* ranges
+) {
+	ranges->clear();
+	for (size_t i = 0; i < versions.size(); ++i) {
+		if (versions[i] <= since) continue;
+		size_t offset = i * stride;
+		if (!ranges->empty() && ranges->back().first + ranges->back().second == offset)
+			ranges->back().second += stride;
+		else
+			ranges->push_back({offset, stride});
+	}
 }
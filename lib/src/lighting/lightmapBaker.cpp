@@ -0,0 +1,549 @@
+#include "jaroViewer/lighting/lightmapBaker.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+using namespace JaroViewer;
+
+namespace {
+	// Empty texels around every chart and instance, filled by the dilation so filtering
+	// never reads the black of unused texels
+	const float cCHARTPADDING    = 2.0f;
+	const uint cINSTANCEPADDING  = 2;
+	const uint cMINRESOLUTION    = 4;
+	const uint cMAXPLACEATTEMPTS = 8;
+	const float cDENSITYSTEP     = 0.8f;
+
+	// Rays start this far above the surface so they do not hit it
+	const float cRAYOFFSET   = 1e-3f;
+	const float cMAXDISTANCE = 1e30f;
+
+	// Texels traced between two progress reports
+	const size_t cBATCHSIZE = 4096;
+
+	// Edges of the charts are matched on positions rounded to this precision
+	const float cWELDSCALE = 1e4f;
+
+	glm::vec3 getPosition(const MeshGeometry& geometry, uint vertex) {
+		return glm::vec3(
+		  geometry.vertices[vertex * 8], geometry.vertices[vertex * 8 + 1], geometry.vertices[vertex * 8 + 2]
+		);
+	}
+
+	glm::vec3 getNormal(const MeshGeometry& geometry, uint vertex) {
+		return glm::vec3(
+		  geometry.vertices[vertex * 8 + 3], geometry.vertices[vertex * 8 + 4], geometry.vertices[vertex * 8 + 5]
+		);
+	}
+
+	size_t getNumTriangles(const MeshGeometry& geometry) {
+		return geometry.indices.empty() ? geometry.vertices.size() / 24 : geometry.indices.size() / 3;
+	}
+
+	uint getVertex(const MeshGeometry& geometry, size_t triangle, uint corner) {
+		return geometry.indices.empty() ? triangle * 3 + corner : geometry.indices[triangle * 3 + corner];
+	}
+
+	uint findRoot(std::vector<uint>& parents, uint node) {
+		while (parents[node] != node) {
+			parents[node] = parents[parents[node]];
+			node          = parents[node];
+		}
+		return node;
+	}
+
+	/**
+	 * Packs rectangles in rows of decreasing height
+	 * @param sizes The width and height of every rectangle
+	 * @param side The width of the area
+	 * @param offsets The position of every rectangle
+	 * @return The height the rows use
+	 */
+	template <typename T>
+	T packShelves(const std::vector<glm::vec<2, T>>& sizes, T side, std::vector<glm::vec<2, T>>* offsets) {
+		std::vector<size_t> order(sizes.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return sizes[a].y > sizes[b].y;
+		});
+
+		offsets->resize(sizes.size());
+		T x = 0, y = 0, rowHeight = 0;
+		for (size_t i : order) {
+			if (x > 0 && x + sizes[i].x > side) {
+				x  = 0;
+				y += rowHeight;
+				rowHeight = 0;
+			}
+			offsets->at(i) = glm::vec<2, T>(x, y);
+			x += sizes[i].x;
+			rowHeight = std::max(rowHeight, sizes[i].y);
+		}
+		return y + rowHeight;
+	}
+
+	// Direction around the normal with a probability proportional to the cosine
+	glm::vec3 sampleHemisphere(const glm::vec3& normal, std::minstd_rand& random) {
+		std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+		float angle  = glm::two_pi<float>() * unit(random);
+		float radius = std::sqrt(unit(random));
+
+		glm::vec3 up        = (std::abs(normal.x) > 0.9f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 tangent   = glm::normalize(glm::cross(up, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::normalize(
+		  tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) +
+		  normal * std::sqrt(std::max(0.0f, 1.0f - radius * radius))
+		);
+	}
+} // namespace
+
+LightmapBaker::LightmapBaker(JobSystem* jobs, const LightmapSettings& settings)
+  : mJobs(jobs), mSettings(settings), mTexture(0) {}
+
+/**
+ * Bakes the static instances and hands the lightmap to the object manager, the models
+ * with the basic shader switch to the baked shader
+ * @param objects The models, only the instances of static models are baked
+ * @param lights The lights in their current state
+ * @param progress Called on the calling thread with the fraction of the texels done
+ * @return The baked instances and texels and the time the bake took
+ */
+LightmapBaker::Stats LightmapBaker::bake(
+  ObjectManager& objects,
+  LightSet& lights,
+  const std::function<void(float progress)>& progress
+) {
+	auto start = std::chrono::steady_clock::now();
+	objects.applyChanges();
+	lights.update();
+	std::shared_ptr<const LightSet::Image> image = lights.getImage();
+
+	std::vector<StaticInstance> instances = objects.getStaticInstances();
+	if (instances.empty()) {
+		std::cout << "[Lightmap Baker] Warning: No static instances to bake" << std::endl;
+		return {0, 0, 0.0f};
+	}
+
+	// Every static model is unwrapped once, its instances share the uvs
+	std::map<ModelHandle, size_t> unwrapIndices;
+	std::vector<Unwrap> unwraps;
+	for (const StaticInstance& instance : instances) {
+		if (unwrapIndices.contains(instance.model)) continue;
+		unwrapIndices[instance.model] = unwraps.size();
+		unwraps.push_back(unwrap(objects.getGeometry(instance.model)));
+	}
+	std::vector<Unwrap> instanceUnwraps;
+	for (const StaticInstance& instance : instances)
+		instanceUnwraps.push_back(unwraps[unwrapIndices.at(instance.model)]);
+
+	std::vector<Placement> placements = placeInstances(instances, instanceUnwraps);
+	if (placements.empty()) {
+		std::cout << "[Lightmap Baker] Error: The static instances do not fit a lightmap of "
+		          << mSettings.atlasSize << " texels" << std::endl;
+		return {0, 0, 0.0f};
+	}
+
+	// The world space position and normal of every texel that a triangle covers
+	size_t numTexels = (size_t)mSettings.atlasSize * mSettings.atlasSize;
+	std::vector<char> covered(numTexels, 0);
+	std::vector<Texel> texels;
+	std::vector<glm::vec3> corners;
+	for (size_t i = 0; i < instances.size(); ++i) {
+		rasterize(instances[i], instanceUnwraps[i], placements[i], &covered, &texels);
+		for (const MeshGeometry& geometry : instanceUnwraps[i].geometry)
+			for (size_t t = 0; t < getNumTriangles(geometry); ++t)
+				for (uint c = 0; c < 3; ++c)
+					corners.push_back(
+					  glm::vec3(instances[i].matrix * glm::vec4(getPosition(geometry, getVertex(geometry, t, c)), 1.0f))
+					);
+	}
+	TriangleBvh bvh{std::move(corners)};
+
+	std::vector<glm::vec3> light(numTexels, glm::vec3(0.0f));
+	for (size_t begin = 0; begin < texels.size(); begin += cBATCHSIZE) {
+		size_t end = std::min(begin + cBATCHSIZE, texels.size());
+		mJobs->parallelFor(end - begin, 64, [&](size_t first, size_t last) {
+			for (size_t i = begin + first; i < begin + last; ++i) {
+				const Texel& texel = texels[i];
+				std::minstd_rand random{(uint)(texel.index * 2654435761u + 1)};
+				light[texel.index] = getDirectLight(bvh, *image, texel.position, texel.normal, true) +
+				  getIndirectLight(bvh, *image, texel.position, texel.normal, random);
+			}
+		});
+		if (progress) progress((float)end / texels.size());
+	}
+
+	dilate(&light, &covered);
+	upload(light);
+
+	for (const auto& [model, index] : unwrapIndices)
+		for (size_t mesh = 0; mesh < unwraps[index].geometry.size(); ++mesh)
+			objects.setLightmapGeometry(model, mesh, unwraps[index].geometry[mesh], unwraps[index].uvs[mesh]);
+	float texelSize = 1.0f / mSettings.atlasSize;
+	for (size_t i = 0; i < instances.size(); ++i) {
+		const Placement& placement = placements[i];
+		objects.setLightmapRect(
+		  instances[i].model, instances[i].slot,
+		  glm::vec4(placement.x, placement.y, placement.size, placement.size) * texelSize
+		);
+	}
+	objects.setLightmapTexture(mTexture);
+
+	std::chrono::duration<float> seconds = std::chrono::steady_clock::now() - start;
+	return {(uint)instances.size(), texels.size(), seconds.count()};
+}
+
+/**
+ * Returns the lightmap of the last bake, it is owned by the object manager it was handed to
+ */
+uint LightmapBaker::getTexture() const { return mTexture; }
+
+/**
+ * Splits the triangles of a model into charts of connected triangles that face the same
+ * axis, projects every chart on its axis and packs them into the unit square
+ * @param meshes The geometry of every mesh of the model
+ * @return The meshes with the vertices on chart borders duplicated and their lightmap uvs
+ */
+LightmapBaker::Unwrap LightmapBaker::unwrap(const std::vector<std::shared_ptr<const MeshGeometry>>& meshes) const {
+	struct Face {
+		uint mesh;
+		size_t triangle;
+		uint axis;
+	};
+	std::vector<Face> faces;
+	for (uint m = 0; m < meshes.size(); ++m) {
+		const MeshGeometry& geometry = *meshes[m];
+		for (size_t t = 0; t < getNumTriangles(geometry); ++t) {
+			glm::vec3 p0 = getPosition(geometry, getVertex(geometry, t, 0));
+			glm::vec3 p1 = getPosition(geometry, getVertex(geometry, t, 1));
+			glm::vec3 p2 = getPosition(geometry, getVertex(geometry, t, 2));
+			glm::vec3 n  = glm::cross(p1 - p0, p2 - p0);
+			glm::vec3 a  = glm::abs(n);
+			uint axis    = (a.x >= a.y && a.x >= a.z) ? 0 : (a.y >= a.z ? 1 : 2);
+			faces.push_back({m, t, axis * 2 + (n[axis] < 0.0f ? 1u : 0u)});
+		}
+	}
+
+	// Faces that share an edge and an axis end up in the same chart
+	std::vector<uint> parents(faces.size());
+	std::iota(parents.begin(), parents.end(), 0);
+	std::map<std::array<long, 7>, uint> edges;
+	for (uint f = 0; f < faces.size(); ++f) {
+		const MeshGeometry& geometry = *meshes[faces[f].mesh];
+		for (uint c = 0; c < 3; ++c) {
+			glm::vec3 a = glm::round(getPosition(geometry, getVertex(geometry, faces[f].triangle, c)) * cWELDSCALE);
+			glm::vec3 b =
+			  glm::round(getPosition(geometry, getVertex(geometry, faces[f].triangle, (c + 1) % 3)) * cWELDSCALE);
+			if (std::tie(b.x, b.y, b.z) < std::tie(a.x, a.y, a.z)) std::swap(a, b);
+			std::array<long, 7> key{(long)a.x, (long)a.y, (long)a.z, (long)b.x, (long)b.y, (long)b.z, (long)faces[f].axis};
+			auto [it, inserted] = edges.try_emplace(key, f);
+			if (!inserted) parents[findRoot(parents, f)] = findRoot(parents, it->second);
+		}
+	}
+
+	// The bounds of every chart on the plane of its axis
+	std::vector<uint> chartOf(faces.size());
+	std::map<uint, uint> chartIndices;
+	std::vector<glm::vec2> chartMin, chartMax;
+	auto project = [](const glm::vec3& position, uint axis) {
+		uint k = axis / 2;
+		return glm::vec2(position[(k + 1) % 3], position[(k + 2) % 3]);
+	};
+	for (uint f = 0; f < faces.size(); ++f) {
+		uint root = findRoot(parents, f);
+		if (!chartIndices.contains(root)) {
+			chartIndices[root] = chartMin.size();
+			chartMin.push_back(glm::vec2(std::numeric_limits<float>::max()));
+			chartMax.push_back(glm::vec2(std::numeric_limits<float>::lowest()));
+		}
+		uint chart                   = chartIndices.at(root);
+		chartOf[f]                   = chart;
+		const MeshGeometry& geometry = *meshes[faces[f].mesh];
+		for (uint c = 0; c < 3; ++c) {
+			glm::vec2 point = project(getPosition(geometry, getVertex(geometry, faces[f].triangle, c)), faces[f].axis);
+			chartMin[chart] = glm::min(chartMin[chart], point);
+			chartMax[chart] = glm::max(chartMax[chart], point);
+		}
+	}
+
+	// Grows the square until the shelves fit in it
+	float padding = cCHARTPADDING / mSettings.texelsPerUnit;
+	std::vector<glm::vec2> sizes;
+	float area = 0.0f, side = 0.0f;
+	for (size_t c = 0; c < chartMin.size(); ++c) {
+		sizes.push_back(chartMax[c] - chartMin[c] + padding);
+		area += sizes.back().x * sizes.back().y;
+		side  = std::max(side, std::max(sizes.back().x, sizes.back().y));
+	}
+	side = std::max(side, std::sqrt(area));
+	std::vector<glm::vec2> offsets;
+	while (packShelves(sizes, side, &offsets) > side) side *= 1.05f;
+
+	Unwrap result{side, {}, {}};
+	for (uint m = 0; m < meshes.size(); ++m) {
+		result.geometry.push_back({});
+		result.uvs.push_back({});
+	}
+	std::map<std::array<uint, 3>, uint> splitVertices;
+	for (uint f = 0; f < faces.size(); ++f) {
+		const MeshGeometry& source = *meshes[faces[f].mesh];
+		MeshGeometry& geometry     = result.geometry[faces[f].mesh];
+		std::vector<glm::vec2>& uvs = result.uvs[faces[f].mesh];
+		uint chart                 = chartOf[f];
+		for (uint c = 0; c < 3; ++c) {
+			uint vertex = getVertex(source, faces[f].triangle, c);
+			glm::vec2 point = project(getPosition(source, vertex), faces[f].axis);
+			glm::vec2 uv    = (point - chartMin[chart] + offsets[chart] + padding * 0.5f) / side;
+
+			// An indexed vertex is only shared by the triangles of one chart
+			if (!source.indices.empty()) {
+				auto [it, inserted] = splitVertices.try_emplace({faces[f].mesh, vertex, chart}, uvs.size());
+				geometry.indices.push_back(it->second);
+				if (!inserted) continue;
+			}
+			geometry.vertices.insert(
+			  geometry.vertices.end(), source.vertices.begin() + vertex * 8, source.vertices.begin() + vertex * 8 + 8
+			);
+			uvs.push_back(uv);
+		}
+	}
+	return result;
+}
+
+/**
+ * Gives every instance a square of the lightmap sized to its extent in the world, the
+ * texel density is lowered until all squares fit
+ * @return The square of every instance, empty if they do not fit
+ */
+std::vector<LightmapBaker::Placement> LightmapBaker::placeInstances(
+  const std::vector<StaticInstance>& instances,
+  const std::vector<Unwrap>& unwraps
+) const {
+	float density = mSettings.texelsPerUnit;
+	for (uint attempt = 0; attempt < cMAXPLACEATTEMPTS; ++attempt, density *= cDENSITYSTEP) {
+		std::vector<glm::uvec2> sizes;
+		for (size_t i = 0; i < instances.size(); ++i) {
+			const glm::mat4& matrix = instances[i].matrix;
+			float scale             = std::max(
+			  {glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))}
+			);
+			uint size = std::clamp<uint>(
+			  std::ceil(unwraps[i].extent * scale * density), cMINRESOLUTION, mSettings.atlasSize - cINSTANCEPADDING
+			);
+			sizes.push_back(glm::uvec2(size + cINSTANCEPADDING));
+		}
+
+		std::vector<glm::uvec2> offsets;
+		if (packShelves(sizes, mSettings.atlasSize, &offsets) > mSettings.atlasSize) continue;
+		if (attempt > 0)
+			std::cout << "[Lightmap Baker] Warning: Lowered the texel density to " << density
+			          << " texels per unit to fit the lightmap" << std::endl;
+
+		std::vector<Placement> placements;
+		for (size_t i = 0; i < instances.size(); ++i)
+			placements.push_back({offsets[i].x, offsets[i].y, sizes[i].x - cINSTANCEPADDING});
+		return placements;
+	}
+	return {};
+}
+
+/**
+ * Finds the texels whose centers are covered by the triangles of an instance
+ * @param covered Marks the texels that belong to a triangle
+ * @param texels Gets the world space position and normal of every covered texel
+ */
+void LightmapBaker::rasterize(
+  const StaticInstance& instance,
+  const Unwrap& unwrap,
+  const Placement& placement,
+  std::vector<char>* covered,
+  std::vector<Texel>* texels
+) const {
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.matrix)));
+	glm::vec2 origin(placement.x, placement.y);
+	for (size_t m = 0; m < unwrap.geometry.size(); ++m) {
+		const MeshGeometry& geometry = unwrap.geometry[m];
+		for (size_t t = 0; t < getNumTriangles(geometry); ++t) {
+			std::array<uint, 3> vertex;
+			std::array<glm::vec2, 3> point;
+			for (uint c = 0; c < 3; ++c) {
+				vertex[c] = getVertex(geometry, t, c);
+				point[c]  = origin + unwrap.uvs[m][vertex[c]] * (float)placement.size;
+			}
+			float area = (point[1].x - point[0].x) * (point[2].y - point[0].y) -
+			  (point[2].x - point[0].x) * (point[1].y - point[0].y);
+			if (std::abs(area) < 1e-12f) continue;
+
+			glm::vec2 low  = glm::max(glm::floor(glm::min(point[0], glm::min(point[1], point[2]))), origin);
+			glm::vec2 high = glm::min(
+			  glm::ceil(glm::max(point[0], glm::max(point[1], point[2]))), origin + (float)placement.size
+			);
+			for (uint y = low.y; y < high.y; ++y) {
+				for (uint x = low.x; x < high.x; ++x) {
+					glm::vec2 center(x + 0.5f, y + 0.5f);
+					glm::vec3 weights;
+					for (uint c = 0; c < 3; ++c) {
+						const glm::vec2& a = point[(c + 1) % 3];
+						const glm::vec2& b = point[(c + 2) % 3];
+						weights[c] = ((b.x - a.x) * (center.y - a.y) - (center.x - a.x) * (b.y - a.y)) / area;
+					}
+					if (weights.x < 0.0f || weights.y < 0.0f || weights.z < 0.0f) continue;
+
+					size_t index = (size_t)y * mSettings.atlasSize + x;
+					if (covered->at(index)) continue;
+					covered->at(index) = 1;
+
+					glm::vec3 position(0.0f), normal(0.0f);
+					for (uint c = 0; c < 3; ++c) {
+						position += getPosition(geometry, vertex[c]) * weights[c];
+						normal   += getNormal(geometry, vertex[c]) * weights[c];
+					}
+					texels->push_back(
+					  {glm::vec3(instance.matrix * glm::vec4(position, 1.0f)), glm::normalize(normalMatrix * normal), index}
+					);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * The diffuse light that reaches a point, with the same falloff as the basic shader.
+ * Every light is shadowed by the static geometry, also the ones without shadow maps
+ * @param ambient Adds the ambient term of the lights, left out for bounced light
+ * @return The light to multiply the albedo with
+ */
+glm::vec3 LightmapBaker::getDirectLight(
+  const TriangleBvh& bvh,
+  const LightSet::Image& lights,
+  const glm::vec3& position,
+  const glm::vec3& normal,
+  bool ambient
+) const {
+	glm::vec3 origin = position + normal * cRAYOFFSET;
+	glm::vec3 result(0.0f);
+	auto getDiffuse = [&](const glm::vec3& direction, float distance, const glm::vec3& color) {
+		float diffuse = glm::dot(normal, direction);
+		if (diffuse <= 0.0f || bvh.occluded(origin, direction, distance)) return glm::vec3(0.0f);
+		return color * diffuse;
+	};
+
+	for (int i = 0; i < lights.header.numDirLights; ++i) {
+		const DirectionalLight::DirectionalLightStruct& light = lights.header.directionalLights[i];
+		if (light.enable == 0) continue;
+		result += (ambient ? light.ambient : glm::vec3(0.0f)) +
+		  getDiffuse(-glm::normalize(light.direction), cMAXDISTANCE, light.diffuse);
+	}
+	for (const PointLight::PointLightStruct& light : *lights.pointLights) {
+		if (light.enable == 0) continue;
+		glm::vec3 toLight = light.position - position;
+		float distance    = glm::length(toLight);
+		float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		result += attenuation *
+		  ((ambient ? light.ambient : glm::vec3(0.0f)) +
+		   getDiffuse(toLight / distance, distance - cRAYOFFSET, light.diffuse));
+	}
+	for (const Spotlight::SpotlightStruct& light : *lights.spotlights) {
+		if (light.enable == 0) continue;
+		glm::vec3 toLight = light.position - position;
+		float distance    = glm::length(toLight);
+		float theta       = glm::dot(toLight / distance, glm::normalize(-light.direction));
+		if (theta < light.outerCutOff) continue;
+		float intensity   = std::clamp((theta - light.outerCutOff) / (light.cutOff - light.outerCutOff), 0.0f, 1.0f);
+		float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		result += intensity * attenuation *
+		  ((ambient ? light.ambient : glm::vec3(0.0f)) +
+		   getDiffuse(toLight / distance, distance - cRAYOFFSET, light.diffuse));
+	}
+	return result;
+}
+
+/**
+ * Traces paths from a point and gathers the direct light at every bounce, the cosine
+ * weighted directions cancel the cosine of the lambertian surfaces
+ */
+glm::vec3 LightmapBaker::getIndirectLight(
+  const TriangleBvh& bvh,
+  const LightSet::Image& lights,
+  const glm::vec3& position,
+  const glm::vec3& normal,
+  std::minstd_rand& random
+) const {
+	if (mSettings.indirectSamples == 0) return glm::vec3(0.0f);
+	glm::vec3 result(0.0f);
+	for (uint sample = 0; sample < mSettings.indirectSamples; ++sample) {
+		glm::vec3 origin     = position;
+		glm::vec3 surface    = normal;
+		float throughput     = 1.0f;
+		for (uint bounce = 0; bounce < mSettings.bounces; ++bounce) {
+			glm::vec3 direction = sampleHemisphere(surface, random);
+			glm::vec3 start     = origin + surface * cRAYOFFSET;
+			std::optional<TriangleBvh::Hit> hit = bvh.intersect(start, direction, cMAXDISTANCE);
+			if (!hit) break;
+
+			origin  = start + direction * hit->distance;
+			surface = bvh.getNormal(hit->triangle);
+			if (glm::dot(surface, direction) > 0.0f) surface = -surface;
+			throughput *= mSettings.bounceAlbedo;
+			result     += throughput * getDirectLight(bvh, lights, origin, surface, false);
+		}
+	}
+	return result / (float)mSettings.indirectSamples;
+}
+
+/**
+ * Grows the covered texels into the padding around them
+ */
+void LightmapBaker::dilate(std::vector<glm::vec3>* light, std::vector<char>* covered) const {
+	int size = mSettings.atlasSize;
+	for (uint pass = 0; pass < cINSTANCEPADDING; ++pass) {
+		std::vector<char> next = *covered;
+		for (int y = 0; y < size; ++y) {
+			for (int x = 0; x < size; ++x) {
+				if (covered->at((size_t)y * size + x)) continue;
+				glm::vec3 sum(0.0f);
+				uint count = 0;
+				for (int dy = -1; dy <= 1; ++dy) {
+					for (int dx = -1; dx <= 1; ++dx) {
+						int nx = x + dx, ny = y + dy;
+						if (nx < 0 || ny < 0 || nx >= size || ny >= size) continue;
+						if (!covered->at((size_t)ny * size + nx)) continue;
+						sum += light->at((size_t)ny * size + nx);
+						count++;
+					}
+				}
+				if (count == 0) continue;
+				light->at((size_t)y * size + x) = sum / (float)count;
+				next.at((size_t)y * size + x)   = 1;
+			}
+		}
+		*covered = std::move(next);
+	}
+}
+
+// A new texture for every bake, the object manager deletes the previous one
+void LightmapBaker::upload(const std::vector<glm::vec3>& light) {
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, mSettings.atlasSize, mSettings.atlasSize);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(
+	  GL_TEXTURE_2D, 0, 0, 0, mSettings.atlasSize, mSettings.atlasSize, GL_RGB, GL_FLOAT, light.data()
+	);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -6,17 +6,58 @@ PointLight::PointLight(Object obj, Tools::LightColor lightColor, Tools::Attenuat
   : mObject(obj),
     mLightColor(lightColor),
     mEnable(true),
+    mCastShadows(false),
     mConstant(params.constant),
     mLinear(params.linear),
-    mQuadratic(params.quadratic) {}
+    mQuadratic(params.quadratic) {
+	// Moving the object moves the light
+	mDirty    = true;
+	mListener = mObject->addListener([this](RawObject*, ObjectEvent event) {
+		if (event == ObjectEvent::TRANSFORM) this->markDirty();
+	});
+}
+
+PointLight::~PointLight() { mObject->removeListener(mListener); }
 
-void PointLight::enable(bool enable) { mEnable = enable; }
+void PointLight::enable(bool enable) {
+	mEnable = enable;
+	markDirty();
+}
+
+/**
+ * Enables or disables the cube shadow map of the light
+ */
+void PointLight::setCastShadows(bool castShadows) {
+	mCastShadows = castShadows;
+	markDirty();
+}
 
 PointLight::PointLightStruct PointLight::getStruct() const {
 	return PointLightStruct{mObject->getPosition(), mEnable,
 	                        mLightColor.ambient,    mConstant,
 	                        mLightColor.diffuse,    mLinear,
-	                        mLightColor.specular,   mQuadratic};
+	                        mLightColor.specular,   mQuadratic,
+	                        mCastShadows,           0.0f,
+	                        0.0f,                   0.0f};
 }
 
 Object PointLight::getObject() { return mObject; }
+
+/**
+ * Returns if the light changed since it was last marked clean
+ */
+bool PointLight::isDirty() const { return mDirty; }
+void PointLight::setClean() { mDirty = false; }
+
+/**
+ * Sets the function that is called when the light gets dirty, the light set that owns the
+ * light uses it to only rewrite the lights that changed
+ */
+void PointLight::setChangeListener(std::function<void()> listener) { mChangeListener = std::move(listener); }
+
+// The listener is only called once until the light is marked clean again
+void PointLight::markDirty() {
+	if (mDirty) return;
+	mDirty = true;
+	if (mChangeListener) mChangeListener();
+}
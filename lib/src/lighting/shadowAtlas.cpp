@@ -0,0 +1,127 @@
+#include "jaroViewer/lighting/shadowAtlas.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the depth texture of the atlas
+ * @param size The width and height in texels, rounded up to a power of two
+ * @param minTileSize The smallest tile that can be handed out
+ */
+ShadowAtlas::ShadowAtlas(uint size, uint minTileSize)
+  : mSize(std::bit_ceil(size)), mLevels(1), mTexture(0), mUsed(0) {
+	minTileSize = std::min(std::bit_ceil(std::max(minTileSize, 1u)), mSize);
+	while ((mSize >> (mLevels - 1)) > minTileSize) mLevels++;
+	mFree.resize(mLevels);
+	mFree.at(0).push_back(glm::uvec2(0));
+
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, mSize, mSize);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+ShadowAtlas::~ShadowAtlas() { glDeleteTextures(1, &mTexture); }
+
+/**
+ * Reserves a tile
+ * @param size The wanted width and height, rounded up to a power of two
+ * @return The tile, empty if the atlas is full
+ */
+std::optional<ShadowAtlas::Tile> ShadowAtlas::allocate(uint size) {
+	uint level                         = getLevel(size);
+	std::optional<glm::uvec2> position = allocateLevel(level);
+	if (!position) return std::nullopt;
+
+	uint tileSize = mSize >> level;
+	mUsed += (size_t)tileSize * tileSize;
+	return Tile{position->x, position->y, tileSize};
+}
+
+void ShadowAtlas::free(const Tile& tile) {
+	mUsed -= (size_t)tile.size * tile.size;
+	freeLevel(glm::uvec2(tile.x, tile.y), getLevel(tile.size));
+}
+
+/**
+ * Returns the offset and the scale of a tile in texture coordinates
+ */
+glm::vec4 ShadowAtlas::getRect(const Tile& tile) const {
+	return glm::vec4(tile.x, tile.y, tile.size, tile.size) / (float)mSize;
+}
+
+uint ShadowAtlas::getTexture() const { return mTexture; }
+uint ShadowAtlas::getSize() const { return mSize; }
+
+/**
+ * Returns the memory of the depth texture in bytes
+ */
+size_t ShadowAtlas::getMemory() const { return (size_t)mSize * mSize * sizeof(float); }
+
+/**
+ * Returns the memory of the tiles that are handed out in bytes
+ */
+size_t ShadowAtlas::getUsedMemory() const { return mUsed * sizeof(float); }
+
+uint ShadowAtlas::getLevel(uint size) const {
+	uint level = 0;
+	while (level + 1 < mLevels && (mSize >> (level + 1)) >= size) level++;
+	return level;
+}
+
+std::optional<glm::uvec2> ShadowAtlas::allocateLevel(uint level) {
+	std::vector<glm::uvec2>& free = mFree.at(level);
+	if (!free.empty()) {
+		glm::uvec2 position = free.back();
+		free.pop_back();
+		return position;
+	}
+	if (level == 0) return std::nullopt;
+
+	// Split a larger tile, the other three parts stay free
+	std::optional<glm::uvec2> parent = allocateLevel(level - 1);
+	if (!parent) return std::nullopt;
+	uint half = mSize >> level;
+	free.push_back(*parent + glm::uvec2(half, 0));
+	free.push_back(*parent + glm::uvec2(0, half));
+	free.push_back(*parent + glm::uvec2(half, half));
+	return *parent;
+}
+
+void ShadowAtlas::freeLevel(glm::uvec2 position, uint level) {
+	std::vector<glm::uvec2>& free = mFree.at(level);
+	if (level == 0) {
+		free.push_back(position);
+		return;
+	}
+
+	// Merge with the siblings when all of them are free
+	uint parentSize   = mSize >> (level - 1);
+	glm::uvec2 parent = position / parentSize * parentSize;
+	uint half         = parentSize / 2;
+	std::array<glm::uvec2, 3> siblings;
+	uint found = 0;
+	for (glm::uvec2 offset : {glm::uvec2(0), glm::uvec2(half, 0), glm::uvec2(0, half), glm::uvec2(half)}) {
+		glm::uvec2 sibling = parent + offset;
+		if (sibling == position) continue;
+		if (std::find(free.begin(), free.end(), sibling) == free.end()) break;
+		siblings[found++] = sibling;
+	}
+	if (found < 3) {
+		free.push_back(position);
+		return;
+	}
+	for (glm::uvec2 sibling : siblings) std::erase(free, sibling);
+	freeLevel(parent, level - 1);
+}
@@ -0,0 +1,80 @@
+#include "jaroViewer/lighting/shadowCubeArray.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the cube map array
+ * @param size The width and height of every face in texels
+ * @param capacity The amount of cubes before the array has to grow
+ */
+ShadowCubeArray::ShadowCubeArray(uint size, uint capacity)
+  : mSize(size), mCapacity(0), mTexture(0), mVersion(0), mFree() {
+	createTexture(std::max(capacity, 1u));
+}
+
+ShadowCubeArray::~ShadowCubeArray() { glDeleteTextures(1, &mTexture); }
+
+/**
+ * Reserves a cube, the array grows when it is full
+ * @return The index of the cube, its first layer is six times the index. Empty if the
+ * array can not grow any further
+ */
+std::optional<uint> ShadowCubeArray::allocate() {
+	if (mFree.empty()) {
+		GLint maxLayers;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		if (mCapacity * 2 * 6 > (uint)maxLayers) {
+			std::cout << "[Shadow Cube Array] Error: Can not hold more than " << mCapacity
+			          << " point light shadows" << std::endl;
+			return std::nullopt;
+		}
+		createTexture(mCapacity * 2);
+	}
+	uint cube = mFree.back();
+	mFree.pop_back();
+	return cube;
+}
+
+void ShadowCubeArray::free(uint cube) { mFree.push_back(cube); }
+
+uint ShadowCubeArray::getTexture() const { return mTexture; }
+uint ShadowCubeArray::getSize() const { return mSize; }
+
+/**
+ * Returns a number that changes every time the texture is recreated
+ */
+uint ShadowCubeArray::getVersion() const { return mVersion; }
+
+size_t ShadowCubeArray::getMemory() const {
+	return (size_t)mSize * mSize * 6 * mCapacity * sizeof(float);
+}
+
+size_t ShadowCubeArray::getUsedMemory() const {
+	return (size_t)mSize * mSize * 6 * (mCapacity - mFree.size()) * sizeof(float);
+}
+
+void ShadowCubeArray::createTexture(uint capacity) {
+	if (mTexture != 0) glDeleteTextures(1, &mTexture);
+
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mTexture);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, mSize, mSize, capacity * 6);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	// The new cubes are handed out from the lowest index
+	for (uint cube = capacity; cube > mCapacity; --cube) mFree.push_back(cube - 1);
+	mCapacity = capacity;
+	mVersion++;
+}
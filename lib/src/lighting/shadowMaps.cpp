@@ -0,0 +1,410 @@
+#include "jaroViewer/lighting/shadowMaps.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace JaroViewer;
+
+namespace {
+	const uint cCASCADESIZE = 1024;
+	const uint cSPOTSIZE    = 512;
+	const uint cCUBESIZE    = 512;
+
+	// Texture units of the atlas and the cubes, the highest units every implementation has
+	const uint cATLASUNIT = 15;
+	const uint cCUBEUNIT  = 14;
+
+	// Blend between uniform and logarithmic cascade splits
+	const float cSPLITLAMBDA = 0.75f;
+	const float cLIGHTNEAR   = 0.1f;
+
+	// Receivers are moved this many texels along their normal before the lookup
+	const float cNORMALOFFSET = 1.5f;
+
+	struct Transformation {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec3 viewPos;
+		float pad;
+	};
+
+	glm::vec3 getUp(const glm::vec3& direction) {
+		return (std::abs(direction.y) > 0.99f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+} // namespace
+
+/**
+ * Creates the atlas and the frame buffer the tiles are rendered with
+ * @param atlasSize The width and height of the atlas in texels
+ * @param shadowDistance The distance from the camera at which the cascades end
+ */
+ShadowMaps::ShadowMaps(uint atlasSize, float shadowDistance)
+  : mAtlas(atlasSize, cSPOTSIZE),
+    mFrameBuffer(0),
+    mDistance(shadowDistance),
+    mCascades(),
+    mSpotTiles(),
+    mCubes(cCUBESIZE, 4),
+    mCubeFrameBuffer(0),
+    mCubeVersion(0),
+    mPointCubes(),
+    mWarnedFull(false),
+    mStats{0, 0, 0, 0} {
+	glGenFramebuffers(1, &mFrameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mAtlas.getTexture(), 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "[Shadow Maps] Error: The shadow atlas frame buffer is not complete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glGenFramebuffers(1, &mCubeFrameBuffer);
+	for (Tile& tile : mCascades) tile = Tile{std::nullopt, glm::mat4(1.0f), 0, false};
+}
+
+ShadowMaps::~ShadowMaps() {
+	glDeleteFramebuffers(1, &mFrameBuffer);
+	glDeleteFramebuffers(1, &mCubeFrameBuffer);
+}
+
+/**
+ * Fits the shadow maps to the camera of this frame and renders the tiles that are out of
+ * date, then binds the shadow blocks and the atlas for the lit draws
+ * @param previous The older snapshot, its models are interpolated with the newest ones
+ * @param current The newest snapshot, the lights are taken from it
+ * @param alpha The interpolation factor between the snapshots
+ * @param view The view matrix of the camera
+ * @param projection The projection matrix of the camera
+ * @param viewport The size of the window, the viewport is restored to it
+ * @param ring The buffer the shadow blocks and casters of this frame are written to
+ */
+void ShadowMaps::update(
+  const SceneSnapshot& previous,
+  const SceneSnapshot& current,
+  float alpha,
+  const glm::mat4& view,
+  const glm::mat4& projection,
+  float nearPlane,
+  float farPlane,
+  Size viewport,
+  ObjectManager& objects,
+  FrameRingBuffer& ring
+) {
+	mStats.tilesRendered          = 0;
+	mStats.tilesCached            = 0;
+	const LightSet::Image& lights = *current.lights;
+	ShadowStruct shadows{};
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFrameBuffer);
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	glDepthMask(GL_TRUE);
+
+	// The corners of the camera frustum, the near plane first
+	glm::mat4 inverse = glm::inverse(projection * view);
+	std::array<glm::vec3, 8> corners;
+	for (uint i = 0; i < 8; ++i) {
+		glm::vec4 ndc(
+		  (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f
+		);
+		glm::vec4 corner = inverse * ndc;
+		corners[i]       = glm::vec3(corner) / corner.w;
+	}
+
+	float distance = std::min(mDistance, farPlane);
+	for (uint c = 0; c < cNUMCASCADES; ++c) {
+		float part               = (float)(c + 1) / cNUMCASCADES;
+		float uniform            = nearPlane + (distance - nearPlane) * part;
+		float logarithm          = nearPlane * std::pow(distance / nearPlane, part);
+		shadows.cascadeSplits[c] = glm::mix(uniform, logarithm, cSPLITLAMBDA);
+	}
+
+	for (uint light = 0; light < LightSet::mMAXNUMDIRLIGHTS; ++light) {
+		const DirectionalLight::DirectionalLightStruct& dirLight = lights.header.directionalLights[light];
+		bool enabled = (int)light < lights.header.numDirLights && dirLight.enable && dirLight.castShadows;
+		for (uint c = 0; c < cNUMCASCADES; ++c) {
+			uint index = light * cNUMCASCADES + c;
+			Tile& tile = mCascades[index];
+			if (!prepareTile(tile, cCASCADESIZE, enabled)) continue;
+
+			float begin = (c == 0) ? nearPlane : shadows.cascadeSplits[c - 1];
+			glm::mat4 lightProjection, lightView;
+			fitCascade(
+			  dirLight.direction, corners, nearPlane, farPlane, begin, shadows.cascadeSplits[c],
+			  &lightProjection, &lightView
+			);
+			renderTile(tile, lightProjection, lightView, previous, current, alpha, objects, ring);
+
+			float texel                = 2.0f / (lightProjection[0][0] * tile.tile->size);
+			shadows.dirMatrices[index] = lightProjection * lightView;
+			shadows.dirRects[index] =
+			  glm::vec4(glm::vec3(mAtlas.getRect(*tile.tile)), texel * cNORMALOFFSET);
+		}
+	}
+
+	// Indexed like the spotlights, a tile without size has no shadow
+	const std::vector<Spotlight::SpotlightStruct>& spotlights = *lights.spotlights;
+	if (mSpotTiles.size() < spotlights.size())
+		mSpotTiles.resize(spotlights.size(), Tile{std::nullopt, glm::mat4(1.0f), 0, false});
+	std::vector<SpotShadowStruct> spotShadows(
+	  std::max<size_t>(spotlights.size(), 1), SpotShadowStruct{glm::mat4(1.0f), glm::vec4(0.0f)}
+	);
+	for (size_t i = 0; i < mSpotTiles.size(); ++i) {
+		bool enabled = i < spotlights.size() && spotlights[i].enable && spotlights[i].castShadows;
+		Tile& tile = mSpotTiles[i];
+		if (!prepareTile(tile, cSPOTSIZE, enabled)) continue;
+
+		const Spotlight::SpotlightStruct& spot = spotlights[i];
+		float range = std::clamp(LightSet::getLightRange(spot), cLIGHTNEAR * 2.0f, farPlane);
+		float angle = std::min(
+		  2.0f * std::acos(std::clamp(spot.outerCutOff, -1.0f, 1.0f)), glm::radians(170.0f)
+		);
+		glm::vec3 direction       = glm::normalize(spot.direction);
+		glm::mat4 lightProjection = glm::perspective(angle, 1.0f, cLIGHTNEAR, range);
+		glm::mat4 lightView = glm::lookAt(spot.position, spot.position + direction, getUp(direction));
+		renderTile(tile, lightProjection, lightView, previous, current, alpha, objects, ring);
+
+		// The texel size grows with the distance to the light, the shader multiplies it
+		float texel    = 2.0f * std::tan(angle * 0.5f) / tile.tile->size;
+		spotShadows[i] = SpotShadowStruct{
+		  lightProjection * lightView,
+		  glm::vec4(glm::vec3(mAtlas.getRect(*tile.tile)), texel * cNORMALOFFSET)
+		};
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	updatePointShadows(previous, current, alpha, farPlane, objects, ring);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, viewport.width, viewport.height);
+
+	ring.bindUniform(6, &shadows, sizeof(ShadowStruct));
+	ring.bindStorage(7, spotShadows.data(), spotShadows.size() * sizeof(SpotShadowStruct));
+	glActiveTexture(GL_TEXTURE0 + cATLASUNIT);
+	glBindTexture(GL_TEXTURE_2D, mAtlas.getTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	mStats.atlasBytes     = mAtlas.getMemory() + mCubes.getMemory();
+	mStats.atlasUsedBytes = mAtlas.getUsedMemory() + mCubes.getUsedMemory();
+}
+
+/**
+ * Returns the tiles and cubes rendered and reused in the last update and the memory of
+ * the atlas and the cubes
+ */
+ShadowMaps::Stats ShadowMaps::getStats() const { return mStats; }
+
+/**
+ * Gives a tile of a shadow casting light a place in the atlas and frees the tiles of
+ * lights that stopped casting
+ * @param size The width and height of the tile
+ * @param enabled If the light casts shadows
+ * @return True if the tile has a place in the atlas
+ */
+bool ShadowMaps::prepareTile(Tile& tile, uint size, bool enabled) {
+	if (!enabled) {
+		if (tile.tile) {
+			mAtlas.free(*tile.tile);
+			mWarnedFull = false;
+		}
+		tile.tile  = std::nullopt;
+		tile.valid = false;
+		return false;
+	}
+	if (tile.tile) return true;
+
+	tile.tile  = mAtlas.allocate(size);
+	tile.valid = false;
+	if (!tile.tile && !mWarnedFull) {
+		std::cout << "[Shadow Maps] Warning: The shadow atlas is full, some lights have no shadows"
+		          << std::endl;
+		mWarnedFull = true;
+	}
+	return tile.tile.has_value();
+}
+
+/**
+ * Renders the cubes of the point lights that cast shadows, all six faces of a cube in one
+ * pass. Every caster is culled against the frustum of each face, a cube is skipped while
+ * its light and the casters in its range stay the same
+ */
+void ShadowMaps::updatePointShadows(
+  const SceneSnapshot& previous,
+  const SceneSnapshot& current,
+  float alpha,
+  float farPlane,
+  ObjectManager& objects,
+  FrameRingBuffer& ring
+) {
+	const std::vector<PointLight::PointLightStruct>& lights = *current.lights->pointLights;
+	if (mPointCubes.size() < lights.size())
+		mPointCubes.resize(lights.size(), Cube{std::nullopt, glm::vec4(0.0f), 0, false});
+
+	// Every cube is reserved first, growing the array loses the depth of all cubes
+	for (size_t i = 0; i < mPointCubes.size(); ++i) {
+		Cube& cube   = mPointCubes[i];
+		bool enabled = i < lights.size() && lights[i].enable && lights[i].castShadows;
+		if (!enabled) {
+			if (cube.cube) mCubes.free(*cube.cube);
+			cube.cube  = std::nullopt;
+			cube.valid = false;
+		} else if (!cube.cube) {
+			cube.cube  = mCubes.allocate();
+			cube.valid = false;
+		}
+	}
+	if (mCubeVersion != mCubes.getVersion()) {
+		glBindFramebuffer(GL_FRAMEBUFFER, mCubeFrameBuffer);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mCubes.getTexture(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "[Shadow Maps] Error: The point shadow frame buffer is not complete" << std::endl;
+		for (Cube& cube : mPointCubes) cube.valid = false;
+		mCubeVersion = mCubes.getVersion();
+	}
+
+	// Per light the cube, the range and the normal offset per distance, no cube is negative
+	std::vector<glm::vec4> pointShadows(std::max<size_t>(lights.size(), 1), glm::vec4(-1.0f, 1.0f, 0.0f, 0.0f));
+	const std::array<std::pair<glm::vec3, glm::vec3>, 6> faces{
+	  {{{1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}},
+	   {{-1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}},
+	   {{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+	   {{0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+	   {{0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}},
+	   {{0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}}}
+	};
+	uint size = mCubes.getSize();
+	glBindFramebuffer(GL_FRAMEBUFFER, mCubeFrameBuffer);
+	glViewport(0, 0, size, size);
+	for (size_t i = 0; i < lights.size(); ++i) {
+		Cube& cube = mPointCubes[i];
+		if (!cube.cube) continue;
+
+		const PointLight::PointLightStruct& point = lights[i];
+		float range          = std::clamp(LightSet::getLightRange(point), cLIGHTNEAR * 2.0f, farPlane);
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, cLIGHTNEAR, range);
+		PointPassStruct pass{{}, glm::vec4(point.position, range), (int)*cube.cube * 6, 0, 0, 0};
+		for (uint f = 0; f < 6; ++f)
+			pass.faceMatrices[f] =
+			  projection * glm::lookAt(point.position, point.position + faces[f].first, faces[f].second);
+		pointShadows[i] = glm::vec4(*cube.cube, range, 2.0f / size * cNORMALOFFSET, 0.0f);
+
+		uint64_t hash = objects.packShadowCasters(
+		  previous.models, current.models, alpha, std::span<const glm::mat4>(pass.faceMatrices, 6)
+		);
+		if (cube.valid && cube.light == pass.light && cube.casterHash == hash) {
+			mStats.tilesCached++;
+			continue;
+		}
+
+		float clearDepth = 1.0f;
+		glClearTexSubImage(
+		  mCubes.getTexture(), 0, 0, 0, pass.layer, size, size, 6, GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth
+		);
+		ring.bindUniform(2, &pass, sizeof(PointPassStruct));
+		objects.renderShadowCasters(ring, PredefinedShader::POINTSHADOW);
+
+		cube.light      = pass.light;
+		cube.casterHash = hash;
+		cube.valid      = true;
+		mStats.tilesRendered++;
+	}
+
+	ring.bindStorage(6, pointShadows.data(), pointShadows.size() * sizeof(glm::vec4));
+	glActiveTexture(GL_TEXTURE0 + cCUBEUNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mCubes.getTexture());
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+ * Renders the casters into a tile, unless the tile already holds them from the same light
+ * @param projection The projection matrix of the light
+ * @param view The view matrix of the light
+ */
+void ShadowMaps::renderTile(
+  Tile& tile,
+  const glm::mat4& projection,
+  const glm::mat4& view,
+  const SceneSnapshot& previous,
+  const SceneSnapshot& current,
+  float alpha,
+  ObjectManager& objects,
+  FrameRingBuffer& ring
+) {
+	glm::mat4 viewProjection = projection * view;
+	uint64_t hash = objects.packShadowCasters(
+	  previous.models, current.models, alpha, std::span<const glm::mat4>(&viewProjection, 1)
+	);
+	if (tile.valid && tile.viewProjection == viewProjection && tile.casterHash == hash) {
+		mStats.tilesCached++;
+		return;
+	}
+
+	const ShadowAtlas::Tile& place = *tile.tile;
+	glViewport(place.x, place.y, place.size, place.size);
+	glScissor(place.x, place.y, place.size, place.size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	Transformation trans{projection, view, glm::vec3(glm::inverse(view)[3]), 0.0f};
+	ring.bindUniform(0, &trans, sizeof(Transformation));
+	objects.renderShadowCasters(ring);
+
+	tile.viewProjection = viewProjection;
+	tile.casterHash     = hash;
+	tile.valid          = true;
+	mStats.tilesRendered++;
+}
+
+/**
+ * Fits an orthographic shadow map around a depth slice of the camera frustum. The bounds
+ * are a sphere and are moved in steps of whole texels, so the matrix stays the same while
+ * the camera moves within a step and the tile can be reused
+ * @param direction The direction of the light
+ * @param corners The corners of the camera frustum, the near plane first
+ * @param begin The view depth at which the slice starts
+ * @param end The view depth at which the slice ends
+ */
+void ShadowMaps::fitCascade(
+  const glm::vec3& direction,
+  const std::array<glm::vec3, 8>& corners,
+  float nearPlane,
+  float farPlane,
+  float begin,
+  float end,
+  glm::mat4* projection,
+  glm::mat4* view
+) const {
+	// The depth of a point grows linearly along the edges of the frustum
+	std::array<glm::vec3, 8> slice;
+	glm::vec3 center(0.0f);
+	for (uint i = 0; i < 4; ++i) {
+		slice[i]     = glm::mix(corners[i], corners[i + 4], (begin - nearPlane) / (farPlane - nearPlane));
+		slice[i + 4] = glm::mix(corners[i], corners[i + 4], (end - nearPlane) / (farPlane - nearPlane));
+		center += slice[i] + slice[i + 4];
+	}
+	center /= 8.0f;
+
+	float radius = 0.0f;
+	for (const glm::vec3& point : slice) radius = std::max(radius, glm::length(point - center));
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	// A step of a third of the radius is an eighth of the tile, so it is a whole amount of texels
+	glm::vec3 lightDir = glm::normalize(direction);
+	*view              = glm::lookAt(glm::vec3(0.0f), lightDir, getUp(lightDir));
+	float step         = radius / 3.0f;
+	float extent       = radius + step;
+	glm::vec3 snapped  = glm::floor(glm::vec3(*view * glm::vec4(center, 1.0f)) / step) * step;
+
+	// Casters between the light and the slice are kept up to the shadow distance
+	*projection = glm::ortho(
+	  snapped.x - extent, snapped.x + extent, snapped.y - extent, snapped.y + extent,
+	  -(snapped.z + extent) - mDistance, -(snapped.z - extent)
+	);
+}
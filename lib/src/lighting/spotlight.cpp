@@ -15,16 +15,36 @@ Spotlight::Spotlight(
   : mObject{std::move(obj)},
     mLightColor{lightColor},
     mEnable{true},
+    mCastShadows{false},
     mDirection{direction},
     mCutOff{glm::cos(glm::radians(innerAngle))},
     mOuterCutOff{glm::cos(glm::radians(outerAngle))},
     mConstant{params.constant},
     mLinear{params.linear},
-    mQuadratic{params.quadratic} {}
+    mQuadratic{params.quadratic} {
+	// Moving the object moves the light
+	mDirty    = true;
+	mListener = mObject->addListener([this](RawObject*, ObjectEvent event) {
+		if (event == ObjectEvent::TRANSFORM) this->markDirty();
+	});
+}
+
+Spotlight::~Spotlight() { mObject->removeListener(mListener); }
 
-void Spotlight::enable(bool enable) { mEnable = enable; }
+void Spotlight::enable(bool enable) {
+	mEnable = enable;
+	markDirty();
+}
 bool Spotlight::getState() const { return mEnable; }
 
+/**
+ * Enables or disables the shadow map of the light
+ */
+void Spotlight::setCastShadows(bool castShadows) {
+	mCastShadows = castShadows;
+	markDirty();
+}
+
 Spotlight::SpotlightStruct Spotlight::getStruct() const {
 	return SpotlightStruct{
 	  mObject->getPosition(),
@@ -38,7 +58,7 @@ Spotlight::SpotlightStruct Spotlight::getStruct() const {
 	  mLightColor.specular,
 	  mQuadratic,
 	  mEnable,
-	  0.0f,
+	  mCastShadows,
 	  0.0f,
 	  0.0f
 	};
@@ -48,4 +68,24 @@ Object Spotlight::getObject() { return mObject; }
 
 void Spotlight::setDirection(const glm::vec3& direction) {
 	mDirection = direction;
+	markDirty();
+}
+
+/**
+ * Returns if the light changed since it was last marked clean
+ */
+bool Spotlight::isDirty() const { return mDirty; }
+void Spotlight::setClean() { mDirty = false; }
+
+/**
+ * Sets the function that is called when the light gets dirty, the light set that owns the
+ * light uses it to only rewrite the lights that changed
+ */
+void Spotlight::setChangeListener(std::function<void()> listener) { mChangeListener = std::move(listener); }
+
+// The listener is only called once until the light is marked clean again
+void Spotlight::markDirty() {
+	if (mDirty) return;
+	mDirty = true;
+	if (mChangeListener) mChangeListener();
 }
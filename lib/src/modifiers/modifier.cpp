@@ -7,9 +7,27 @@
 
 using namespace JaroViewer;
 
-std::string Modifier::getVertexLibrary() {
+/**
+ * Builds the vertex shader code that applies the modifiers of an instance
+ * @param modifiers Bit per modifier ident, only these modifiers are compiled in. Without
+ * any modifier the vertices are passed through without reading the modifier data
+ */
+std::string Modifier::getVertexLibrary(uint64_t modifiers) {
+	return vertexLibrary + getModifierLibrary(modifiers);
+}
+
+/**
+ * Builds processModifiers without the vertex inputs it reads, for the include of the
+ * vertex library
+ * @param modifiers Bit per modifier ident, only these modifiers are compiled in
+ */
+std::string Modifier::getModifierLibrary(uint64_t modifiers) {
 	std::stringstream out;
-	out << vertexLibrary;
+	if (modifiers == 0) {
+		out << "vec3 processModifiers(vec3 inVec) {\nreturn inVec;\n}\n";
+		return out.str();
+	}
+
 	out << "uint modifierIndex = 0;\n"
 	       "float nextModifierParam() {\n"
 	       "float ret = getDataFromVector(modifierData, modifierIndex);\n"
@@ -17,9 +35,11 @@ std::string Modifier::getVertexLibrary() {
 	       "return ret;\n"
 	       "}\n";
 
+	auto used = [modifiers](uint ident) { return ident >= 64 || (modifiers >> ident) & 1u; };
 	for (auto& modifier : getModifiers())
-		out << "vec3 " << modifier.first << "(vec3 inVec) {\n"
-		    << modifier.second.code << "\n}\n";
+		if (used(modifier.second.ident))
+			out << "vec3 " << modifier.first << "(vec3 inVec) {\n"
+			    << modifier.second.code << "\n}\n";
 
 	out << "vec3 processModifiers(vec3 inVec) {\n"
 	       "modifierIndex = aModifierStart;\n"
@@ -28,8 +48,9 @@ std::string Modifier::getVertexLibrary() {
 	       "int type = int(nextModifierParam());\n"
 	       "switch (type) {";
 	for (auto& modifier : getModifiers())
-		out << "case " << modifier.second.ident << ": outVec = " << modifier.first
-		    << "(outVec); break;\n";
+		if (used(modifier.second.ident))
+			out << "case " << modifier.second.ident << ": outVec = " << modifier.first
+			    << "(outVec); break;\n";
 	out << "}\n}\nreturn outVec;\n}\n";
 
 	return out.str();
@@ -0,0 +1,91 @@
+#include "jaroViewer/rendering/deferredRenderer.hpp"
+#include "jaroViewer/rendering/basicShaders.hpp"
+
+#include <glad/glad.h>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the G-buffer, the lit framebuffer and the full screen passes
+ * @param width The width of the screen
+ * @param height The height of the screen
+ */
+DeferredRenderer::DeferredRenderer(int width, int height)
+  : mGBuffer({width, height, true, true, GL_RGBA8, {GL_RGBA8, GL_RGBA16F}}),
+    mLit({width, height, true, false, GL_RGB}),
+    mLighting(ShaderCode{screenVertex, "", fragmentLibrary + deferredLightingFragment}),
+    mPresent(ShaderCode{screenVertex, "", presentFragment}),
+    mInverseViewProjection(mLighting.getUniform<glm::mat4>("inverseViewProjection")),
+    mVao(0),
+    mBlend(false) {
+	glGenVertexArrays(1, &mVao);
+
+	mLighting.use();
+	mLighting.setUniformBuffer("LightSet", 1);
+	mLighting.setInt("gAlbedo", 0);
+	mLighting.setInt("gSpecular", 1);
+	mLighting.setInt("gNormal", 2);
+	mLighting.setInt("gDepth", 3);
+	mPresent.use();
+	mPresent.setInt("screenTexture", 0);
+}
+
+DeferredRenderer::~DeferredRenderer() { glDeleteVertexArrays(1, &mVao); }
+
+void DeferredRenderer::resize(uint width, uint height) {
+	mGBuffer.resize(width, height);
+	mLit.resize(width, height);
+}
+
+/**
+ * Binds and clears the G-buffer for the geometry pass
+ */
+void DeferredRenderer::bindGeometry() {
+	// Blending would mix the G-buffer values with their alpha
+	mBlend = glIsEnabled(GL_BLEND);
+	glDisable(GL_BLEND);
+	mGBuffer.bind();
+	mGBuffer.clear(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+/**
+ * Lights the G-buffer into the lit framebuffer and copies the depth, so the forward
+ * passes after it are hidden behind the lit models. The lit framebuffer stays bound
+ * @param viewProjection The view projection matrix of the geometry pass
+ */
+void DeferredRenderer::renderLighting(const glm::mat4& viewProjection) {
+	mLit.bind();
+	mLit.clear(0.0f, 0.0f, 0.0f, 0.0f);
+	glDisable(GL_DEPTH_TEST);
+
+	mLighting.use();
+	mLighting.set(mInverseViewProjection, glm::inverse(viewProjection));
+	for (uint i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, mGBuffer.getColor(i));
+	}
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, mGBuffer.getDepthStencil());
+	glBindVertexArray(mVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glEnable(GL_DEPTH_TEST);
+	if (mBlend) glEnable(GL_BLEND);
+	mGBuffer.blitDepthStencil(mLit);
+}
+
+/**
+ * Copies the lit result to the screen, used when there is no post processor
+ */
+void DeferredRenderer::present() const {
+	mLit.unbind();
+	glDisable(GL_DEPTH_TEST);
+	mPresent.use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, mLit.getColor());
+	glBindVertexArray(mVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+}
+
+uint DeferredRenderer::getLitColor() const { return mLit.getColor(); }
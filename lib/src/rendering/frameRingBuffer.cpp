@@ -0,0 +1,134 @@
+#include "jaroViewer/rendering/frameRingBuffer.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace JaroViewer;
+
+namespace {
+	const GLbitfield cMAPFLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+/**
+ * Creates the ring buffer
+ * @param regionSize The initial amount of bytes every frame can allocate, grows when needed
+ * @param framesInFlight The amount of frames the cpu can be ahead of the gpu
+ */
+FrameRingBuffer::FrameRingBuffer(size_t regionSize, uint framesInFlight)
+  : mBuffer(0),
+    mData(nullptr),
+    mRegionSize(0),
+    mFrame(0),
+    mHead(0),
+    mFences(std::max(1u, framesInFlight), nullptr) {
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mUniformAlignment = alignment;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mStorageAlignment = alignment;
+	createBuffer(regionSize);
+}
+
+FrameRingBuffer::~FrameRingBuffer() {
+	for (GLsync fence : mFences)
+		if (fence) glDeleteSync(fence);
+	if (!mRetired.empty()) glDeleteBuffers(mRetired.size(), mRetired.data());
+	glDeleteBuffers(1, &mBuffer);
+}
+
+/**
+ * Waits until the gpu is done with the region of this frame
+ */
+void FrameRingBuffer::beginFrame() {
+	GLsync& fence = mFences.at(mFrame);
+	if (fence) {
+		GLenum result = GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (result == GL_WAIT_FAILED)
+			std::cout << "[Frame Ring Buffer] Error: Waiting on a frame fence failed" << std::endl;
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	mHead = 0;
+}
+
+/**
+ * Fences the region of this frame, must be called after the last draw that uses it
+ */
+void FrameRingBuffer::endFrame() {
+	mFences.at(mFrame) = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mFrame             = (mFrame + 1) % mFences.size();
+
+	// The driver keeps the storage alive until the gpu is done with it
+	if (!mRetired.empty()) glDeleteBuffers(mRetired.size(), mRetired.data());
+	mRetired.clear();
+}
+
+/**
+ * Reserves memory in the region of this frame, the region grows when it is full
+ * @param size The amount of bytes
+ * @param alignment The alignment of the offset in the buffer
+ * @return The offset in the buffer and a pointer to write to, valid until the frame ends
+ */
+FrameRingBuffer::Allocation FrameRingBuffer::allocate(size_t size, size_t alignment) {
+	alignment     = std::max<size_t>(alignment, 1);
+	size_t offset = (mHead + alignment - 1) / alignment * alignment;
+	if (offset + size > mRegionSize) {
+		// Nothing uses the new buffer yet, so the region can be used right away
+		createBuffer(std::max(mRegionSize * 2, size * 2));
+		offset = 0;
+	}
+	mHead = offset + size;
+
+	size_t position = mFrame * mRegionSize + offset;
+	return {mBuffer, position, mData + position};
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::upload(const void* data, size_t size, size_t alignment) {
+	Allocation allocation = allocate(size, alignment);
+	std::memcpy(allocation.data, data, size);
+	return allocation;
+}
+
+/**
+ * Copies uniform block data into this frame and binds it
+ * @param position The binding point of the uniform block
+ */
+void FrameRingBuffer::bindUniform(uint position, const void* data, size_t size) {
+	Allocation allocation = upload(data, size, mUniformAlignment);
+	glBindBufferRange(GL_UNIFORM_BUFFER, position, allocation.buffer, allocation.offset, size);
+}
+
+/**
+ * Copies shader storage data into this frame and binds it
+ * @param position The binding point of the storage block
+ */
+void FrameRingBuffer::bindStorage(uint position, const void* data, size_t size) {
+	Allocation allocation = upload(data, size, mStorageAlignment);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, position, allocation.buffer, allocation.offset, size);
+}
+
+uint FrameRingBuffer::getBuffer() const { return mBuffer; }
+
+size_t FrameRingBuffer::getUniformAlignment() const { return mUniformAlignment; }
+
+size_t FrameRingBuffer::getStorageAlignment() const { return mStorageAlignment; }
+
+// The regions start at a multiple of the region size, so it keeps their offsets aligned for binding
+void FrameRingBuffer::createBuffer(size_t regionSize) {
+	if (mBuffer != 0) mRetired.push_back(mBuffer);
+	size_t alignment = std::max(mUniformAlignment, mStorageAlignment);
+	mRegionSize      = (regionSize + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, mRegionSize * mFences.size(), nullptr, cMAPFLAGS);
+	mData = static_cast<char*>(
+	  glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, mRegionSize * mFences.size(), cMAPFLAGS)
+	);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -33,22 +33,53 @@ void GpuVector::load(uint position) const {
 }
 
 void GpuVector::copy(const std::vector<float>& data, size_t offset) {
-	mCount = std::max(offset + data.size(), mCount);
-	if (mCount > size()) enlarge();
+	copy(data.data(), data.size(), offset);
+}
+
+/**
+ * Copies a range of floats into the vector, the vector grows when needed
+ * @param data Pointer to the first float
+ * @param count The amount of floats to copy
+ * @param offset The index in the vector where the first float is placed
+ */
+void GpuVector::copy(const float* data, size_t count, size_t offset) {
+	if (count == 0) return;
+	mCount = std::max(offset + count, mCount);
+	while (mCount * sizeof(float) > size()) enlarge();
 
 	glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
 	float* ptr = (float*)glMapBufferRange(
-	  GL_TEXTURE_BUFFER, offset * sizeof(float), data.size() * sizeof(float),
+	  GL_TEXTURE_BUFFER, offset * sizeof(float), count * sizeof(float),
 	  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
 	);
-	std::memcpy(ptr, data.data(), data.size() * sizeof(float));
+	std::memcpy(ptr, data, count * sizeof(float));
 	glUnmapBuffer(GL_TEXTURE_BUFFER);
 }
 
+/**
+ * Copies floats from another buffer on the gpu, the vector grows when needed
+ * @param buffer The buffer to copy from
+ * @param bufferOffset The offset in bytes in the source buffer
+ * @param count The amount of floats to copy
+ * @param offset The index in the vector where the first float is placed
+ */
+void GpuVector::copyFromBuffer(uint buffer, size_t bufferOffset, size_t count, size_t offset) {
+	if (count == 0) return;
+	mCount = std::max(offset + count, mCount);
+	while (mCount * sizeof(float) > size()) enlarge();
+
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	glCopyBufferSubData(
+	  GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, bufferOffset, offset * sizeof(float),
+	  count * sizeof(float)
+	);
+}
+
 void GpuVector::move(size_t from, size_t to) { move(from, to, mCount - from); }
 void GpuVector::move(size_t from, size_t to, size_t count) {
 	mCount = std::max(to + count, mCount);
-	if (mCount > size()) enlarge();
+	while (mCount * sizeof(float) > size()) enlarge();
 
 	GLuint temp;
 	glGenBuffers(1, &temp);
@@ -68,7 +99,7 @@ void GpuVector::move(size_t from, size_t to, size_t count) {
 
 void GpuVector::enlarge(float factor) {
 	GLuint newTex, newBuf;
-	genDataTex(&newTex, &newBuf, size() * factor);
+	genDataTex(&newTex, &newBuf, size() / sizeof(float) * factor);
 	copy(mBuffer, newBuf);
 
 	glDeleteBuffers(1, &mBuffer);
@@ -81,7 +112,8 @@ void GpuVector::copy(GLuint fromBuffer, GLuint toBuffer) {
 	glBindBuffer(GL_COPY_READ_BUFFER, fromBuffer);
 	glBindBuffer(GL_COPY_WRITE_BUFFER, toBuffer);
 
-	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, mCount * sizeof(float));
+	size_t bytes = std::min(mCount * sizeof(float), size());
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes);
 }
 
 void GpuVector::genDataTex(GLuint* tex, GLuint* tbo, size_t size) {
@@ -1,6 +1,7 @@
 #include "jaroViewer/rendering/postProcessor.hpp"
 #include "jaroViewer/core/tools.hpp"
 #include "jaroViewer/rendering/basicShaders.hpp"
+#include "jaroViewer/rendering/shaderPreprocessor.hpp"
 
 #include <glad/glad.h>
 
@@ -24,9 +25,10 @@ const std::string vertexCode = shaderVersion +
  */
 PostProcessor::PostProcessor(Window* window, const std::string fragmentFile)
   : mFrameBuffer({window->getSize().width, window->getSize().height, true, false, GL_RGB}) {
-	std::string buff;
-	Tools::readFile(fragmentFile, &buff);
-	mShader = std::make_unique<Shader>(ShaderCode{vertexCode, "", buff});
+	std::string fragment = ShaderPreprocessor::processFiles({fragmentFile});
+	mShader              = std::make_unique<Shader>(ShaderCode{vertexCode, "", fragment});
+	mShader->use();
+	mShader->setInt("screenTexture", 0);
 	setupVao();
 }
 
@@ -73,13 +75,18 @@ void PostProcessor::unbind() const { mFrameBuffer.unbind(); }
 /**
  * Renders the postprocessor with the fragment shader to the screen
  */
-void PostProcessor::render() const {
+void PostProcessor::render() const { render(mFrameBuffer.getColor()); }
+
+/**
+ * Renders a texture with the fragment shader to the screen, used when the frame
+ * was drawn into another framebuffer
+ * @param texture The texture with the frame
+ */
+void PostProcessor::render(uint texture) const {
 	mFrameBuffer.unbind();
 	mShader->use();
-	mShader->setInt("screenTexture", 0);
 	glBindVertexArray(mVaoBuffer);
 	glActiveTexture(GL_TEXTURE0);
-	unsigned int texture = mFrameBuffer.getColor();
 	glBindTexture(GL_TEXTURE_2D, texture);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 }
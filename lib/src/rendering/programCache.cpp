@@ -0,0 +1,159 @@
+#include "jaroViewer/rendering/programCache.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+using namespace JaroViewer;
+
+static const uint32_t cMAGIC = 0x4250564a; // "JVPB"
+
+static void hashBytes(uint64_t* hash, const char* data, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		*hash ^= static_cast<unsigned char>(data[i]);
+		*hash *= 0x100000001b3ull;
+	}
+}
+
+/**
+ * Enables the cache, needs a current gl context to read the driver
+ * @param directory The directory of the binaries, created when missing. Empty disables the cache
+ */
+void ProgramCache::setDirectory(const std::string& directory) {
+	State& state    = getState();
+	state.directory = directory;
+	if (directory == "") return;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		std::cout << "[ProgramCache] Warning: Could not create " << directory << " (" << error.message()
+		          << "), shaders are compiled" << std::endl;
+		state.directory = "";
+		return;
+	}
+
+	int formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	state.supported = formats > 0;
+	if (!state.supported)
+		std::cout << "[ProgramCache] Warning: The driver has no program binary formats, shaders are compiled"
+		          << std::endl;
+
+	state.driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|" +
+	  reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|" +
+	  reinterpret_cast<const char*>(glGetString(GL_VERSION));
+}
+
+bool ProgramCache::isEnabled() {
+	const State& state = getState();
+	return state.directory != "" && state.supported;
+}
+
+/**
+ * Creates a program from the binary of its sources
+ * @param sources The sources of the program in stage order, the defines included
+ * @return The linked program, nothing when it is not cached or the driver rejects the binary
+ */
+std::optional<uint> ProgramCache::load(const std::vector<const std::string*>& sources) {
+	if (!isEnabled()) return std::nullopt;
+
+	uint64_t key = getKey(sources);
+	std::ifstream file(getPath(key), std::ios::binary);
+	if (!file) return std::nullopt;
+
+	Header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(Header)) || header.magic != cMAGIC ||
+	    header.key != key)
+		return std::nullopt;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size())) return std::nullopt;
+
+	// A binary of an older driver build is rejected by the link status, the caller compiles it again
+	uint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), binary.size());
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glDeleteProgram(program);
+		return std::nullopt;
+	}
+
+	getState().stats.loaded++;
+	return program;
+}
+
+/**
+ * Writes the binary of a compiled program, the program must have been linked with
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ * @param sources The sources of the program in stage order, the defines included
+ * @param program The linked program
+ */
+void ProgramCache::store(const std::vector<const std::string*>& sources, uint program) {
+	getState().stats.compiled++;
+	if (!isEnabled()) return;
+
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!success || length <= 0) return;
+
+	Header header{cMAGIC, 0, getKey(sources), 0};
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.format, binary.data());
+	header.length = written;
+
+	// Written next to the binary and renamed, so a second process never reads a partial file
+	std::string path      = getPath(header.key);
+	std::string writePath = path + ".tmp";
+	{
+		std::ofstream file(writePath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(binary.data(), written);
+		if (!file) {
+			std::cout << "[ProgramCache] Warning: Could not write " << writePath << std::endl;
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(writePath, path, error);
+	if (error) std::remove(writePath.c_str());
+}
+
+/**
+ * Returns the programs loaded from the cache and the programs compiled since the start
+ */
+ProgramCache::Stats ProgramCache::getStats() { return getState().stats; }
+
+/**
+ * Hashes the driver and the sources with FNV-1a, every source is prefixed with its length
+ * so an empty stage still changes the key
+ */
+uint64_t ProgramCache::getKey(const std::vector<const std::string*>& sources) {
+	uint64_t hash             = 0xcbf29ce484222325ull;
+	const std::string& driver = getState().driver;
+	hashBytes(&hash, driver.data(), driver.size());
+	for (const std::string* source : sources) {
+		uint64_t size = source->size();
+		hashBytes(&hash, reinterpret_cast<const char*>(&size), sizeof(size));
+		hashBytes(&hash, source->data(), source->size());
+	}
+	return hash;
+}
+
+std::string ProgramCache::getPath(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(getState().directory) / name).string();
+}
+
+ProgramCache::State& ProgramCache::getState() {
+	static State instance{"", "", false, {0, 0}};
+	return instance;
+}
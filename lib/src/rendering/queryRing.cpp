@@ -0,0 +1,78 @@
+#include "jaroViewer/rendering/queryRing.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the queries
+ * @param target The query type, like GL_FRAGMENT_SHADER_INVOCATIONS
+ * @param queriesPerFrame The amount of queries every frame can run
+ * @param frames The amount of frames a result may take to arrive
+ */
+QueryRing::QueryRing(uint target, uint queriesPerFrame, uint frames)
+  : mTarget(target),
+    mQueriesPerFrame(queriesPerFrame),
+    mFrame(0),
+    mQueries(queriesPerFrame * std::max(1u, frames), 0),
+    mUsed(mQueries.size(), false),
+    mPending(std::max(1u, frames), false) {
+	glGenQueries(mQueries.size(), mQueries.data());
+}
+
+QueryRing::~QueryRing() { glDeleteQueries(mQueries.size(), mQueries.data()); }
+
+void QueryRing::begin(uint query) {
+	uint index = mFrame * mQueriesPerFrame + query;
+	glBeginQuery(mTarget, mQueries.at(index));
+	mUsed.at(index) = true;
+}
+
+void QueryRing::end() { glEndQuery(mTarget); }
+
+/**
+ * Closes the set of this frame and collects the sets the gpu finished
+ */
+void QueryRing::endFrame() {
+	mPending.at(mFrame) = true;
+	mFrame              = (mFrame + 1) % mPending.size();
+	collect();
+
+	// A set that did not arrive in time is dropped
+	mPending.at(mFrame) = false;
+	std::fill_n(mUsed.begin() + mFrame * mQueriesPerFrame, mQueriesPerFrame, false);
+}
+
+/**
+ * Returns the newest complete set of results, a query that did not run in its frame is 0
+ */
+const std::vector<uint64_t>& QueryRing::getResults() const { return mResults; }
+
+void QueryRing::collect() {
+	// Walk from the oldest frame to the newest one, so the newest finished set wins
+	for (uint i = 0; i < mPending.size(); i++) {
+		uint frame = (mFrame + i) % mPending.size();
+		if (!mPending.at(frame)) continue;
+
+		uint base      = frame * mQueriesPerFrame;
+		bool available = true;
+		for (uint q = 0; q < mQueriesPerFrame && available; q++) {
+			if (!mUsed.at(base + q)) continue;
+			GLuint ready = GL_FALSE;
+			glGetQueryObjectuiv(mQueries.at(base + q), GL_QUERY_RESULT_AVAILABLE, &ready);
+			available = ready == GL_TRUE;
+		}
+		if (!available) continue;
+
+		mResults.assign(mQueriesPerFrame, 0);
+		for (uint q = 0; q < mQueriesPerFrame; q++) {
+			if (!mUsed.at(base + q)) continue;
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(mQueries.at(base + q), GL_QUERY_RESULT, &result);
+			mResults.at(q) = result;
+		}
+		mPending.at(frame) = false;
+	}
+}
@@ -1,46 +1,162 @@
 #include "jaroViewer/rendering/shader.hpp"
-#include "jaroViewer/core/tools.hpp"
+#include "jaroViewer/rendering/programCache.hpp"
+#include "jaroViewer/rendering/shaderPreprocessor.hpp"
 
 #include <glad/glad.h>
+#include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <ostream>
+#include <string_view>
 #include <sys/types.h>
 
 using namespace JaroViewer;
 
-Shader::Shader(const ShaderCode& code) {
-	uint vertex = createShaderFromString(GL_VERTEX_SHADER, code.vertexCode.c_str(), "vertex");
-	uint geometry = (code.geometryCode != "") ?
-	  createShaderFromString(GL_GEOMETRY_SHADER, code.geometryCode.c_str(), "geometry") :
-	  0;
-	uint fragment =
-	  createShaderFromString(GL_FRAGMENT_SHADER, code.fragmentCode.c_str(), "fragment");
+namespace {
+	// Same value for the KHR and ARB extension, glad is generated without extensions
+	const uint cCOMPLETIONSTATUS = 0x91B1;
 
-	createProgram(vertex, geometry, fragment);
+	typedef void (*MaxShaderCompilerThreadsFunc)(uint count);
+
+	/**
+	 * Checks for parallel shader compilation and lets the driver pick its compiler threads
+	 */
+	bool detectParallelCompile() {
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count; ++i) {
+			std::string_view name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			const char* function  = nullptr;
+			if (name == "GL_KHR_parallel_shader_compile") function = "glMaxShaderCompilerThreadsKHR";
+			if (name == "GL_ARB_parallel_shader_compile") function = "glMaxShaderCompilerThreadsARB";
+			if (!function) continue;
+
+			auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsFunc>(glfwGetProcAddress(function));
+			if (maxThreads) maxThreads(0xFFFFFFFF);
+			return true;
+		}
+		return false;
+	}
+} // namespace
+
+/**
+ * Creates a program, the compile and link run on the driver threads when it supports
+ * parallel shader compilation
+ * @param code The sources of the stages, an empty geometry source leaves the stage out
+ * @param wait Blocks until the program is linked, otherwise poll isReady before using it
+ */
+Shader::Shader(const ShaderCode& code, bool wait) : mProgramId(0), mLinked(false), mStages(), mSources(), mUniforms(), mBlocks() {
+	std::vector<const std::string*> sources = {&code.vertexCode, &code.geometryCode, &code.fragmentCode};
+	if (std::optional<uint> program = ProgramCache::load(sources)) {
+		mProgramId = *program;
+		mLinked    = true;
+		introspect();
+		return;
+	}
+
+	mProgramId = glCreateProgram();
+	if (ProgramCache::isEnabled()) glProgramParameteri(mProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	compileStage(GL_VERTEX_SHADER, code.vertexCode, "vertex");
+	if (code.geometryCode != "") compileStage(GL_GEOMETRY_SHADER, code.geometryCode, "geometry");
+	compileStage(GL_FRAGMENT_SHADER, code.fragmentCode, "fragment");
+	glLinkProgram(mProgramId);
+
+	mSources = {code.vertexCode, code.geometryCode, code.fragmentCode};
+	if (wait) this->wait();
+}
+
+// The files are read and their includes expanded first, so the cache is keyed on the code
+Shader::Shader(const ShaderPaths& paths, bool wait)
+  : Shader(
+      ShaderCode{
+        ShaderPreprocessor::processFiles(paths.vertexPaths), ShaderPreprocessor::processFiles(paths.geometryPaths),
+        ShaderPreprocessor::processFiles(paths.fragmentPaths)
+      },
+      wait
+    ) {}
+
+Shader::Shader(const ComputeCode& code) : mProgramId(0), mLinked(false), mStages(), mSources(), mUniforms(), mBlocks() {
+	std::vector<const std::string*> sources = {&code.computeCode};
+	if (std::optional<uint> program = ProgramCache::load(sources)) {
+		mProgramId = *program;
+		mLinked    = true;
+		introspect();
+		return;
+	}
+
+	mProgramId = glCreateProgram();
+	if (ProgramCache::isEnabled()) glProgramParameteri(mProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	compileStage(GL_COMPUTE_SHADER, code.computeCode, "compute");
+	glLinkProgram(mProgramId);
+
+	mSources = {code.computeCode};
+	wait();
 }
 
-Shader::Shader(const ShaderPaths& paths) {
-	uint vertex = createShaderFromFile(GL_VERTEX_SHADER, &paths.vertexPaths, "vertex");
-	uint geometry = (paths.geometryPaths.size() > 0) ?
-	  createShaderFromFile(GL_GEOMETRY_SHADER, &paths.geometryPaths, "geometry") :
-	  0;
-	uint fragment = createShaderFromFile(GL_FRAGMENT_SHADER, &paths.fragmentPaths, "fragment");
+/**
+ * Polls the link without blocking when the driver compiles in parallel, without the
+ * extension this waits for the link
+ * @return True once the program is linked or failed to link, the errors are printed then
+ */
+bool Shader::isReady() {
+	if (mStages.empty()) return true;
+	if (hasParallelCompile()) {
+		int done = 0;
+		glGetProgramiv(mProgramId, cCOMPLETIONSTATUS, &done);
+		if (!done) return false;
+	}
+	finishLink();
+	return true;
+}
 
-	createProgram(vertex, geometry, fragment);
+void Shader::wait() {
+	if (!mStages.empty()) finishLink();
 }
 
+/**
+ * Returns if the program linked, only valid once it is ready
+ */
+bool Shader::isLinked() const { return mLinked; }
+
 void Shader::use() const { glUseProgram(mProgramId); }
+
+/**
+ * Sets a uniform of the active program
+ * @param uniform A handle of this shader from getUniform
+ * @param value The value, of the type the handle was resolved with
+ */
+template<typename T>
+void Shader::set(Uniform<T> uniform, const std::type_identity_t<T>& value) const {
+	if (uniform.location < 0) return;
+	if constexpr (std::is_same_v<T, int>) glUniform1i(uniform.location, value);
+	else if constexpr (std::is_same_v<T, float>) glUniform1f(uniform.location, value);
+	else if constexpr (std::is_same_v<T, glm::vec3>) glUniform3fv(uniform.location, 1, glm::value_ptr(value));
+	else if constexpr (std::is_same_v<T, glm::vec4>) glUniform4fv(uniform.location, 1, glm::value_ptr(value));
+	else if constexpr (std::is_same_v<T, glm::mat3>)
+		glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+	else if constexpr (std::is_same_v<T, glm::mat4>)
+		glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template void Shader::set<int>(Uniform<int>, const int&) const;
+template void Shader::set<float>(Uniform<float>, const float&) const;
+template void Shader::set<glm::vec3>(Uniform<glm::vec3>, const glm::vec3&) const;
+template void Shader::set<glm::vec4>(Uniform<glm::vec4>, const glm::vec4&) const;
+template void Shader::set<glm::mat3>(Uniform<glm::mat3>, const glm::mat3&) const;
+template void Shader::set<glm::mat4>(Uniform<glm::mat4>, const glm::mat4&) const;
+
 void Shader::setBool(const std::string& name, bool value) const {
-	glUniform1i(getLocation(name), value);
+	set(getUniform<int>(name), value);
 }
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(getLocation(name), value);
+	set(getUniform<int>(name), value);
 }
 void Shader::setUniformBuffer(const std::string& name, int position) const {
-	uint id = glGetUniformBlockIndex(mProgramId, name.c_str());
-	glUniformBlockBinding(mProgramId, id, position);
+	int index = findResource(mBlocks, name);
+	if (index >= 0) glUniformBlockBinding(mProgramId, index, position);
 }
 
 void Shader::setFloat1(const std::string& name, float x) const {
@@ -57,45 +173,42 @@ void Shader::setFloat4(const std::string& name, float x, float y, float z, float
 }
 
 void Shader::setVec3(const std::string& name, glm::vec3 vec) const {
-	glUniform3fv(getLocation(name), 1, glm::value_ptr(vec));
+	set(getUniform<glm::vec3>(name), vec);
 }
 void Shader::setMat3(const std::string& name, glm::mat3 mat) const {
-	glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(mat));
+	set(getUniform<glm::mat3>(name), mat);
 }
 void Shader::setMat4(const std::string& name, glm::mat4 mat) const {
-	glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(mat));
+	set(getUniform<glm::mat4>(name), mat);
 }
 
-uint Shader::createShaderFromFile(GLenum shaderType, const std::vector<std::string>* sources, const std::string& errorName) {
-	std::string fullFile = "";
-	std::string out;
-	for (size_t i = 0; i < sources->size(); i++) {
-		Tools::readFile(sources->at(i), &out);
-		fullFile += out;
-	}
-	const char* code = fullFile.c_str();
-	return createShaderFromString(shaderType, code, errorName);
+bool Shader::hasParallelCompile() {
+	static const bool supported = detectParallelCompile();
+	return supported;
 }
 
-uint Shader::createShaderFromString(GLenum shaderType, const char* code, const std::string& errorName) {
-	uint id = glCreateShader(shaderType);
-	glShaderSource(id, 1, &code, NULL);
+// Submits the compile of one stage, the status is read when the program is finished
+void Shader::compileStage(uint shaderType, const std::string& code, const char* name) {
+	uint id            = glCreateShader(shaderType);
+	const char* source = code.c_str();
+	glShaderSource(id, 1, &source, NULL);
 	glCompileShader(id);
-	checkCompilingError(id, errorName);
-	return id;
+	glAttachShader(mProgramId, id);
+	mStages.push_back({id, name});
 }
 
-void Shader::createProgram(uint vertexID, uint geometryID, uint fragmentID) {
-	mProgramId = glCreateProgram();
-	glAttachShader(mProgramId, vertexID);
-	if (geometryID != 0) glAttachShader(mProgramId, geometryID);
-	glAttachShader(mProgramId, fragmentID);
-	glLinkProgram(mProgramId);
-	checkLinkingError(mProgramId);
+// Reads the status of the stages and the link, and stores the linked program in the cache
+void Shader::finishLink() {
+	for (const Stage& stage : mStages) checkCompilingError(stage.id, stage.name);
+	mLinked = checkLinkingError(mProgramId);
+	for (const Stage& stage : mStages) glDeleteShader(stage.id);
+	mStages.clear();
+	if (mLinked) introspect();
 
-	glDeleteShader(vertexID);
-	if (geometryID != 0) glDeleteShader(geometryID);
-	glDeleteShader(fragmentID);
+	std::vector<const std::string*> sources;
+	for (const std::string& source : mSources) sources.push_back(&source);
+	ProgramCache::store(sources, mProgramId);
+	mSources.clear();
 }
 
 /**
@@ -108,13 +221,13 @@ void Shader::checkCompilingError(uint shaderID, const std::string& shaderName) c
 	char infoLog[512];
 	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &success);
 	if (!success) {
-		glGetShaderInfoLog(mProgramId, 512, NULL, infoLog);
+		glGetShaderInfoLog(shaderID, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::" << shaderName << "::COMPILATION_ERROR\n"
 		          << infoLog << std::endl;
 	}
 }
 
-void Shader::checkLinkingError(uint programID) const {
+bool Shader::checkLinkingError(uint programID) const {
 	int success;
 	char infoLog[512];
 	glGetProgramiv(programID, GL_LINK_STATUS, &success);
@@ -122,8 +235,63 @@ void Shader::checkLinkingError(uint programID) const {
 		glGetProgramInfoLog(mProgramId, 512, NULL, infoLog);
 		std::cout << "[Shader] Error: Linking failed (" << infoLog << ")" << std::endl;
 	}
+	return success;
 }
 
-GLint Shader::getLocation(const std::string& name) const {
-	return glGetUniformLocation(mProgramId, name.c_str());
+/**
+ * Reads the active uniforms and uniform blocks into the lookup tables. Every element of
+ * an array gets its own entry, the array name without an index is its first element
+ */
+void Shader::introspect() {
+	mUniforms.clear();
+	mBlocks.clear();
+
+	int count = 0;
+	glGetProgramInterfaceiv(mProgramId, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	const GLenum properties[] = {GL_NAME_LENGTH, GL_LOCATION, GL_ARRAY_SIZE};
+	for (int i = 0; i < count; ++i) {
+		int values[3];
+		glGetProgramResourceiv(mProgramId, GL_UNIFORM, i, 3, properties, 3, NULL, values);
+		// Members of uniform blocks have no location
+		if (values[1] < 0) continue;
+
+		std::string name(values[0], '\0');
+		glGetProgramResourceName(mProgramId, GL_UNIFORM, i, values[0], NULL, name.data());
+		name.resize(values[0] - 1);
+		if (!name.ends_with("[0]")) {
+			mUniforms.push_back({name, values[1]});
+			continue;
+		}
+
+		std::string base = name.substr(0, name.size() - 3);
+		mUniforms.push_back({base, values[1]});
+		for (int element = 0; element < values[2]; ++element)
+			mUniforms.push_back({base + "[" + std::to_string(element) + "]", values[1] + element});
+	}
+
+	glGetProgramInterfaceiv(mProgramId, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+	for (int i = 0; i < count; ++i) {
+		const GLenum property = GL_NAME_LENGTH;
+		int length            = 0;
+		glGetProgramResourceiv(mProgramId, GL_UNIFORM_BLOCK, i, 1, &property, 1, NULL, &length);
+		std::string name(length, '\0');
+		glGetProgramResourceName(mProgramId, GL_UNIFORM_BLOCK, i, length, NULL, name.data());
+		name.resize(length - 1);
+		mBlocks.push_back({name, i});
+	}
+
+	auto byName = [](const Resource& a, const Resource& b) { return a.name < b.name; };
+	std::sort(mUniforms.begin(), mUniforms.end(), byName);
+	std::sort(mBlocks.begin(), mBlocks.end(), byName);
 }
+
+int Shader::findResource(const std::vector<Resource>& resources, std::string_view name) {
+	auto found = std::lower_bound(
+	  resources.begin(), resources.end(), name,
+	  [](const Resource& resource, std::string_view name) { return resource.name < name; }
+	);
+	if (found == resources.end() || found->name != name) return -1;
+	return found->index;
+}
+
+GLint Shader::getLocation(std::string_view name) const { return findResource(mUniforms, name); }
@@ -1,35 +1,91 @@
 #include "jaroViewer/rendering/shaderManager.hpp"
 #include "jaroViewer/modifiers/modifier.hpp"
 #include "jaroViewer/rendering/basicShaders.hpp"
+#include "jaroViewer/rendering/shaderPreprocessor.hpp"
 
 #include <sstream>
 
 using namespace JaroViewer;
 
-ShaderManager::ShaderManager() : mPathToIdent(), mShaders(), mActiveShader(0) {
-	loadShader(ShaderCode{basicWhiteVertex, "", basicWhiteFragment});
-	loadShader(ShaderCode{Modifier::getVertexLibrary() + regionVertex, "", regionFragment});
-	loadShader(ShaderCode{Modifier::getVertexLibrary() + basicVertex, "", fragmentLibrary + basicFragment});
+namespace {
+	// Puts the defines right after the version line, where glsl allows them
+	std::string insertDefines(const std::string& code, const std::string& defines) {
+		if (code.empty() || defines.empty()) return code;
+		if (code.starts_with(shaderVersion)) return shaderVersion + defines + code.substr(shaderVersion.size());
+		return defines + code;
+	}
+} // namespace
+
+// The white shader is the fallback and the only one waited for, the others link while the scene loads
+ShaderManager::ShaderManager() : mSourceToIdent(), mShaders(), mReady(), mActiveShader(0) {
+	addShader(Shader(ShaderCode{basicWhiteVertex, "", basicWhiteFragment}));
+	isReady(PredefinedShader::WHITE);
+	loadVariantSource({regionVertex, "", regionFragment, false, false});
+	loadVariantSource({basicVertex, "", fragmentLibrary + basicFragment, true, true});
+	loadVariantSource({basicVertex, "", geometryFragment, false, true});
+	loadVariantSource({depthVertex, "", depthFragment, false, false});
+	loadVariantSource({pointShadowVertex, pointShadowGeometry, pointShadowFragment, false, false});
+	loadVariantSource({bakedVertex, "", fragmentLibrary + bakedFragment, true, true});
 	mShaders.at(0).use();
 }
 
+/**
+ * Expands the includes of the code and compiles it, code that expands to a loaded shader
+ * returns that shader
+ */
 uint ShaderManager::loadShader(const ShaderCode& codes) {
-	mShaders.push_back(Shader(codes));
-	mShaders.back().setUniformBuffer("Transformation", 0);
-	mShaders.back().setUniformBuffer("LightSet", 1);
-	return mShaders.size() - 1;
+	std::string vertex   = ShaderPreprocessor::process(codes.vertexCode);
+	std::string geometry = ShaderPreprocessor::process(codes.geometryCode);
+	std::string fragment = ShaderPreprocessor::process(codes.fragmentCode);
+	return addUniqueShader(vertex, geometry, fragment);
 }
 
+/**
+ * Reads the files and compiles them, files that expand to the code of a loaded shader
+ * return that shader, also under other paths
+ */
 uint ShaderManager::loadShader(const ShaderPaths& paths) {
-	std::string key = pathsToKey(paths);
-	if (mPathToIdent.contains(key)) return mPathToIdent.at(key);
-	mShaders.push_back(Shader(paths));
-	mShaders.back().setUniformBuffer("Transformation", 0);
-	mShaders.back().setUniformBuffer("LightSet", 1);
-
-	uint ident        = mShaders.size() - 1;
-	mPathToIdent[key] = ident;
-	return ident;
+	std::string vertex   = ShaderPreprocessor::processFiles(paths.vertexPaths);
+	std::string geometry = ShaderPreprocessor::processFiles(paths.geometryPaths);
+	std::string fragment = ShaderPreprocessor::processFiles(paths.fragmentPaths);
+	return addUniqueShader(vertex, geometry, fragment);
+}
+
+/**
+ * Finds the shader to draw with for a set of features. The variant is compiled the first
+ * time, until it is linked the shader with the default features is used, and until that
+ * is linked the white shader
+ * @param ident A shader, only the built-in shaders have variants
+ * @return A linked shader, the variant once it is ready
+ */
+uint ShaderManager::getVariant(uint ident, const ShaderFeatures& features) {
+	uint variant = findVariant(ident, features);
+	if (isUsable(variant)) return variant;
+	if (isUsable(ident)) return ident;
+
+	// The white shader would write wrong ids or miss the layers, so these passes wait
+	auto source = mVariantSources.find(ident);
+	if (source != mVariantSources.end() && !source->second.fallback) {
+		mShaders.at(ident).wait();
+		isReady(ident);
+		return ident;
+	}
+	return PredefinedShader::WHITE;
+}
+
+/**
+ * Returns if a shader finished linking, polls the driver without blocking when it compiles in parallel
+ * @param ident The shader
+ */
+bool ShaderManager::isReady(uint ident) {
+	if (mReady.at(ident)) return true;
+	Shader& shader = mShaders.at(ident);
+	if (!shader.isReady()) return false;
+
+	shader.setUniformBuffer("Transformation", 0);
+	shader.setUniformBuffer("LightSet", 1);
+	mReady[ident] = true;
+	return true;
 }
 
 Shader* ShaderManager::getShader(uint ident) {
@@ -44,10 +100,66 @@ bool ShaderManager::activateShader(uint ident) {
 	return true;
 }
 
-std::string ShaderManager::pathsToKey(const ShaderPaths& paths) const {
-	std::stringstream output;
-	for (auto& path : paths.vertexPaths) output << "|" << path;
-	for (auto& path : paths.geometryPaths) output << "|" << path;
-	for (auto& path : paths.fragmentPaths) output << "|" << path;
-	return output.str();
+/**
+ * Forgets the active shader, needed after a program was bound outside the manager
+ */
+void ShaderManager::resetActiveShader() { mActiveShader = mShaders.size(); }
+
+// Compiles the variant with the default features under the ident of the shader
+uint ShaderManager::loadVariantSource(const VariantSource& source) {
+	uint ident = addShader(Shader(
+	  ShaderCode{Modifier::getVertexLibrary() + source.vertex, source.geometry, source.fragment}, false
+	));
+	mVariantSources[ident] = source;
+	return ident;
+}
+
+// Submits the variant the first time it is asked for, the shader itself when it has no variants
+uint ShaderManager::findVariant(uint ident, const ShaderFeatures& features) {
+	auto source = mVariantSources.find(ident);
+	if (source == mVariantSources.end()) return ident;
+
+	ShaderFeatures key = features;
+	if (!source->second.lit) {
+		key.numDirLights = ShaderFeatures{}.numDirLights;
+		key.shadows      = ShaderFeatures{}.shadows;
+	}
+	if (key == ShaderFeatures{}) return ident;
+	auto variant = mVariants.find({ident, key});
+	if (variant != mVariants.end()) return variant->second;
+
+	std::stringstream defines;
+	if (key.numDirLights >= 0) defines << "#define NUMDIRLIGHTS " << key.numDirLights << "\n";
+	if (!key.shadows) defines << "#define SHADOWS 0\n";
+
+	const VariantSource& code = source->second;
+	std::string vertex   = insertDefines(Modifier::getVertexLibrary(key.modifiers) + code.vertex, defines.str());
+	std::string geometry = insertDefines(code.geometry, defines.str());
+	std::string fragment = insertDefines(code.fragment, defines.str());
+	uint compiled        = addShader(Shader(ShaderCode{vertex, geometry, fragment}, false));
+	mVariants[{ident, key}] = compiled;
+	return compiled;
+}
+
+bool ShaderManager::isUsable(uint ident) { return isReady(ident) && mShaders.at(ident).isLinked(); }
+
+uint ShaderManager::addShader(Shader&& shader) {
+	mShaders.push_back(std::move(shader));
+	mReady.push_back(false);
+	return mShaders.size() - 1;
+}
+
+// The expanded code is the key, so it matches the key of the program cache
+uint ShaderManager::addUniqueShader(
+  const std::string& vertex,
+  const std::string& geometry,
+  const std::string& fragment
+) {
+	std::string key = vertex + '\0' + geometry + '\0' + fragment;
+	auto loaded     = mSourceToIdent.find(key);
+	if (loaded != mSourceToIdent.end()) return loaded->second;
+
+	uint ident          = addShader(Shader(ShaderCode{vertex, geometry, fragment}, false));
+	mSourceToIdent[key] = ident;
+	return ident;
 }
@@ -0,0 +1,221 @@
+#include "jaroViewer/rendering/shaderPreprocessor.hpp"
+#include "jaroViewer/core/mappedFile.hpp"
+#include "jaroViewer/modifiers/modifier.hpp"
+#include "jaroViewer/rendering/basicShaders.hpp"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+
+using namespace JaroViewer;
+namespace fs = std::filesystem;
+
+namespace {
+	struct CachedFile {
+		fs::file_time_type time;
+		uintmax_t size;
+		std::shared_ptr<const MappedFile> file;
+	};
+
+	/**
+	 * Maps a file, the mapping is reused until the modification time or size changes
+	 * @param path The canonical path, the key of the cache
+	 * @return The mapping, nullptr when the file can not be read
+	 */
+	std::shared_ptr<const MappedFile>
+	  mapFile(const std::string& path, std::unordered_map<std::string, CachedFile>* files) {
+		std::error_code error;
+		fs::file_time_type time = fs::last_write_time(path, error);
+		if (error) return nullptr;
+		uintmax_t size = fs::file_size(path, error);
+		if (error) return nullptr;
+
+		auto cached = files->find(path);
+		if (cached != files->end() && cached->second.time == time && cached->second.size == size)
+			return cached->second.file;
+
+		auto file = std::make_shared<const MappedFile>(path);
+		if (!file->isOpen()) return nullptr;
+		(*files)[path] = {time, size, file};
+		return file;
+	}
+
+	// The text after the # of a preprocessor line without surrounding whitespace, empty otherwise
+	std::string_view getDirective(std::string_view line) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string_view::npos || line[start] != '#') return {};
+		line  = line.substr(start + 1);
+		start = line.find_first_not_of(" \t");
+		if (start == std::string_view::npos) return {};
+		line = line.substr(start);
+		return line.substr(0, line.find_last_not_of(" \t\r") + 1);
+	}
+
+	/**
+	 * The built-in libraries, the vertex library has the modifiers that are registered when
+	 * it is included
+	 */
+	std::map<std::string, ShaderPreprocessor::Provider> getBuiltinFiles() {
+		const std::string frame    = "#include <jaroViewer/frame.glsl>\n";
+		const std::string draw     = "#include <jaroViewer/draw.glsl>\n";
+		const std::string lights   = "#include <jaroViewer/lights.glsl>\n";
+		const std::string material = "#include <jaroViewer/material.glsl>\n";
+
+		std::map<std::string, ShaderPreprocessor::Provider> files;
+		files["jaroViewer/frame.glsl"]    = [] { return frameBlock; };
+		files["jaroViewer/draw.glsl"]     = [] { return drawLibrary; };
+		files["jaroViewer/material.glsl"] = [] { return materialLibrary; };
+		files["jaroViewer/lights.glsl"]   = [] { return lightLibrary; };
+		files["jaroViewer/vertex.glsl"] = [=] {
+			return frame + draw + instanceInputs + vertexFunctions + Modifier::getModifierLibrary();
+		};
+		files["jaroViewer/fragment.glsl"] = [=] { return frame + draw + material + lights + surfaceLibrary; };
+		return files;
+	}
+
+	std::string canonicalPath(const fs::path& path) {
+		std::error_code error;
+		fs::path canonical = fs::weakly_canonical(path, error);
+		return (error ? path : canonical).string();
+	}
+} // namespace
+
+struct ShaderPreprocessor::State {
+	std::map<std::string, Provider> virtualFiles;
+	std::unordered_map<std::string, CachedFile> files;
+};
+
+/**
+ * Adds a virtual file or replaces it, included with #include <name> before any file on disk
+ * @param name The name in the include, jaroViewer/ is used by the built-in libraries
+ * @param source The glsl code, a #version in it is left out when it is included
+ */
+void ShaderPreprocessor::setVirtualFile(const std::string& name, const std::string& source) {
+	getState().virtualFiles[name] = [source] { return source; };
+}
+
+/**
+ * Adds a virtual file whose code is built every time it is included
+ * @param provider Returns the glsl code, called once per stage that includes it
+ */
+void ShaderPreprocessor::setVirtualFile(const std::string& name, Provider provider) {
+	getState().virtualFiles[name] = std::move(provider);
+}
+
+/**
+ * Expands the includes of a source in memory, quoted includes are relative to the working
+ * directory
+ * @param source The glsl code of one stage
+ * @return The code with every include replaced by the file, or left out when it was already included
+ */
+std::string ShaderPreprocessor::process(const std::string& source) {
+	if (source.find("include") == std::string::npos) return source;
+	std::set<std::string> included;
+	std::string out;
+	out.reserve(source.size());
+	expand(source, fs::current_path(), true, &included, &out);
+	return out;
+}
+
+/**
+ * Reads the files of one stage in order and expands their includes
+ * @param paths The files, the first one has the #version line
+ * @return The code of the stage, a file that can not be read is left out
+ */
+std::string ShaderPreprocessor::processFiles(const std::vector<std::string>& paths) {
+	State& state = getState();
+	std::set<std::string> included;
+	std::string out;
+	for (const std::string& file : paths) {
+		std::string path = canonicalPath(file);
+		std::shared_ptr<const MappedFile> mapped = mapFile(path, &state.files);
+		if (!mapped) {
+			std::cout << "[ShaderPreprocessor] Error: Couldn't read " << file << std::endl;
+			continue;
+		}
+		included.insert(path);
+		expand(mapped->getView(), fs::path(path).parent_path(), true, &included, &out);
+	}
+	return out;
+}
+
+/**
+ * Copies a source line by line into the output and expands its includes
+ * @param directory The directory quoted includes are looked up in first
+ * @param root Keeps the #version line, it is dropped from included files
+ * @param included The files of the stage so far, canonical paths and <name> for virtual files
+ */
+void ShaderPreprocessor::expand(
+  std::string_view source,
+  const fs::path& directory,
+  bool root,
+  std::set<std::string>* included,
+  std::string* out
+) {
+	size_t begin = 0;
+	while (begin < source.size()) {
+		size_t end = source.find('\n', begin);
+		if (end == std::string_view::npos) end = source.size();
+		std::string_view line = source.substr(begin, end - begin);
+		begin                 = end + 1;
+
+		std::string_view directive = getDirective(line);
+		if (directive.starts_with("include")) {
+			size_t nameBegin = directive.find_first_of("\"<");
+			bool angled      = nameBegin != std::string_view::npos && directive[nameBegin] == '<';
+			size_t nameEnd   = nameBegin == std::string_view::npos
+			    ? std::string_view::npos
+			    : directive.find(angled ? '>' : '"', nameBegin + 1);
+			if (nameEnd == std::string_view::npos) {
+				std::cout << "[ShaderPreprocessor] Error: Malformed " << line << std::endl;
+				continue;
+			}
+			include(directive.substr(nameBegin + 1, nameEnd - nameBegin - 1), angled, directory, included, out);
+			continue;
+		}
+		if (directive == "pragma once") continue;
+		if (!root && directive.starts_with("version")) continue;
+
+		out->append(line);
+		out->push_back('\n');
+	}
+}
+
+/**
+ * Expands one include, angled includes prefer the virtual files and quoted includes the
+ * file next to the including file
+ */
+void ShaderPreprocessor::include(
+  std::string_view name,
+  bool angled,
+  const fs::path& directory,
+  std::set<std::string>* included,
+  std::string* out
+) {
+	State& state     = getState();
+	auto virtualFile = state.virtualFiles.find(std::string(name));
+	fs::path local   = directory / name;
+	std::error_code error;
+	if (virtualFile != state.virtualFiles.end() && (angled || !fs::exists(local, error))) {
+		if (!included->insert("<" + virtualFile->first + ">").second) return;
+		expand(virtualFile->second(), fs::path(), false, included, out);
+		return;
+	}
+
+	std::string path = canonicalPath(local);
+	if (included->contains(path)) return;
+	std::shared_ptr<const MappedFile> mapped = mapFile(path, &state.files);
+	if (!mapped) {
+		std::cout << "[ShaderPreprocessor] Error: Couldn't find include " << name << std::endl;
+		return;
+	}
+	included->insert(path);
+	expand(mapped->getView(), fs::path(path).parent_path(), false, included, out);
+}
+
+ShaderPreprocessor::State& ShaderPreprocessor::getState() {
+	static State instance{getBuiltinFiles(), {}};
+	return instance;
+}
@@ -0,0 +1,58 @@
+#include "jaroViewer/rendering/storageBuffer.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+using namespace JaroViewer;
+
+/**
+ * Creates the buffer and binds it
+ * @param position The binding point of the storage block
+ * @param size The initial size in bytes
+ */
+StorageBuffer::StorageBuffer(uint position, size_t size) : mPosition(position), mSize(0), mID(0) {
+	create(std::max<size_t>(size, 16));
+}
+
+StorageBuffer::~StorageBuffer() { glDeleteBuffers(1, &mID); }
+
+/**
+ * Makes sure the buffer holds at least the given amount of bytes, a larger buffer
+ * does not keep the old data
+ * @param size The amount of bytes needed
+ * @return True if the buffer was recreated and has to be filled again
+ */
+bool StorageBuffer::reserve(size_t size) {
+	if (size <= mSize) return false;
+	size_t newSize = mSize;
+	while (newSize < size) newSize *= 2;
+	create(newSize);
+	return true;
+}
+
+/**
+ * Copies a part of another buffer into the storage buffer on the gpu
+ * @param buffer The buffer to copy from
+ * @param bufferOffset The offset in bytes in the source buffer
+ * @param offset The offset in bytes in the storage buffer
+ * @param size The amount of bytes
+ */
+void StorageBuffer::copyFromBuffer(uint buffer, size_t bufferOffset, size_t offset, size_t size) {
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mID);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, bufferOffset, offset, size);
+}
+
+size_t StorageBuffer::getSize() const { return mSize; }
+uint StorageBuffer::getID() const { return mID; }
+
+void StorageBuffer::create(size_t size) {
+	if (mID != 0) glDeleteBuffers(1, &mID);
+	mSize = size;
+	glGenBuffers(1, &mID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mSize, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mPosition, mID);
+}
@@ -19,3 +19,16 @@ void UniformBuffer::updateData(const void* data) {
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, mSize, data);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
+
+/**
+ * Copies a part of another buffer into the uniform buffer on the gpu
+ * @param buffer The buffer to copy from
+ * @param bufferOffset The offset in bytes in the source buffer
+ * @param offset The offset in bytes in the uniform buffer
+ * @param size The amount of bytes
+ */
+void UniformBuffer::copyFromBuffer(uint buffer, size_t bufferOffset, size_t offset, size_t size) {
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mID);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, bufferOffset, offset, size);
+}
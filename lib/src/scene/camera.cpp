@@ -43,13 +43,14 @@ void Camera::addControls(InputHandler& handler) {
 	});
 
 	// Set focus keys
-	handler.addKey(GLFW_KEY_ESCAPE, InputHandler::KeyAction::DOWN, [=](InputParams) {
-		if (handler.getWindow()->getMouseMode() == GLFW_CURSOR_DISABLED)
-			handler.getWindow()->setMouseMode(GLFW_CURSOR_NORMAL);
+	Window* window = handler.getWindow();
+	handler.addKey(GLFW_KEY_ESCAPE, InputHandler::KeyAction::DOWN, [window](InputParams) {
+		if (window->getMouseMode() == GLFW_CURSOR_DISABLED)
+			window->setMouseMode(GLFW_CURSOR_NORMAL);
 	});
-	handler.addKey(GLFW_KEY_C, InputHandler::KeyAction::PRESS, [=](InputParams) {
-		if (handler.getWindow()->getMouseMode() == GLFW_CURSOR_NORMAL)
-			handler.getWindow()->setMouseMode(GLFW_CURSOR_DISABLED);
+	handler.addKey(GLFW_KEY_C, InputHandler::KeyAction::PRESS, [window](InputParams) {
+		if (window->getMouseMode() == GLFW_CURSOR_NORMAL)
+			window->setMouseMode(GLFW_CURSOR_DISABLED);
 	});
 }
 
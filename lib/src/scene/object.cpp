@@ -14,7 +14,8 @@ RawObject::RawObject(glm::vec3 minPoint, glm::vec3 maxPoint)
     mTranslation(0.0f),
     mRotation(glm::identity<glm::quat>()),
     mScale(1.0f),
-    mVisibility(true) {}
+    mVisibility(true),
+    mMaterial(0) {}
 
 RawObject::RawObject(RawObject&& other) noexcept
   : EventSender<RawObject, ObjectEvent>(std::move(other)),
@@ -25,9 +26,14 @@ RawObject::RawObject(RawObject&& other) noexcept
     mRotation(other.mRotation),
     mScale(other.mScale),
     mVisibility(other.mVisibility),
+    mMaterial(other.mMaterial),
     mModifiers(std::move(other.mModifiers)) {}
 
-RawObject::~RawObject() { send(this, ObjectEvent::DELETE); }
+/**
+ * Does not notify the listeners, the last reference may be dropped on any thread. The
+ * object manager finds the slot of a dropped object expired and reuses it
+ */
+RawObject::~RawObject() = default;
 
 void RawObject::setVisibility(bool visibility) {
 	mVisibility = visibility;
@@ -36,6 +42,19 @@ void RawObject::setVisibility(bool visibility) {
 
 bool RawObject::getVisibility() const { return mVisibility; }
 
+/**
+ * Draws the object with another material than its model, the object stays in the
+ * instanced draws of the model. Meshes of the model all use the first texture set
+ * of the material
+ * @param material The material ident of the MaterialManager, 0 uses the material of the model
+ */
+void RawObject::setMaterial(uint material) {
+	mMaterial = material;
+	send(this, ObjectEvent::MATERIAL);
+}
+
+uint RawObject::getMaterial() const { return mMaterial; }
+
 /**
  * Returns the model matrix with all the transformations for this component
  */
@@ -55,6 +74,8 @@ glm::vec3 RawObject::getEulerAngles() const {
 
 glm::quat RawObject::getQuaternion() const { return mRotation; }
 
+glm::vec3 RawObject::getScale() const { return mScale; }
+
 void RawObject::addChild(Object child) { mChildren.push_back(child); }
 
 void RawObject::removeChild(Object child) {
@@ -187,10 +208,14 @@ void RawObject::addModifier(std::shared_ptr<Modifier> modifier) {
 }
 
 ModifierStack RawObject::getStack() const {
-	ModifierStack stack{(uint)this->mModifiers.size(), {}};
+	ModifierStack stack{(uint)this->mModifiers.size(), {}, 0};
 	for (auto& modifier : this->mModifiers) {
 		std::vector<float> params = modifier->getParams();
 		stack.params.insert(stack.params.end(), params.begin(), params.end());
+
+		// The first parameter is the ident the vertex shader switches on
+		uint ident   = params.empty() ? 64 : (uint)params.front();
+		stack.types |= (ident < 64) ? 1ull << ident : ~0ull;
 	}
 	return stack;
 }
@@ -1,25 +1,132 @@
 #include "jaroViewer/scene/objectManager.hpp"
 #include "jaroViewer/core/tools.hpp"
 #include "jaroViewer/rendering/gpuVector.hpp"
+#include "jaroViewer/rendering/queryRing.hpp"
 #include "jaroViewer/rendering/shaderManager.hpp"
 #include "jaroViewer/scene/object.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
 #include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <thread>
 #include <variant>
 
 using namespace JaroViewer;
 
-ObjectManager::ObjectManager() : mModels(), mShaderManager() {
+namespace {
+	// Vertex buffer binding points of the mesh vaos
+	const uint cVERTEXBINDING   = 0;
+	const uint cLIGHTMAPBINDING = 2;
+
+	// Storage blocks of the shadow faces, the draw parameters and the instances
+	const uint cSHADOWFACESBINDING = 5;
+	const uint cDRAWPARAMSBINDING  = 9;
+	const uint cINSTANCESBINDING   = 10;
+
+	// Texture unit of the lightmap, the materials start at unit 1
+	const uint cLIGHTMAPUNIT = 13;
+
+	// The jobs add the time they spend in a phase, so a phase reports its cpu time over all threads
+	using Clock = std::chrono::steady_clock;
+
+	void addTime(std::atomic<int64_t>& total, Clock::time_point start, Clock::time_point end) {
+		total += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	float toSeconds(const std::atomic<int64_t>& total) { return total * 1e-9f; }
+
+	// The shaders that light a model like the basic shader, baked models fall back to it
+	bool isLitShader(uint shader) {
+		return shader == PredefinedShader::BASIC || shader == PredefinedShader::BAKED;
+	}
+
+	// FNV-1a, used to notice when the shadow casters of a volume change
+	const uint64_t cHASHBASIS = 14695981039346656037ull;
+	const uint64_t cHASHPRIME = 1099511628211ull;
+
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * cHASHPRIME;
+		return hash;
+	}
+
+	/**
+	 * Calls func with every visible instance of a model and its model matrix, instances
+	 * that are in both snapshots are interpolated
+	 * @param previous The model in the older snapshot, nullptr if it was not there
+	 * @param current The model in the newest snapshot
+	 * @param alpha The interpolation factor between the snapshots
+	 * @param visible Tells from the world space bounds if an instance is visible
+	 */
+	template <typename Visible, typename Func>
+	void forEachInstance(
+	  const ModelSnapshot* previous,
+	  const ModelSnapshot& current,
+	  float alpha,
+	  Visible visible,
+	  Func func
+	) {
+		size_t j = 0;
+		for (const InstanceSnapshot& ins : current.instances) {
+			glm::vec3 translation = ins.translation;
+			glm::quat rotation    = ins.rotation;
+			glm::vec3 scale       = ins.scale;
+			glm::vec3 boundsMin   = ins.boundsMin;
+			glm::vec3 boundsMax   = ins.boundsMax;
+
+			// Both lists are sorted on slot, so the matching instance is found by walking along.
+			// Instances that did not move keep their exact matrix, the shadow caching relies on it
+			if (previous && alpha < 1.0f) {
+				const std::vector<InstanceSnapshot>& prev = previous->instances;
+				while (j < prev.size() && prev[j].slot < ins.slot) j++;
+				if (j < prev.size() && prev[j].slot == ins.slot && prev[j].generation == ins.generation &&
+				    (prev[j].translation != ins.translation || prev[j].rotation != ins.rotation ||
+				     prev[j].scale != ins.scale)) {
+					translation = glm::mix(prev[j].translation, ins.translation, alpha);
+					rotation    = glm::slerp(prev[j].rotation, ins.rotation, alpha);
+					scale       = glm::mix(prev[j].scale, ins.scale, alpha);
+					boundsMin   = glm::min(boundsMin, prev[j].boundsMin);
+					boundsMax   = glm::max(boundsMax, prev[j].boundsMax);
+				}
+			}
+			if (!visible(boundsMin, boundsMax)) continue;
+
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), translation);
+			matrix *= glm::mat4_cast(rotation);
+			matrix = glm::scale(matrix, scale);
+			func(ins, matrix);
+		}
+	}
+} // namespace
+
+ObjectManager::ObjectManager(JobSystem* jobs)
+  : mModels(),
+    mModelHandles(),
+    mJobs(jobs),
+    mShaderManager(),
+    mMaterialManager(jobs),
+    mDepthPrePass(false),
+    mLightmapTexture(),
+    mFrameDraws(),
+    mDrawParams(),
+    mDrawCommands(),
+    mRefitTime(0.0f),
+    mCullTime(0.0f),
+    mPackTime(0.0f),
+    mGlThread(std::this_thread::get_id()) {
 	mImporter = std::make_shared<Assimp::Importer>();
 }
 
@@ -27,12 +134,20 @@ MaterialManager* ObjectManager::getMaterialManager() {
 	return &mMaterialManager;
 }
 
-void ObjectManager::registerModel(
+/**
+ * Registers a model from raw vertex data. Creates gl objects and grows the models the
+ * renderer walks, so only the thread that created the manager may call it. With the
+ * simulation thread models are registered before the engine starts
+ * @param ident The name of the model, only used to look up the handle
+ * @return The handle to create objects with, empty if the name was taken
+ */
+std::optional<ModelHandle> ObjectManager::registerModel(
   const std::string& ident,
   const std::vector<float>& vertices,
   ShaderParams shaderParams,
   uint material
 ) {
+	assert(std::this_thread::get_id() == mGlThread && "Models are registered on the gl thread");
 	uint shaderIdent = std::visit(
 	  Tools::Overloaded{
 	    [&](const ShaderCode& codes) { return mShaderManager.loadShader(codes); },
@@ -41,17 +156,31 @@ void ObjectManager::registerModel(
 	  },
 	  shaderParams
 	);
-	if (mModels.contains(ident)) {
+	if (mModelHandles.contains(ident)) {
 		std::cerr << "[Object Manager] Error: Already a model with iden \'" + ident + "\'"
 		          << std::endl;
-		return;
+		return std::nullopt;
 	}
-	Mesh mesh = registerVerticesModel(vertices, material);
-	mModels[ident] =
-	  ModelState(std::vector<Mesh>{mesh}, false, shaderIdent, GpuVector(), {});
+	Mesh mesh          = createMesh(vertices, {}, material);
+	ModelHandle handle = mModels.size();
+	mModels.push_back(ModelState{.meshes = {mesh}, .shader = shaderIdent});
+	uploadModel(mModels.back());
+	updateModelBounds(mModels.back());
+	mModelHandles[ident] = handle;
+	return handle;
 }
 
-void ObjectManager::registerModel(const std::string& ident, const std::string& modelPath, ShaderParams shaderParams) {
+/**
+ * Registers a model from a model file
+ * @param ident The name of the model, only used to look up the handle
+ * @return The handle to create objects with, empty if loading failed
+ */
+std::optional<ModelHandle> ObjectManager::registerModel(
+  const std::string& ident,
+  const std::string& modelPath,
+  ShaderParams shaderParams
+) {
+	assert(std::this_thread::get_id() == mGlThread && "Models are registered on the gl thread");
 	uint shaderIdent = std::visit(
 	  Tools::Overloaded{
 	    [&](const ShaderCode& codes) { return mShaderManager.loadShader(codes); },
@@ -60,274 +189,910 @@ void ObjectManager::registerModel(const std::string& ident, const std::string& m
 	  },
 	  shaderParams
 	);
-	registerFileModel(ident, modelPath, shaderIdent);
+	return registerFileModel(ident, modelPath, shaderIdent);
 }
 
-Object ObjectManager::createObject(const std::string& model) {
+std::optional<ModelHandle> ObjectManager::getModelHandle(const std::string& ident) const {
+	auto handle = mModelHandles.find(ident);
+	if (handle == mModelHandles.end()) return std::nullopt;
+	return handle->second;
+}
 
-	// Check if valid model and find the index to work with
-	if (!mModels.contains(model)) {
+Object ObjectManager::createObject(const std::string& model) {
+	std::optional<ModelHandle> handle = getModelHandle(model);
+	if (!handle.has_value()) {
 		std::cerr
 		  << "[Object Manager] Error: Tried to create object with unknown model \'"
 		  << model << "\'" << std::endl;
 		return nullptr;
 	}
-	ModelState& state  = mModels.at(model);
-	glm::vec3 minPoint = glm::vec3(std::numeric_limits<float>().max());
-	glm::vec3 maxPoint = glm::vec3(std::numeric_limits<float>().lowest());
-	for (auto& mesh : state.meshes) {
-		minPoint = glm::min(minPoint, mesh.minPoint);
-		maxPoint = glm::max(maxPoint, mesh.maxPoint);
+	return createObject(handle.value());
+}
+
+Object ObjectManager::createObject(ModelHandle model) {
+	if (model >= mModels.size()) {
+		std::cerr << "[Object Manager] Error: Tried to create object with unknown model handle "
+		          << model << std::endl;
+		return nullptr;
 	}
-	Object obj   = std::make_shared<RawObject>(minPoint, maxPoint);
-	size_t index = getNextFreeSlot(model);
+	ModelState& state = mModels.at(model);
+	Object obj        = std::make_shared<RawObject>(state.minPoint, state.maxPoint);
+	size_t index      = getNextFreeSlot(model);
 
-	// Create the instance
-	if (index == mModels.at(model).instances.size()) {
-		mModels.at(model).instances.push_back(Instance{obj, obj->getModelMatrix(), 0, 0});
+	// Create the instance, a reused slot keeps its journal entry if it still has one
+	if (index == state.instances.size()) {
+		state.instances.push_back(Instance{});
 	} else {
-		Instance& instance     = mModels.at(model).instances.at(index);
-		instance.object        = obj;
-		instance.model         = obj->getModelMatrix();
-		instance.modifierStart = 0;
-		instance.modifierCount = 0;
-	}
-
-	// Link all events
-	obj->addListener([this, model, index](RawObject* obj, ObjectEvent event) {
-		switch (event) {
-		case ObjectEvent::MODIFIER:
-			this->updateModifierTex(obj->getStack(), model, index);
-			break;
-		case ObjectEvent::TRANSFORM:
-			this->mModels.at(model).instances.at(index).model = obj->getModelMatrix();
-			break;
-		default: break;
-		}
+		releaseModifierRange(state, state.instances.at(index));
+		state.instances.at(index).generation++;
+	}
+	Instance& instance         = state.instances.at(index);
+	instance.object            = obj;
+	instance.modifierStart     = 0;
+	instance.modifierCount     = 0;
+	instance.modifierSize      = 0;
+	instance.visible           = obj->getVisibility();
+	instance.material          = obj->getMaterial();
+	instance.lightmapRect      = glm::vec4(0.0f);
+	instance.transformChanged  = false;
+	instance.modifierChanged   = false;
+	instance.visibilityChanged = false;
+	instance.materialChanged   = false;
+	refitInstance(state, instance, *obj);
+
+	// Changes are journaled and applied once per update in applyChanges. The object does
+	// not send anything when it is destructed, so the listener only runs on the scene thread
+	obj->addListener([this, model, index](RawObject* sender, ObjectEvent event) {
+		this->recordChange(model, index, sender, event);
 	});
 
 	return obj;
 }
 
-void ObjectManager::renderObjects(bool usingPostProcessor, const glm::vec3& viewPos) {
-	if (usingPostProcessor) mMaterialManager.resetLastShader();
-	for (auto& model : mModels) {
-		ModelState& state = model.second;
+/**
+ * Removes an object from the scene, its slot is free even when the object is still referenced.
+ * Dropping the last reference removes it as well, its modifier data is then released when
+ * the slot is reused
+ * @param obj The object to remove
+ */
+void ObjectManager::destroyObject(const Object& obj) {
+	if (obj) obj->send(obj.get(), ObjectEvent::DELETE);
+}
 
-		std::vector<InstanceData> data;
-		for (auto& instance : state.instances) {
-			if (instance.object.expired()) continue;
-			Object obj = instance.object.lock();
-			if (!obj->getVisibility()) continue;
-			data.push_back(
-			  {instance.model, Tools::getNormalModelMatrix(instance.model),
-			   instance.modifierStart, instance.modifierCount}
-			);
+/**
+ * Drains the change journal, every changed object gets its matrices rebuilt
+ * and its modifier stack repacked once, no matter how often it was changed.
+ * Every slot has at most one journal entry, so the matrices and bounds are
+ * refitted on all threads, the modifier data is shared per model and stays serial.
+ * Models with changed modifier data publish a new version of it for the renderer
+ */
+void ObjectManager::applyChanges() {
+	std::atomic<int64_t> refitTime{0};
+	mJobs->parallelFor(mChanges.size(), 64, [this, &refitTime](size_t begin, size_t end) {
+		Clock::time_point start = Clock::now();
+		for (size_t i = begin; i < end; ++i) {
+			ModelState& state = mModels[mChanges[i].model];
+			Instance& ins     = state.instances[mChanges[i].index];
+			Object obj        = ins.object.lock();
+			if (!obj) continue;
+			if (ins.transformChanged) refitInstance(state, ins, *obj);
+			if (ins.visibilityChanged) ins.visible = obj->getVisibility();
+			if (ins.materialChanged) ins.material = obj->getMaterial();
 		}
+		addTime(refitTime, start, Clock::now());
+	});
+	mRefitTime = toSeconds(refitTime);
+
+	for (const ObjectChange& change : mChanges) {
+		ModelState& state = mModels[change.model];
+		Instance& ins     = state.instances[change.index];
+		bool modifier     = ins.modifierChanged;
+
+		ins.queued            = false;
+		ins.transformChanged  = false;
+		ins.modifierChanged   = false;
+		ins.visibilityChanged = false;
+		ins.materialChanged   = false;
+		if (modifier && !ins.object.expired())
+			updateModifierTex(ins.object.lock()->getStack(), state, ins);
+	}
+	mChanges.clear();
+
+	for (ModelState& state : mModels) {
+		if (state.modifierDirtyBegin >= state.modifierDirtyEnd) continue;
+		state.modifierVersion++;
+		state.modifierSnapshot = std::make_shared<const std::vector<float>>(state.modifierParams);
+		state.modifierVersionBegin = state.modifierDirtyBegin;
+		state.modifierVersionEnd   = state.modifierDirtyEnd;
+		state.modifierDirtyBegin   = 0;
+		state.modifierDirtyEnd     = 0;
+	}
+}
+
+/**
+ * Applies the pending changes and copies the state the renderer needs, every model
+ * is captured as a separate job
+ * @param models The snapshot of the models, reused to keep its allocations
+ */
+void ObjectManager::captureSnapshot(std::vector<ModelSnapshot>* models) {
+	applyChanges();
+
+	models->resize(mModels.size());
+	mJobs->parallelFor(mModels.size(), 1, [this, models](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) snapshotModel(mModels[i], &models->at(i));
+	});
+}
 
-		for (Mesh& mesh : state.meshes) {
-			glBindVertexArray(mesh.vao);
-
-			mShaderManager.activateShader(state.shader);
-			Shader* shader = mShaderManager.getShader(state.shader);
-			shader->setInt("modifierData", 0);
-			state.modifierData.load(0);
-			mMaterialManager.loadMaterial(shader, mesh.material, 1);
-
-			glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
-			glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(InstanceData), data.data(), GL_DYNAMIC_DRAW);
-
-			shader->setVec3("viewPos", viewPos);
-			if (state.useIndices)
-				glDrawElementsInstanced(
-				  GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, 0, data.size()
-				);
-			else
-				glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.count, data.size());
+/**
+ * Looks up the object of an instance
+ * @param key The instance as it was drawn
+ * @return The object, nullptr if it was deleted since
+ */
+Object ObjectManager::getObject(const InstanceKey& key) const {
+	if (key.model >= mModels.size()) return nullptr;
+	const std::vector<Instance>& instances = mModels[key.model].instances;
+	if (key.slot >= instances.size() || instances[key.slot].generation != key.generation)
+		return nullptr;
+	return instances[key.slot].object.lock();
+}
+
+/**
+ * Uploads the modifier data and collects the instances that are drawn this frame,
+ * every model is interpolated, culled and packed as a separate job
+ * @param previous The models of the older snapshot
+ * @param current The models of the newest snapshot
+ * @param alpha The interpolation factor between the snapshots
+ * @param viewProjection The matrix the frustum is taken from
+ * @param ring The buffer the instance data and modifier patches of this frame are written to
+ */
+void ObjectManager::prepareFrame(
+  const std::vector<ModelSnapshot>& previous,
+  const std::vector<ModelSnapshot>& current,
+  float alpha,
+  const glm::mat4& viewProjection,
+  FrameRingBuffer& ring
+) {
+	size_t numModels = std::min(mModels.size(), current.size());
+	for (size_t i = 0; i < numModels; ++i) {
+		syncModifierData(mModels[i], current[i], ring);
+		mModels[i].frameDepthPrePass  = current[i].depthPrePass;
+		mModels[i].frameModifierTypes = current[i].modifierTypes;
+	}
+	for (size_t i = numModels; i < mModels.size(); ++i) {
+		mModels[i].frameData.clear();
+		mModels[i].frameInstances.clear();
+		mModels[i].frameDepthPrePass = false;
+	}
+
+	// The instances resolve their material to an index of this upload
+	mMaterialManager.upload(ring);
+	// Every model is culled and then packed as a continuation, the upload waits on all of them
+	Frustum frustum(viewProjection);
+	std::atomic<int64_t> cullTime{0}, packTime{0};
+	TaskGraph graph;
+	for (size_t i = 0; i < numModels; ++i) {
+		const ModelSnapshot* prev   = (i < previous.size()) ? &previous[i] : nullptr;
+		TaskGraph::TaskHandle cull = graph.addTask([&, i, prev]() {
+			Clock::time_point start = Clock::now();
+			cullInstances(i, prev, current[i], alpha, frustum);
+			addTime(cullTime, start, Clock::now());
+		});
+		graph.addContinuation(cull, [&, i]() {
+			Clock::time_point start = Clock::now();
+			packInstances(mModels[i]);
+			addTime(packTime, start, Clock::now());
+		});
+	}
+	graph.run(*mJobs);
+	mCullTime = toSeconds(cullTime);
+	mPackTime = toSeconds(packTime);
+
+	// The packed data is shared by all passes of this frame
+	mFrameDraws = uploadDraws(false, ring);
+}
+
+/**
+ * Draws the depth of the models that use the depth pre-pass, without any color.
+ * Must run before renderObjects in the forward path
+ * @return True if any model was drawn
+ */
+bool ObjectManager::renderDepthPrePass() {
+	mShaderManager.resetActiveShader();
+	if (!mFragmentQueries && GLAD_GL_VERSION_4_6)
+		mFragmentQueries = std::make_unique<QueryRing>(GL_FRAGMENT_SHADER_INVOCATIONS, 2, cQUERYFRAMES);
+
+	bool drawn = false;
+	bindDraws(mFrameDraws);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	if (mFragmentQueries) mFragmentQueries->begin(0);
+	for (ModelState& state : mModels) {
+		if (state.frameData.empty() || !state.frameDepthPrePass) continue;
+		drawModel(state, PredefinedShader::DEPTH, mFrameDraws, state.frameFirstDraw);
+		drawn = true;
+	}
+	if (mFragmentQueries) mFragmentQueries->end();
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	return drawn;
+}
+
+/**
+ * Draws the instances packed by prepareFrame
+ * @param pass The models of the basic shader go into the G-buffer when deferred,
+ * all other models are drawn forward afterwards
+ */
+void ObjectManager::renderObjects(RenderPass pass) {
+	// The light culling, cubemap and post processor bind their own programs and textures
+	mShaderManager.resetActiveShader();
+	mMaterialManager.bindTextures();
+	bindDraws(mFrameDraws);
+
+	// The pre-pass wrote the final depth, so only the visible fragments are shaded
+	if (pass == RenderPass::FORWARD) {
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		if (mFragmentQueries) mFragmentQueries->begin(1);
+		for (ModelState& state : mModels)
+			if (!state.frameData.empty() && state.frameDepthPrePass)
+				drawModel(state, state.shader, mFrameDraws, state.frameFirstDraw);
+		if (mFragmentQueries) {
+			mFragmentQueries->end();
+			mFragmentQueries->endFrame();
 		}
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+
+	for (ModelState& state : mModels) {
+		if (state.frameData.empty()) continue;
+		if (pass == RenderPass::FORWARD && state.frameDepthPrePass) continue;
+
+		bool lit = state.shader == PredefinedShader::BASIC;
+		if (pass == RenderPass::DEFERRED_GEOMETRY && !lit) continue;
+		if (pass == RenderPass::DEFERRED_FORWARD && lit) continue;
+		uint shaderIdent =
+		  (pass == RenderPass::DEFERRED_GEOMETRY) ? (uint)PredefinedShader::GEOMETRY : state.shader;
+		drawModel(state, shaderIdent, mFrameDraws, state.frameFirstDraw);
 	}
 }
 
-void ObjectManager::renderRegions(const glm::vec3& viewPos) {
-	int base = 1;
-	for (auto& model : mModels) {
-		ModelState& state = model.second;
+/**
+ * Returns the fragment shader invocations the depth pre-pass saved in a recent frame
+ * @return The saved invocations, empty if pipeline statistics are not available
+ */
+std::optional<uint64_t> ObjectManager::getSavedFragmentInvocations() const {
+	if (!mFragmentQueries || mFragmentQueries->getResults().empty()) return std::nullopt;
+	// Without the pre-pass the color pass would have shaded what the pre-pass shaded
+	const std::vector<uint64_t>& results = mFragmentQueries->getResults();
+	return (results.at(0) > results.at(1)) ? results.at(0) - results.at(1) : 0;
+}
 
-		std::vector<InstanceData> data;
-		for (auto& instance : state.instances) {
-			if (instance.object.expired()) continue;
-			Object obj = instance.object.lock();
-			if (!obj->getVisibility()) continue;
-			data.push_back(
-			  {instance.model, Tools::getNormalModelMatrix(instance.model),
-			   instance.modifierStart, instance.modifierCount}
-			);
+/**
+ * Enables the depth pre-pass for all models with the basic or baked shader
+ */
+void ObjectManager::setDepthPrePass(bool enable) { mDepthPrePass = enable; }
+
+/**
+ * Enables the depth pre-pass for one model, this overrides the global setting.
+ * The vertex shader of the model has to position vertices with
+ * transform(processModifiers(aPos)), like the built-in shaders
+ */
+void ObjectManager::setDepthPrePass(ModelHandle model, bool enable) {
+	if (model >= mModels.size()) return;
+	mModels[model].depthPrePass = enable;
+}
+
+/**
+ * Sets if a model is drawn into the shadow maps, by default only the models with the
+ * basic or baked shader are. The vertex shader has the same requirements as the depth pre-pass
+ */
+void ObjectManager::setCastShadows(ModelHandle model, bool enable) {
+	if (model >= mModels.size()) return;
+	mModels[model].castShadows = enable;
+}
+
+/**
+ * Marks a model as static, the lightmap baker only bakes the instances of static models
+ */
+void ObjectManager::setStatic(ModelHandle model, bool enable) {
+	if (model >= mModels.size()) return;
+	mModels[model].isStatic = enable;
+}
+
+/**
+ * Collects the visible instances of the static models, call applyChanges first so the
+ * transforms are up to date
+ */
+std::vector<StaticInstance> ObjectManager::getStaticInstances() const {
+	std::vector<StaticInstance> instances;
+	for (ModelHandle model = 0; model < mModels.size(); ++model) {
+		const ModelState& state = mModels[model];
+		if (!state.isStatic) continue;
+		for (uint i = 0; i < state.instances.size(); ++i) {
+			const Instance& ins = state.instances[i];
+			if (!ins.visible || ins.object.expired()) continue;
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), ins.translation);
+			matrix *= glm::mat4_cast(ins.rotation);
+			matrix = glm::scale(matrix, ins.scale);
+			instances.push_back({model, i, matrix});
 		}
+	}
+	return instances;
+}
+
+/**
+ * Returns the vertex data of every mesh of a model, in the order of its meshes
+ */
+std::vector<std::shared_ptr<const MeshGeometry>> ObjectManager::getGeometry(ModelHandle model) const {
+	std::vector<std::shared_ptr<const MeshGeometry>> geometry;
+	if (model >= mModels.size()) return geometry;
+	for (const Mesh& mesh : mModels[model].meshes) geometry.push_back(mesh.geometry);
+	return geometry;
+}
+
+/**
+ * Replaces the vertices of a mesh with a version that has lightmap uvs, a model with the
+ * basic shader switches to the baked variant of it
+ * @param geometry The new vertices, may have more vertices than before where charts split them
+ * @param lightmapUVs The uv of every vertex in the lightmap rect of an instance
+ */
+void ObjectManager::setLightmapGeometry(
+  ModelHandle model,
+  size_t meshIndex,
+  const MeshGeometry& geometry,
+  const std::vector<glm::vec2>& lightmapUVs
+) {
+	if (model >= mModels.size() || meshIndex >= mModels[model].meshes.size()) return;
+	ModelState& state = mModels[model];
+	Mesh& mesh        = state.meshes[meshIndex];
+
+	mesh             = createMesh(geometry.vertices, geometry.indices, mesh.material);
+	mesh.lightmapUVs = std::make_shared<const std::vector<glm::vec2>>(lightmapUVs);
+	uploadModel(state);
+
+	if (state.shader == PredefinedShader::BASIC) state.shader = PredefinedShader::BAKED;
+}
+
+/**
+ * Places an instance in the lightmap, instances without a rect are lit dynamically
+ * @param rect The offset in xy and the scale in zw, in uv of the lightmap
+ */
+void ObjectManager::setLightmapRect(ModelHandle model, uint slot, const glm::vec4& rect) {
+	if (model >= mModels.size() || slot >= mModels[model].instances.size()) return;
+	mModels[model].instances[slot].lightmapRect = rect;
+}
+
+/**
+ * Sets the lightmap the baked shader samples, the object manager takes ownership of it and
+ * deletes the previous lightmap
+ * @param texture The lightmap texture, 0 removes the lightmap
+ */
+void ObjectManager::setLightmapTexture(uint texture) {
+	if (mLightmapTexture && mLightmapTexture->texture == texture) return;
+	mLightmapTexture.reset();
+	if (texture != 0) mLightmapTexture = std::make_unique<LightmapTexture>(texture);
+}
+
+ObjectManager::LightmapTexture::~LightmapTexture() { glDeleteTextures(1, &texture); }
+
+/**
+ * Sets the lights the built-in shaders are specialized on this frame
+ * @param numDirLights The directional lights in the light set
+ * @param shadows If any light casts shadows
+ */
+void ObjectManager::setLightFeatures(int numDirLights, bool shadows) {
+	mLightFeatures.numDirLights = numDirLights;
+	mLightFeatures.shadows      = shadows;
+}
 
-		for (Mesh& mesh : state.meshes) {
-			glBindVertexArray(mesh.vao);
-
-			mShaderManager.activateShader(PredefinedShader::REGION);
-			Shader* shader = mShaderManager.getShader(PredefinedShader::REGION);
-			shader->setInt("modifierData", 0);
-			state.modifierData.load(0);
-
-			glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
-			glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(InstanceData), data.data(), GL_DYNAMIC_DRAW);
-
-			shader->setVec3("viewPos", viewPos);
-			shader->setInt("baseID", base);
-			if (state.useIndices)
-				glDrawElementsInstanced(
-				  GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, 0, data.size()
-				);
-			else
-				glDrawArraysInstanced(GL_TRIANGLES, 0, mesh.count, data.size());
+/**
+ * Packs the shadow casters inside the volume of a shadow map, every model is a separate job
+ * @param previous The models of the older snapshot
+ * @param current The models of the newest snapshot
+ * @param alpha The interpolation factor between the snapshots
+ * @param viewProjections The matrices of the faces of the shadow map, at most 32. Every
+ * caster gets a mask of the faces it is in
+ * @return A hash of the packed casters, equal as long as no caster in the volume changed
+ */
+uint64_t ObjectManager::packShadowCasters(
+  const std::vector<ModelSnapshot>& previous,
+  const std::vector<ModelSnapshot>& current,
+  float alpha,
+  std::span<const glm::mat4> viewProjections
+) {
+	size_t numModels = std::min(mModels.size(), current.size());
+	for (size_t i = numModels; i < mModels.size(); ++i) {
+		mModels[i].shadowData.clear();
+		mModels[i].shadowFaces.clear();
+	}
+
+	// Every model is packed as a task, the hash of all casters depends on all of them
+	std::vector<Frustum> frustums(viewProjections.begin(), viewProjections.end());
+	uint64_t hash = cHASHBASIS;
+	TaskGraph graph;
+	TaskGraph::TaskHandle combine = graph.addTask([&]() {
+		for (size_t i = 0; i < numModels; ++i) {
+			if (mModels[i].shadowData.empty()) continue;
+			hash = hashBytes(hash, &i, sizeof(size_t));
+			hash = hashBytes(hash, &mModels[i].shadowHash, sizeof(uint64_t));
 		}
-		base += data.size();
+	});
+	for (size_t i = 0; i < numModels; ++i) {
+		TaskGraph::TaskHandle pack = graph.addTask([&, i]() {
+			const ModelSnapshot* prev = (i < previous.size()) ? &previous[i] : nullptr;
+			packShadowModel(mModels[i], prev, current[i], alpha, frustums);
+		});
+		graph.addDependency(pack, combine);
 	}
+	graph.run(*mJobs);
+	return hash;
 }
 
-void ObjectManager::updateModifierTex(const ModifierStack& stack, const std::string& model, uint instanceIdent) {
-	// Update the data for the instance
-	ModelState& state = mModels.at(model);
-	Instance& ins     = state.instances.at(instanceIdent);
-
-	if (ins.modifierCount == 0) ins.modifierStart = state.modifierData.count();
-	ins.modifierCount = stack.count;
-
-	size_t nextStack = 0;
-	for (size_t i = instanceIdent + 1; i < state.instances.size(); ++i) {
-		Instance& nextIns = state.instances.at(i);
-		if (nextIns.modifierCount <= 0) continue;
-		nextStack = nextIns.modifierStart;
-		break;
-	}
-
-	int count = nextStack - ins.modifierStart;
-	if (nextStack > 0 && (uint)count != stack.count) {
-		int offset = count - stack.count;
-		state.modifierData.move(ins.modifierStart, ins.modifierStart + offset);
-		for (size_t i = instanceIdent + 1; i < state.instances.size(); ++i) {
-			Instance& nextIns = state.instances.at(i);
-			if (nextIns.modifierCount <= 0) continue;
-			nextIns.modifierStart = nextIns.modifierStart - offset;
+/**
+ * Packs the instances of a model that are inside any of the shadow volumes, with a mask
+ * of the volumes they are in and a hash of everything that would change the shadows
+ * @param state The model to pack, only this model is touched
+ * @param previous The model in the older snapshot, nullptr if it was not there
+ * @param current The model in the newest snapshot
+ * @param alpha The interpolation factor between the snapshots
+ * @param frustums The shadow volumes
+ */
+void ObjectManager::packShadowModel(
+  ModelState& state,
+  const ModelSnapshot* previous,
+  const ModelSnapshot& current,
+  float alpha,
+  const std::vector<Frustum>& frustums
+) {
+	state.shadowData.clear();
+	state.shadowFaces.clear();
+	if (!current.castShadows) return;
+
+	uint64_t hash = cHASHBASIS;
+	uint faces    = 0;
+	auto visible  = [&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		faces = 0;
+		for (size_t f = 0; f < frustums.size(); ++f)
+			if (frustums[f].intersects(boundsMin, boundsMax)) faces |= 1u << f;
+		return faces != 0;
+	};
+	forEachInstance(previous, current, alpha, visible, [&](const InstanceSnapshot& ins, const glm::mat4& matrix) {
+		// The depth shaders do not use the normal matrix
+		state.shadowData.push_back({matrix, glm::mat4(1.0f), glm::vec4(0.0f), ins.modifierStart, ins.modifierCount});
+		state.shadowFaces.push_back(faces);
+		hash = hashBytes(hash, &faces, sizeof(uint));
+		hash = hashBytes(hash, &ins.slot, sizeof(uint));
+		hash = hashBytes(hash, &ins.generation, sizeof(uint));
+		hash = hashBytes(hash, &matrix, sizeof(glm::mat4));
+		hash = hashBytes(hash, &ins.modifierStart, sizeof(uint));
+	});
+	state.shadowHash = hashBytes(hash, &current.modifierVersion, sizeof(uint));
+}
+
+/**
+ * Draws the depth of the casters packed by packShadowCasters into the bound target
+ * @param ring The buffer the instance data is written to
+ * @param shaderIdent DEPTH for one face, POINTSHADOW draws the faces of a cube in one pass
+ */
+void ObjectManager::renderShadowCasters(FrameRingBuffer& ring, uint shaderIdent) {
+	mShaderManager.resetActiveShader();
+	DrawData draws = uploadDraws(true, ring);
+	bindDraws(draws);
+	if (shaderIdent == PredefinedShader::POINTSHADOW) {
+		std::vector<uint> faces;
+		for (const ModelState& state : mModels)
+			faces.insert(faces.end(), state.shadowFaces.begin(), state.shadowFaces.end());
+		if (!faces.empty()) ring.bindStorage(cSHADOWFACESBINDING, faces.data(), faces.size() * sizeof(uint));
+	}
+
+	for (ModelState& state : mModels) {
+		if (state.shadowData.empty()) continue;
+		drawModel(state, shaderIdent, draws, state.shadowFirstDraw);
+	}
+}
+
+/**
+ * Uploads the instances of all models in one piece, and the parameters and indirect command
+ * of a draw per mesh. The first draw of every model is stored in its state
+ * @param shadows Uploads the packed shadow casters instead of the packed camera instances
+ * @param ring The buffer of this frame
+ */
+ObjectManager::DrawData ObjectManager::uploadDraws(bool shadows, FrameRingBuffer& ring) {
+	mDrawParams.clear();
+	mDrawCommands.clear();
+	size_t numInstances = 0;
+	for (ModelState& state : mModels) {
+		const std::vector<InstanceData>& data = shadows ? state.shadowData : state.frameData;
+		if (data.empty()) continue;
+
+		(shadows ? state.shadowFirstDraw : state.frameFirstDraw) = mDrawParams.size();
+		for (const Mesh& mesh : state.meshes) {
+			mDrawCommands.push_back(
+			  {mesh.count, (uint)data.size(), mesh.firstIndex, mesh.baseVertex, (uint)mDrawParams.size()}
+			);
+			mDrawParams.push_back(
+			  {(uint)numInstances, mMaterialManager.getIndex(mesh.material),
+			   mMaterialManager.getNumTextures(mesh.material)}
+			);
 		}
+		numInstances += data.size();
+	}
+
+	DrawData draws{};
+	if (numInstances == 0) return draws;
+	size_t alignment    = ring.getStorageAlignment();
+	draws.instancesSize = numInstances * sizeof(InstanceData);
+	draws.instances     = ring.allocate(draws.instancesSize, alignment);
+	char* out           = static_cast<char*>(draws.instances.data);
+	for (const ModelState& state : mModels) {
+		const std::vector<InstanceData>& data = shadows ? state.shadowData : state.frameData;
+		std::memcpy(out, data.data(), data.size() * sizeof(InstanceData));
+		out += data.size() * sizeof(InstanceData);
+	}
+	draws.paramsSize = mDrawParams.size() * sizeof(DrawParams);
+	draws.params     = ring.upload(mDrawParams.data(), draws.paramsSize, alignment);
+	draws.commands =
+	  ring.upload(mDrawCommands.data(), mDrawCommands.size() * sizeof(DrawCommand), alignof(DrawCommand));
+	return draws;
+}
+
+void ObjectManager::bindDraws(const DrawData& draws) const {
+	if (draws.instancesSize == 0) return;
+	glBindBufferRange(
+	  GL_SHADER_STORAGE_BUFFER, cINSTANCESBINDING, draws.instances.buffer, draws.instances.offset,
+	  draws.instancesSize
+	);
+	glBindBufferRange(
+	  GL_SHADER_STORAGE_BUFFER, cDRAWPARAMSBINDING, draws.params.buffer, draws.params.offset, draws.paramsSize
+	);
+}
+
+/**
+ * Draws all meshes of a model with one multi-draw, the base instance of a draw selects
+ * its parameters and so its material
+ * @param draws The pass the draw parameters and commands were uploaded for
+ * @param firstDraw The command of the first mesh, the other meshes follow it
+ */
+void ObjectManager::drawModel(ModelState& state, uint shaderIdent, const DrawData& draws, uint firstDraw) {
+	ShaderFeatures features = mLightFeatures;
+	features.modifiers      = state.frameModifierTypes;
+	mShaderManager.activateShader(mShaderManager.getVariant(shaderIdent, features));
+	state.modifierData.load(0);
+	if (shaderIdent == PredefinedShader::BAKED) {
+		glActiveTexture(GL_TEXTURE0 + cLIGHTMAPUNIT);
+		glBindTexture(GL_TEXTURE_2D, mLightmapTexture ? mLightmapTexture->texture : 0);
+		glActiveTexture(GL_TEXTURE0);
 	}
 
-	state.modifierData.copy(stack.params, ins.modifierStart);
+	glBindVertexArray(state.vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draws.commands.buffer);
+	glMultiDrawElementsIndirect(
+	  GL_TRIANGLES, GL_UNSIGNED_INT,
+	  reinterpret_cast<const void*>(draws.commands.offset + firstDraw * sizeof(DrawCommand)), state.meshes.size(),
+	  0
+	);
 }
 
-Object ObjectManager::getFromObjectId(uint id) const {
-	for (auto& model : mModels) {
-		for (auto& instance : model.second.instances) {
-			if (id == 0 && !instance.object.expired()) return instance.object.lock();
-			if (!instance.object.expired()) id--;
+// The ids of the regions are the index of the instance in the frame plus one
+void ObjectManager::renderRegions() {
+	mShaderManager.resetActiveShader();
+	bindDraws(mFrameDraws);
+	for (ModelState& state : mModels) {
+		if (state.frameData.empty()) continue;
+		drawModel(state, PredefinedShader::REGION, mFrameDraws, state.frameFirstDraw);
+	}
+}
+
+void ObjectManager::recordChange(ModelHandle model, size_t index, RawObject* obj, ObjectEvent event) {
+	ModelState& state = mModels[model];
+	Instance& ins     = state.instances[index];
+	switch (event) {
+	case ObjectEvent::MODIFIER: ins.modifierChanged = true; break;
+	case ObjectEvent::TRANSFORM: ins.transformChanged = true; break;
+	case ObjectEvent::VISIBILITY: ins.visibilityChanged = true; break;
+	case ObjectEvent::MATERIAL: ins.materialChanged = true; break;
+	case ObjectEvent::DELETE:
+		// An object that was destroyed before no longer owns its slot
+		if (ins.object.lock().get() == obj) {
+			releaseModifierRange(state, ins);
+			ins.object.reset();
 		}
+		return;
 	}
-	return nullptr;
+	if (!ins.queued) mChanges.push_back({model, index});
+	ins.queued = true;
 }
 
-Mesh ObjectManager::registerVerticesModel(const std::vector<float>& vertices, uint material) {
-	// Create the vao
-	uint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+/**
+ * Repacks the modifier stack of an instance into the cpu copy of the modifier data
+ * @param stack The new modifier stack of the instance
+ * @param state The model the instance belongs to
+ * @param ins The instance that changed
+ */
+void ObjectManager::updateModifierTex(const ModifierStack& stack, ModelState& state, Instance& ins) {
+	std::vector<float>& params = state.modifierParams;
 
-	glm::vec3 minPoint{std::numeric_limits<float>().max()};
-	glm::vec3 maxPoint{std::numeric_limits<float>().min()};
-	for (size_t i = 0; i < vertices.size(); i += 8) {
-		minPoint.x = std::min(minPoint.x, vertices.at(i));
-		minPoint.y = std::min(minPoint.y, vertices.at(i + 1));
-		minPoint.z = std::min(minPoint.z, vertices.at(i + 2));
+	// Same size stacks can be overwritten in place, otherwise move it to the back
+	if (ins.modifierSize == 0 || ins.modifierSize != stack.params.size()) {
+		releaseModifierRange(state, ins);
+		ins.modifierStart = params.size();
+		params.resize(params.size() + stack.params.size());
+	}
+	std::copy(stack.params.begin(), stack.params.end(), params.begin() + ins.modifierStart);
+	ins.modifierSize     = stack.params.size();
+	ins.modifierCount    = stack.count;
+	state.modifierTypes |= stack.types;
 
-		maxPoint.x = std::max(maxPoint.x, vertices.at(i));
-		maxPoint.y = std::max(maxPoint.y, vertices.at(i + 1));
-		maxPoint.z = std::max(maxPoint.z, vertices.at(i + 2));
+	size_t end = ins.modifierStart + ins.modifierSize;
+	if (state.modifierDirtyBegin >= state.modifierDirtyEnd) {
+		state.modifierDirtyBegin = ins.modifierStart;
+		state.modifierDirtyEnd   = end;
+	} else {
+		state.modifierDirtyBegin =
+		  std::min<size_t>(state.modifierDirtyBegin, ins.modifierStart);
+		state.modifierDirtyEnd = std::max(state.modifierDirtyEnd, end);
 	}
+}
 
-	Tools::generateBuffer(vertices, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-	uint instanceVBO = handleBuffers();
+/**
+ * Removes the modifier data of an instance, all data behind it shifts forward
+ * @param state The model the instance belongs to
+ * @param ins The instance which data will be removed
+ */
+void ObjectManager::releaseModifierRange(ModelState& state, Instance& ins) {
+	if (ins.modifierSize > 0) {
+		std::vector<float>& params = state.modifierParams;
+		auto begin                 = params.begin() + ins.modifierStart;
+		params.erase(begin, begin + ins.modifierSize);
+		for (Instance& other : state.instances)
+			if (other.modifierSize > 0 && other.modifierStart > ins.modifierStart)
+				other.modifierStart -= ins.modifierSize;
 
-	glBindVertexArray(0);
-	return Mesh(vao, instanceVBO, vertices.size() / 8, material, minPoint, maxPoint);
+		if (state.modifierDirtyBegin >= state.modifierDirtyEnd)
+			state.modifierDirtyBegin = ins.modifierStart;
+		else
+			state.modifierDirtyBegin = std::min<size_t>(state.modifierDirtyBegin, ins.modifierStart);
+		state.modifierDirtyEnd = params.size();
+	}
+	ins.modifierStart = 0;
+	ins.modifierCount = 0;
+	ins.modifierSize  = 0;
 }
 
-Mesh ObjectManager::registerIndicesModel(
+/**
+ * Uploads a new version of the modifier data, when no version was skipped only
+ * the changed part is uploaded in a single patch. The patch is staged in the ring
+ * and copied on the gpu, so the cpu never waits on the modifier buffer
+ * @param state The model of which the modifier data will be uploaded
+ * @param snapshot The snapshot of the model
+ * @param ring The buffer of this frame
+ */
+void ObjectManager::syncModifierData(ModelState& state, const ModelSnapshot& snapshot, FrameRingBuffer& ring) {
+	if (snapshot.modifierVersion == state.uploadedModifierVersion || !snapshot.modifierParams)
+		return;
+
+	const std::vector<float>& params = *snapshot.modifierParams;
+	size_t begin = 0, end = params.size();
+	if (snapshot.modifierVersion == state.uploadedModifierVersion + 1) {
+		begin = snapshot.modifierDirtyBegin;
+		end   = std::min(snapshot.modifierDirtyEnd, params.size());
+	}
+	if (begin < end) {
+		FrameRingBuffer::Allocation patch =
+		  ring.upload(params.data() + begin, (end - begin) * sizeof(float), sizeof(float));
+		state.modifierData.copyFromBuffer(patch.buffer, patch.offset, end - begin, begin);
+	}
+	state.uploadedModifierVersion = snapshot.modifierVersion;
+}
+
+/**
+ * Rebuilds the matrices and world space bounds of an instance
+ * @param state The model the instance belongs to
+ * @param ins The instance to refit
+ * @param obj The object of the instance
+ */
+void ObjectManager::refitInstance(const ModelState& state, Instance& ins, const RawObject& obj) {
+	ins.translation = obj.getPosition();
+	ins.rotation    = obj.getQuaternion();
+	ins.scale       = obj.getScale();
+	Frustum::transformBounds(
+	  obj.getModelMatrix(), state.minPoint, state.maxPoint, &ins.boundsMin, &ins.boundsMax
+	);
+}
+
+/**
+ * Copies the visible instances and the latest modifier data version of a model
+ * @param state The model to capture, only this model is touched
+ * @param snapshot The snapshot to fill
+ */
+void ObjectManager::snapshotModel(const ModelState& state, ModelSnapshot* snapshot) {
+	snapshot->instances.clear();
+	for (uint i = 0; i < state.instances.size(); ++i) {
+		const Instance& ins = state.instances[i];
+		if (!ins.visible || ins.object.expired()) continue;
+		snapshot->instances.push_back(
+		  {i, ins.generation, ins.translation, ins.rotation, ins.scale, ins.boundsMin,
+		   ins.boundsMax, ins.modifierStart, ins.modifierCount, ins.lightmapRect, ins.material}
+		);
+	}
+
+	snapshot->modifierParams     = state.modifierSnapshot;
+	snapshot->modifierTypes      = state.modifierTypes;
+	snapshot->modifierVersion    = state.modifierVersion;
+	snapshot->modifierDirtyBegin = state.modifierVersionBegin;
+	snapshot->modifierDirtyEnd   = state.modifierVersionEnd;
+	snapshot->depthPrePass = state.depthPrePass.value_or(mDepthPrePass && isLitShader(state.shader));
+	snapshot->castShadows  = state.castShadows.value_or(isLitShader(state.shader));
+}
+
+/**
+ * Collects the instances of a model that are inside the frustum with their model matrix,
+ * instances that are in both snapshots are interpolated
+ * @param model The model to cull, only this model is touched
+ * @param previous The model in the older snapshot, nullptr if it was not there
+ * @param current The model in the newest snapshot
+ * @param alpha The interpolation factor between the snapshots
+ * @param frustum The frustum of the camera
+ */
+void ObjectManager::cullInstances(
+  ModelHandle model,
+  const ModelSnapshot* previous,
+  const ModelSnapshot& current,
+  float alpha,
+  const Frustum& frustum
+) {
+	ModelState& state = mModels[model];
+	state.frameData.clear();
+	state.frameInstances.clear();
+
+	auto visible = [&](const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		return frustum.intersects(boundsMin, boundsMax);
+	};
+	forEachInstance(previous, current, alpha, visible, [&](const InstanceSnapshot& ins, const glm::mat4& matrix) {
+		state.frameData.push_back(
+		  {matrix, glm::mat4(1.0f), ins.lightmapRect, ins.modifierStart, ins.modifierCount, ins.material}
+		);
+		state.frameInstances.push_back({model, ins.slot, ins.generation});
+	});
+}
+
+/**
+ * Completes the instances the culling kept with their normal matrix and the index of
+ * their material in the material buffer
+ * @param state The model to pack, only this model is touched
+ */
+void ObjectManager::packInstances(ModelState& state) {
+	for (InstanceData& data : state.frameData) {
+		data.normalModel = glm::mat4(Tools::getNormalModelMatrix(data.model));
+		data.material    = mMaterialManager.getIndex(data.material);
+	}
+}
+
+/**
+ * Returns the cpu time the last change journal spent refitting, summed over all threads
+ */
+float ObjectManager::getRefitTime() const { return mRefitTime; }
+
+/**
+ * Returns the cpu time the last frame spent culling and packing instances, summed over all threads
+ */
+float ObjectManager::getCullTime() const { return mCullTime; }
+float ObjectManager::getPackTime() const { return mPackTime; }
+
+// Combines the bounds of all meshes, objects of the model share them
+void ObjectManager::updateModelBounds(ModelState& state) {
+	state.minPoint = glm::vec3(std::numeric_limits<float>().max());
+	state.maxPoint = glm::vec3(std::numeric_limits<float>().lowest());
+	for (auto& mesh : state.meshes) {
+		state.minPoint = glm::min(state.minPoint, mesh.minPoint);
+		state.maxPoint = glm::max(state.maxPoint, mesh.maxPoint);
+	}
+}
+
+/**
+ * Finds the instance behind an id of the region pass
+ * @param id The id without the base offset, counts the drawn instances of the last frame
+ */
+std::optional<InstanceKey> ObjectManager::getDrawnInstance(uint id) const {
+	for (const ModelState& state : mModels) {
+		if (id < state.frameInstances.size()) return state.frameInstances.at(id);
+		id -= state.frameInstances.size();
+	}
+	return std::nullopt;
+}
+
+/**
+ * Creates a mesh without buffers, uploadModel places it in the buffers of its model
+ * @param indices Empty to draw the vertices in order
+ */
+Mesh ObjectManager::createMesh(
   const std::vector<float>& vertices,
   const std::vector<uint>& indices,
   uint material
-) {
-	uint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
+) const {
 	glm::vec3 minPoint{std::numeric_limits<float>().max()};
-	glm::vec3 maxPoint{std::numeric_limits<float>().min()};
+	glm::vec3 maxPoint{std::numeric_limits<float>().lowest()};
 	for (size_t i = 0; i < vertices.size(); i += 8) {
-		minPoint.x = std::min(minPoint.x, vertices.at(i));
-		minPoint.y = std::min(minPoint.y, vertices.at(i + 1));
-		minPoint.z = std::min(minPoint.z, vertices.at(i + 2));
+		minPoint = glm::min(minPoint, glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+		maxPoint = glm::max(maxPoint, glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+	}
+	return Mesh{
+	  0, 0, 0, material, minPoint, maxPoint, std::make_shared<const MeshGeometry>(MeshGeometry{vertices, indices})
+	};
+}
 
-		maxPoint.x = std::max(maxPoint.x, vertices.at(i));
-		maxPoint.y = std::max(maxPoint.y, vertices.at(i + 1));
-		maxPoint.z = std::max(maxPoint.z, vertices.at(i + 2));
+/**
+ * Puts the meshes of a model into one vertex and one index buffer, the old buffers are
+ * deleted. The lightmap uvs get a buffer once any mesh has them
+ */
+void ObjectManager::uploadModel(ModelState& state) {
+	if (state.vao != 0) {
+		uint buffers[3] = {state.vertexBuffer, state.indexBuffer, state.lightmapBuffer};
+		glDeleteVertexArrays(1, &state.vao);
+		glDeleteBuffers(3, buffers);
 	}
 
-	Tools::generateBuffer(vertices, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-	Tools::generateBuffer(indices, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-	uint instanceVBO = handleBuffers();
+	bool lightmapped = std::any_of(state.meshes.begin(), state.meshes.end(), [](const Mesh& mesh) {
+		return mesh.lightmapUVs != nullptr;
+	});
+	std::vector<float> vertices;
+	std::vector<uint> indices;
+	std::vector<glm::vec2> lightmapUVs;
+	for (Mesh& mesh : state.meshes) {
+		const MeshGeometry& geometry = *mesh.geometry;
+		uint numVertices             = geometry.vertices.size() / 8;
+		mesh.firstIndex              = indices.size();
+		mesh.baseVertex              = vertices.size() / 8;
+		if (geometry.indices.empty())
+			for (uint i = 0; i < numVertices; ++i) indices.push_back(i);
+		else
+			indices.insert(indices.end(), geometry.indices.begin(), geometry.indices.end());
+		mesh.count = indices.size() - mesh.firstIndex;
+		vertices.insert(vertices.end(), geometry.vertices.begin(), geometry.vertices.end());
 
+		if (!lightmapped) continue;
+		if (mesh.lightmapUVs)
+			lightmapUVs.insert(lightmapUVs.end(), mesh.lightmapUVs->begin(), mesh.lightmapUVs->end());
+		else
+			lightmapUVs.resize(lightmapUVs.size() + numVertices, glm::vec2(0.0f));
+	}
+
+	glGenVertexArrays(1, &state.vao);
+	glBindVertexArray(state.vao);
+	state.vertexBuffer   = Tools::generateBuffer(vertices, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+	state.indexBuffer    = Tools::generateBuffer(indices, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	state.lightmapBuffer = 0;
+	handleBuffers(state.vertexBuffer);
+	if (lightmapped) {
+		state.lightmapBuffer = Tools::generateBuffer(lightmapUVs, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+		glBindVertexBuffer(cLIGHTMAPBINDING, state.lightmapBuffer, 0, sizeof(glm::vec2));
+		glVertexAttribFormat(12, 2, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(12, cLIGHTMAPBINDING);
+		glEnableVertexAttribArray(12);
+	}
 	glBindVertexArray(0);
-	return Mesh(vao, instanceVBO, indices.size(), material, minPoint, maxPoint);
 }
 
-uint ObjectManager::handleBuffers() {
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	uint instanceVBO;
-	glGenBuffers(1, &instanceVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-
-	// mat4 model at locations 3-6
-	for (int i = 0; i < 4; i++) {
-		glVertexAttribPointer(
-		  3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(i * sizeof(glm::vec4))
-		);
-		glEnableVertexAttribArray(3 + i);
-		glVertexAttribDivisor(3 + i, 1);
-	}
-	// mat3 aNormalModel at locations 7-9
+/**
+ * Sets up the vertex format of the bound vao, the instances are read from a storage block
+ * @param vertexBuffer The buffer with the interleaved position, normal and uv
+ */
+void ObjectManager::handleBuffers(uint vertexBuffer) {
+	glBindVertexBuffer(cVERTEXBINDING, vertexBuffer, 0, sizeof(float) * 8);
+	glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+	glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float));
 	for (int i = 0; i < 3; i++) {
-		glVertexAttribPointer(
-		  7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
-		  (void*)(offsetof(InstanceData, normalModel) + i * sizeof(glm::vec3))
-		);
-		glEnableVertexAttribArray(7 + i);
-		glVertexAttribDivisor(7 + i, 1);
+		glVertexAttribBinding(i, cVERTEXBINDING);
+		glEnableVertexAttribArray(i);
 	}
-	// modifier start
-	glVertexAttribIPointer(10, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)(offsetof(InstanceData, modifierStart)));
-	glEnableVertexAttribArray(10);
-	glVertexAttribDivisor(10, 1);
-	// modifier count
-	glVertexAttribIPointer(11, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)(offsetof(InstanceData, modifierCount)));
-	glEnableVertexAttribArray(11);
-	glVertexAttribDivisor(11, 1);
-
-	return instanceVBO;
 }
 
-void ObjectManager::registerFileModel(const std::string& ident, const std::string& modelPath, uint shader) {
-	if (mModels.contains(ident)) {
+std::optional<ModelHandle>
+  ObjectManager::registerFileModel(const std::string& ident, const std::string& modelPath, uint shader) {
+	if (mModelHandles.contains(ident)) {
 		std::cerr << "[Object Manager] Error: Already a model with ident \'" + ident + "\'"
 		          << std::endl;
-		return;
+		return std::nullopt;
 	}
 
 	const aiScene* scene =
@@ -336,23 +1101,28 @@ void ObjectManager::registerFileModel(const std::string& ident, const std::strin
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		std::cout << "[Object Manager] Error: Failed assimp load => "
 		          << mImporter->GetErrorString() << std::endl;
-		return;
+		return std::nullopt;
 	}
 
-	mModels[ident] = ModelState(std::vector<Mesh>(), false, shader, GpuVector(), {});
+	ModelHandle handle = mModels.size();
+	mModels.push_back(ModelState{.meshes = {}, .shader = shader});
+	mModelHandles[ident]  = handle;
 	std::string directory = modelPath.substr(0, modelPath.find_last_of("/"));
-	processNode(scene->mRootNode, ident, directory, scene);
+	processNode(scene->mRootNode, handle, directory, scene);
+	uploadModel(mModels.at(handle));
+	updateModelBounds(mModels.at(handle));
+	return handle;
 }
 
-void ObjectManager::processNode(aiNode* node, const std::string& ident, const std::string& directory, const aiScene* scene) {
+void ObjectManager::processNode(aiNode* node, ModelHandle model, const std::string& directory, const aiScene* scene) {
 
 	for (uint i = 0; i < node->mNumMeshes; i++) {
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		mModels.at(ident).meshes.push_back(processMesh(mesh, directory, scene));
+		mModels.at(model).meshes.push_back(processMesh(mesh, directory, scene));
 	}
 
 	for (uint i = 0; i < node->mNumChildren; i++)
-		processNode(node->mChildren[i], ident, directory, scene);
+		processNode(node->mChildren[i], model, directory, scene);
 }
 
 Mesh ObjectManager::processMesh(aiMesh* mesh, const std::string& directory, const aiScene* scene) {
@@ -398,7 +1168,7 @@ Mesh ObjectManager::processMesh(aiMesh* mesh, const std::string& directory, cons
 		  {directory + "/" + diffuseStr.at(i), directory + "/" + specularStr.at(i), 32.0f}
 		);
 
-	return registerIndicesModel(vertices, indices, materialIdent);
+	return createMesh(vertices, indices, materialIdent);
 }
 
 static aiTextureType toAssimpType(TextureType type) {
@@ -423,7 +1193,7 @@ std::vector<std::string> ObjectManager::loadMaterials(aiMaterial* mat, TextureTy
 	return texNames;
 }
 
-size_t ObjectManager::getNextFreeSlot(const std::string& model) const {
+size_t ObjectManager::getNextFreeSlot(ModelHandle model) const {
 	const std::vector<Instance>& instances = mModels.at(model).instances;
 	for (size_t i = 0; i < instances.size(); ++i) {
 		if (instances.at(i).object.expired()) {
@@ -0,0 +1,95 @@
+#include "jaroViewer/scene/sceneCommandQueue.hpp"
+#include "jaroViewer/core/tools.hpp"
+
+using namespace JaroViewer;
+
+/**
+ * Queues the creation of an object
+ * @param model The model of the object
+ * @param onCreated Called with the new object on the thread that owns the scene
+ */
+void SceneCommandQueue::createObject(ModelHandle model, std::function<void(Object)> onCreated) {
+	mCommands.push(CreateObject{model, std::move(onCreated)});
+}
+
+/**
+ * Queues the removal of an object from the scene, it is no longer drawn even if
+ * references to it are still alive
+ */
+void SceneCommandQueue::destroyObject(Object obj) {
+	mCommands.push(DestroyObject{std::move(obj)});
+}
+
+void SceneCommandQueue::setTranslation(Object obj, const glm::vec3& translation) {
+	mCommands.push(SetTranslation{std::move(obj), translation});
+}
+
+void SceneCommandQueue::setRotation(Object obj, float angleX, float angleY, float angleZ) {
+	mCommands.push(SetRotation{std::move(obj), glm::vec3(angleX, angleY, angleZ)});
+}
+
+void SceneCommandQueue::setScale(Object obj, const glm::vec3& scale) {
+	mCommands.push(SetScale{std::move(obj), scale});
+}
+
+void SceneCommandQueue::setVisibility(Object obj, bool visibility) {
+	mCommands.push(SetVisibility{std::move(obj), visibility});
+}
+
+void SceneCommandQueue::addModifier(Object obj, std::shared_ptr<Modifier> modifier) {
+	mCommands.push(AddModifier{std::move(obj), std::move(modifier)});
+}
+
+void SceneCommandQueue::addDirLight(std::shared_ptr<DirectionalLight> light) {
+	mCommands.push(AddDirLight{std::move(light)});
+}
+
+void SceneCommandQueue::addPointLight(std::shared_ptr<PointLight> light) {
+	mCommands.push(AddPointLight{std::move(light)});
+}
+
+void SceneCommandQueue::addSpotlight(std::shared_ptr<Spotlight> light) {
+	mCommands.push(AddSpotlight{std::move(light)});
+}
+
+/**
+ * Queues an arbitrary edit of the lights, like enabling them or changing a direction
+ * @param edit Called with the light set on the thread that owns the scene
+ */
+void SceneCommandQueue::editLights(std::function<void(LightSet&)> edit) {
+	mCommands.push(EditLights{std::move(edit)});
+}
+
+/**
+ * Applies all commands that were queued, may only be called by the thread that owns the scene
+ * @return The amount of applied commands
+ */
+size_t SceneCommandQueue::apply(ObjectManager& objectManager, LightSet& lights) {
+	size_t count = 0;
+	Command command;
+	while (mCommands.pop(&command)) {
+		std::visit(
+		  Tools::Overloaded{
+		    [&](CreateObject& cmd) {
+			    Object obj = objectManager.createObject(cmd.model);
+			    if (obj && cmd.onCreated) cmd.onCreated(obj);
+		    },
+		    [&](DestroyObject& cmd) { objectManager.destroyObject(cmd.obj); },
+		    [&](SetTranslation& cmd) { cmd.obj->setTranslation(cmd.translation); },
+		    [&](SetRotation& cmd) {
+			    cmd.obj->setRotation(cmd.angles.x, cmd.angles.y, cmd.angles.z);
+		    },
+		    [&](SetScale& cmd) { cmd.obj->setScale(cmd.scale); },
+		    [&](SetVisibility& cmd) { cmd.obj->setVisibility(cmd.visibility); },
+		    [&](AddModifier& cmd) { cmd.obj->addModifier(cmd.modifier); },
+		    [&](AddDirLight& cmd) { lights.addDirLight(cmd.light); },
+		    [&](AddPointLight& cmd) { lights.addPointLight(cmd.light); },
+		    [&](AddSpotlight& cmd) { lights.addSpotlight(cmd.light); },
+		    [&](EditLights& cmd) { cmd.edit(lights); },
+		  },
+		  command
+		);
+		count++;
+	}
+	return count;
+}